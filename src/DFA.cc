@@ -4,6 +4,24 @@
 
 #include "zeek/zeek-config.h"
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+#include <unordered_map>
+
+#ifndef _MSC_VER
+#include <sys/mman.h>
+#endif
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #include "zeek/Desc.h"
 #include "zeek/EquivClass.h"
 #include "zeek/Hash.h"
@@ -394,4 +412,438 @@ int DFA_Machine::Rep(int sym) {
     return -1;
 }
 
+DFA_Table* DFA_Table::Build(DFA_Machine* m, int max_states) {
+    DFA_State* start_state = m->StartState();
+    if ( ! start_state )
+        return nullptr;
+
+    int num_ecs = m->EC()->NumClasses();
+
+    // Number the states breadth-first, with the jam state first. next
+    // collects the transitions of all numbered states, in order.
+    std::vector<DFA_State*> states = {nullptr, start_state};
+    std::unordered_map<DFA_State*, State> state_nums = {{start_state, 1}};
+    std::vector<State> next;
+
+    for ( size_t i = 1; i < states.size(); ++i ) {
+        for ( int ec = 0; ec < num_ecs; ++ec ) {
+            DFA_State* d = states[i]->Xtion(ec, m);
+
+            if ( ! d ) {
+                next.push_back(JAM);
+                continue;
+            }
+
+            auto [it, inserted] = state_nums.emplace(d, states.size());
+
+            if ( inserted ) {
+                if ( static_cast<int>(states.size()) > max_states )
+                    return nullptr;
+
+                states.push_back(d);
+            }
+
+            next.push_back(it->second);
+        }
+    }
+
+    auto t = new DFA_Table();
+    t->num_ecs = num_ecs;
+    t->start = 1;
+
+    const int* ecs = m->EC()->EquivClasses();
+    t->ec_map.resize(256);
+    for ( int b = 0; b < 256; ++b )
+        t->ec_map[b] = ecs[b];
+
+    t->accept.resize(states.size(), -1);
+    t->accel_idx.resize(states.size(), -1);
+
+    // Many states share their accepting sets.
+    std::map<AcceptingSet, int> accept_nums;
+
+    for ( size_t i = 1; i < states.size(); ++i ) {
+        if ( const AcceptingSet* ac = states[i]->Accept() ) {
+            auto [it, inserted] = accept_nums.emplace(*ac, t->accept_sets.size());
+
+            if ( inserted )
+                t->accept_sets.push_back(*ac);
+
+            t->accept[i] = it->second;
+            continue;
+        }
+
+        Accel a = {};
+        int num_stay = 0;
+
+        for ( int b = 0; b < 256; ++b ) {
+            a.stay[b] = next[(i - 1) * num_ecs + ecs[b]] == i;
+
+            if ( a.stay[b] )
+                ++num_stay;
+            else if ( b < 128 )
+                a.exit_lo[b & 0xf] |= 1 << (b >> 4);
+            else
+                a.exit_hi[b & 0xf] |= 1 << ((b >> 4) - 8);
+        }
+
+        // Only worth it if the state tends to consume longer runs of input.
+        if ( num_stay >= 128 ) {
+            t->accel_idx[i] = static_cast<int>(t->accels.size());
+            t->accels.push_back(a);
+        }
+    }
+
+    t->wide = states.size() > static_cast<size_t>(IdxMask<uint16_t>()) + 1;
+
+    if ( t->wide ) {
+        t->Fill(&t->xtions32_buf, next);
+        t->xtions32 = t->xtions32_buf.data();
+    }
+    else {
+        t->Fill(&t->xtions16_buf, next);
+        t->xtions16 = t->xtions16_buf.data();
+    }
+
+    return t;
+}
+
+DFA_Table::~DFA_Table() {
+#ifdef _MSC_VER
+    delete[] static_cast<uint64_t*>(file_map);
+#else
+    if ( file_map )
+        munmap(file_map, file_map_len);
+#endif
+}
+
+namespace {
+
+// Layout of a saved table: this header, then the equivalence class of
+// each byte, the per-state indices into the accepting sets and the
+// accelerated states, those states' Accels, the sizes of the accepting
+// sets and their contents. The transitions follow at xtions_offset, which
+// is aligned for them. Everything is in host byte order.
+struct TableFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t accel_size;
+    uint32_t num_ecs;
+    uint32_t num_states;
+    uint32_t start;
+    uint32_t wide;
+    uint32_t num_accept_sets;
+    uint32_t num_accept_ids;
+    uint32_t num_accels;
+    uint32_t reserved;
+    uint64_t xtions_offset;
+    uint64_t file_size;
+};
+
+constexpr char TABLE_FILE_MAGIC[4] = {'Z', 'D', 'F', 'A'};
+constexpr uint32_t TABLE_FILE_BYTE_ORDER = 0x01020304;
+
+// Reads consecutive arrays out of a loaded file.
+class TableFileReader {
+public:
+    TableFileReader(const char* arg_data, size_t arg_len) : data(arg_data), len(arg_len) {}
+
+    template<typename T>
+    bool Read(std::vector<T>* v, size_t n) {
+        if ( n > (len - pos) / sizeof(T) )
+            return false;
+
+        v->resize(n);
+
+        if ( n > 0 )
+            memcpy(v->data(), data + pos, n * sizeof(T));
+
+        pos += n * sizeof(T);
+        return true;
+    }
+
+    size_t Pos() const { return pos; }
+
+private:
+    const char* data;
+    size_t len;
+    size_t pos = sizeof(TableFileHeader);
+};
+
+} // namespace
+
+bool DFA_Table::Save(const char* path) const {
+    size_t num_states = accept.size();
+    size_t entry_size = wide ? sizeof(uint32_t) : sizeof(uint16_t);
+
+    std::vector<uint32_t> set_sizes;
+    std::vector<int32_t> set_ids;
+
+    for ( const auto& as : accept_sets ) {
+        set_sizes.push_back(as.size());
+        set_ids.insert(set_ids.end(), as.begin(), as.end());
+    }
+
+    TableFileHeader hdr = {};
+    memcpy(hdr.magic, TABLE_FILE_MAGIC, sizeof(hdr.magic));
+    hdr.version = FORMAT_VERSION;
+    hdr.byte_order = TABLE_FILE_BYTE_ORDER;
+    hdr.accel_size = sizeof(Accel);
+    hdr.num_ecs = num_ecs;
+    hdr.num_states = num_states;
+    hdr.start = start;
+    hdr.wide = wide;
+    hdr.num_accept_sets = accept_sets.size();
+    hdr.num_accept_ids = set_ids.size();
+    hdr.num_accels = accels.size();
+
+    size_t pos = sizeof(hdr) + ec_map.size() * sizeof(uint16_t) + 2 * num_states * sizeof(int32_t) +
+                 accels.size() * sizeof(Accel) + set_sizes.size() * sizeof(uint32_t) +
+                 set_ids.size() * sizeof(int32_t);
+
+    hdr.xtions_offset = (pos + 7) & ~size_t(7);
+    hdr.file_size = hdr.xtions_offset + num_states * num_ecs * entry_size;
+
+    // Write to a file of our own first, so that other processes saving the
+    // same table don't interfere.
+    std::string tmp_path = util::fmt("%s.%d.tmp", path, getpid());
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+
+    if ( ! f )
+        return false;
+
+    std::vector<int32_t> accept32(accept.begin(), accept.end());
+    std::vector<int32_t> accel_idx32(accel_idx.begin(), accel_idx.end());
+    static const char padding[8] = {};
+
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    ok = ok && fwrite(ec_map.data(), sizeof(uint16_t), ec_map.size(), f) == ec_map.size();
+    ok = ok && fwrite(accept32.data(), sizeof(int32_t), num_states, f) == num_states;
+    ok = ok && fwrite(accel_idx32.data(), sizeof(int32_t), num_states, f) == num_states;
+    ok = ok && fwrite(accels.data(), sizeof(Accel), accels.size(), f) == accels.size();
+    ok = ok && fwrite(set_sizes.data(), sizeof(uint32_t), set_sizes.size(), f) == set_sizes.size();
+    ok = ok && fwrite(set_ids.data(), sizeof(int32_t), set_ids.size(), f) == set_ids.size();
+    ok = ok && fwrite(padding, 1, hdr.xtions_offset - pos, f) == hdr.xtions_offset - pos;
+
+    size_t num_entries = num_states * num_ecs;
+    if ( wide )
+        ok = ok && fwrite(xtions32, entry_size, num_entries, f) == num_entries;
+    else
+        ok = ok && fwrite(xtions16, entry_size, num_entries, f) == num_entries;
+
+    ok = (fclose(f) == 0) && ok;
+    ok = ok && rename(tmp_path.c_str(), path) == 0;
+
+    if ( ! ok )
+        unlink(tmp_path.c_str());
+
+    return ok;
+}
+
+DFA_Table* DFA_Table::Load(const char* path, const EquivClass* ec, const AcceptingSet& accept_ids) {
+    int fd = open(path, O_RDONLY);
+    if ( fd < 0 )
+        return nullptr;
+
+    struct stat st;
+    if ( fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(TableFileHeader) ) {
+        close(fd);
+        return nullptr;
+    }
+
+    size_t len = st.st_size;
+
+#ifdef _MSC_VER
+    // No mmap() here, so read the file instead.
+    auto* buf = new uint64_t[(len + sizeof(uint64_t) - 1) / sizeof(uint64_t)];
+    void* map = buf;
+
+    if ( read(fd, buf, len) != static_cast<int>(len) ) {
+        delete[] buf;
+        map = nullptr;
+    }
+#else
+    void* map = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+    if ( map == MAP_FAILED )
+        map = nullptr;
+#endif
+
+    close(fd);
+
+    if ( ! map )
+        return nullptr;
+
+    auto t = new DFA_Table();
+    t->file_map = map;
+    t->file_map_len = len;
+
+    const char* data = static_cast<const char*>(map);
+    TableFileHeader hdr;
+    memcpy(&hdr, data, sizeof(hdr));
+
+    size_t entry_size = hdr.wide ? sizeof(uint32_t) : sizeof(uint16_t);
+
+    if ( memcmp(hdr.magic, TABLE_FILE_MAGIC, sizeof(hdr.magic)) != 0 || hdr.version != FORMAT_VERSION ||
+         hdr.byte_order != TABLE_FILE_BYTE_ORDER || hdr.accel_size != sizeof(Accel) ||
+         static_cast<int>(hdr.num_ecs) != ec->NumClasses() || hdr.wide > 1 || hdr.num_states < 2 ||
+         hdr.start >= hdr.num_states || hdr.file_size != len || hdr.xtions_offset < sizeof(hdr) ||
+         hdr.xtions_offset % sizeof(uint64_t) != 0 ||
+         hdr.xtions_offset + uint64_t(hdr.num_states) * hdr.num_ecs * entry_size != len ) {
+        delete t;
+        return nullptr;
+    }
+
+    t->num_ecs = hdr.num_ecs;
+    t->start = hdr.start;
+    t->wide = hdr.wide;
+
+    std::vector<int32_t> accept32;
+    std::vector<int32_t> accel_idx32;
+    std::vector<uint32_t> set_sizes;
+    std::vector<int32_t> set_ids;
+
+    TableFileReader r(data, hdr.xtions_offset);
+
+    bool ok = r.Read(&t->ec_map, 256) && r.Read(&accept32, hdr.num_states) && r.Read(&accel_idx32, hdr.num_states) &&
+              r.Read(&t->accels, hdr.num_accels) && r.Read(&set_sizes, hdr.num_accept_sets) &&
+              r.Read(&set_ids, hdr.num_accept_ids);
+
+    const int* ecs = ec->EquivClasses();
+    for ( int b = 0; ok && b < 256; ++b )
+        ok = t->ec_map[b] == ecs[b];
+
+    // Matchers use the indices to look up rules and patterns, so a
+    // damaged file must not introduce any of its own.
+    for ( size_t i = 0; ok && i < set_ids.size(); ++i )
+        ok = set_ids[i] > 0 && accept_ids.count(set_ids[i]) > 0;
+
+    size_t id_pos = 0;
+    for ( size_t i = 0; ok && i < set_sizes.size(); ++i ) {
+        ok = set_sizes[i] <= set_ids.size() - id_pos;
+
+        if ( ok ) {
+            t->accept_sets.emplace_back(set_ids.begin() + id_pos, set_ids.begin() + id_pos + set_sizes[i]);
+            id_pos += set_sizes[i];
+        }
+    }
+
+    t->accept.assign(accept32.begin(), accept32.end());
+    t->accel_idx.assign(accel_idx32.begin(), accel_idx32.end());
+
+    if ( hdr.wide )
+        t->xtions32 = reinterpret_cast<const uint32_t*>(data + hdr.xtions_offset);
+    else
+        t->xtions16 = reinterpret_cast<const uint16_t*>(data + hdr.xtions_offset);
+
+    if ( ok )
+        ok = hdr.wide ? t->Valid(t->xtions32) : t->Valid(t->xtions16);
+
+    if ( ! ok ) {
+        delete t;
+        return nullptr;
+    }
+
+    return t;
+}
+
+template<typename T>
+bool DFA_Table::Valid(const T* xt) const {
+    int num_states = NumStates();
+
+    if ( accept[JAM] >= 0 || accel_idx[JAM] >= 0 )
+        return false;
+
+    for ( int i = 0; i < num_states; ++i ) {
+        if ( accept[i] >= static_cast<int>(accept_sets.size()) || accel_idx[i] >= static_cast<int>(accels.size()) )
+            return false;
+    }
+
+    // Run() relies on the flags, so they must agree with the states.
+    for ( size_t i = 0; i < static_cast<size_t>(num_states) * num_ecs; ++i ) {
+        State n = xt[i] & IdxMask<T>();
+
+        if ( static_cast<int>(n) >= num_states || ((xt[i] & AcceptFlag<T>()) != 0) != (accept[n] >= 0) ||
+             ((xt[i] & AccelFlag<T>()) != 0) != (accel_idx[n] >= 0) )
+            return false;
+    }
+
+    return true;
+}
+
+template<typename T>
+void DFA_Table::Fill(std::vector<T>* xt, const std::vector<State>& next) {
+    // The jam state's transitions all lead back to it.
+    xt->assign(num_ecs, JAM);
+    xt->reserve(num_ecs + next.size());
+
+    for ( auto n : next ) {
+        T entry = static_cast<T>(n);
+
+        if ( accept[n] >= 0 )
+            entry |= AcceptFlag<T>();
+
+        if ( accel_idx[n] >= 0 )
+            entry |= AccelFlag<T>();
+
+        xt->push_back(entry);
+    }
+}
+
+int DFA_Table::Skip(const Accel& a, const u_char* bv, int n) {
+    int i = 0;
+
+#ifdef __SSSE3__
+    // Tests 16 bytes at a time for membership in the exit set, as in
+    // Hyperscan's "truffle": one table lookup by low nibble per half of
+    // the byte range, one by high nibble for the bit to test.
+    const __m128i exit_lo = _mm_load_si128(reinterpret_cast<const __m128i*>(a.exit_lo));
+    const __m128i exit_hi = _mm_load_si128(reinterpret_cast<const __m128i*>(a.exit_hi));
+    const __m128i high_bit = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i nibble_bits = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+
+    for ( ; i + 16 <= n; i += 16 ) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bv + i));
+
+        // pshufb yields zero for indices with the high bit set, so each
+        // lookup only covers its half of the byte range.
+        __m128i lo = _mm_shuffle_epi8(exit_lo, v);
+        __m128i hi = _mm_shuffle_epi8(exit_hi, _mm_xor_si128(v, high_bit));
+        __m128i bit = _mm_shuffle_epi8(nibble_bits, _mm_andnot_si128(high_bit, _mm_srli_epi64(v, 4)));
+        __m128i hits = _mm_and_si128(_mm_or_si128(lo, hi), bit);
+
+        unsigned int mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(hits, _mm_setzero_si128())) & 0xffff;
+
+        if ( mask ) {
+#ifdef _MSC_VER
+            unsigned long idx;
+            _BitScanForward(&idx, mask);
+            return i + static_cast<int>(idx);
+#else
+            return i + __builtin_ctz(mask);
+#endif
+        }
+    }
+#endif
+
+    while ( i < n && a.stay[bv[i]] )
+        ++i;
+
+    return i;
+}
+
+unsigned int DFA_Table::Size() const {
+    unsigned int size = sizeof(*this) + util::pad_size(ec_map.size() * sizeof(uint16_t)) +
+                        util::pad_size(accept.size() * sizeof(int)) + util::pad_size(accel_idx.size() * sizeof(int)) +
+                        util::pad_size(accels.size() * sizeof(Accel)) + file_map_len;
+
+    size += util::pad_size(xtions16_buf.size() * sizeof(uint16_t)) +
+            util::pad_size(xtions32_buf.size() * sizeof(uint32_t));
+
+    for ( const auto& as : accept_sets )
+        size += util::pad_size(sizeof(as) + as.size() * sizeof(AcceptIdx));
+
+    return size;
+}
+
 } // namespace zeek::detail
@@ -4,8 +4,10 @@
 
 #include <sys/types.h> // for u_char
 #include <cassert>
+#include <cstdint>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "zeek/NFA.h"
 #include "zeek/Obj.h"
@@ -52,6 +54,7 @@ public:
 
 protected:
     friend class DFA_State_Cache;
+    friend class DFA_Table;
 
     DFA_State* ComputeXtion(int sym, DFA_Machine* machine);
     void AppendIfNew(int sym, int_list* sym_list);
@@ -123,6 +126,7 @@ public:
 protected:
     friend class DFA_State; // for DFA_State::ComputeXtion
     friend class DFA_State_Cache;
+    friend class DFA_Table;
 
     int state_count;
 
@@ -137,6 +141,170 @@ protected:
     NFA_Machine* nfa;
 };
 
+// A fully expanded DFA, frozen into one contiguous transition table.
+//
+// The lazily computed DFA_States are scattered across the heap, so
+// matching with them misses the cache on about every byte. The table
+// instead numbers the states densely and stores all transitions in a
+// single array indexed by state and equivalence class, using 16-bit
+// entries when the state numbers fit. Each entry also carries flags for
+// whether the target state accepts and whether it can be skipped through
+// quickly: a non-accepting state that most bytes loop back to lets Run()
+// search for the next byte leaving it instead of stepping through the
+// table, using SIMD where available.
+//
+// A table can be saved to a file and loaded back later, which skips
+// computing the DFA. Loading maps the file into memory, so processes
+// that load the same file share its pages.
+class DFA_Table {
+public:
+    using State = uint32_t;
+
+    // The state that a jammed DFA ends up in. It never accepts.
+    static constexpr State JAM = 0;
+
+    // Version of the file format written by Save(). Bump it whenever the
+    // format or the way tables are built changes.
+    static constexpr uint32_t FORMAT_VERSION = 1;
+
+    DFA_Table() = default;
+    ~DFA_Table();
+
+    DFA_Table(const DFA_Table&) = delete;
+    DFA_Table& operator=(const DFA_Table&) = delete;
+
+    // Computes all states of the machine and their transitions. Returns
+    // null if there are more than max_states of them.
+    static DFA_Table* Build(DFA_Machine* m, int max_states);
+
+    // Loads a table that Save() wrote. Returns null if the file doesn't
+    // exist, is damaged, was built for other equivalence classes than the
+    // given ones, or accepts with an index that isn't in accept_ids.
+    static DFA_Table* Load(const char* path, const EquivClass* ec, const AcceptingSet& accept_ids);
+
+    // Writes the table to a file. The file gets replaced atomically, so
+    // concurrent Load() calls never see a partial table.
+    bool Save(const char* path) const;
+
+    State Start() const { return start; }
+
+    // Returns the state following s on equivalence class ec.
+    State Next(State s, int ec) const {
+        size_t i = s * num_ecs + ec;
+        return wide ? xtions32[i] & IdxMask<uint32_t>() : xtions16[i] & IdxMask<uint16_t>();
+    }
+
+    const AcceptingSet* Accept(State s) const { return accept[s] >= 0 ? &accept_sets[accept[s]] : nullptr; }
+
+    // Feeds bytes into the table, starting in state *s. Stops after the
+    // first transition that changes into an accepting state, or when the
+    // table jams. Returns the number of bytes consumed without jamming;
+    // *s holds the state reached, or JAM if the next byte jammed.
+    int Run(State* s, const u_char* bv, int n) const {
+        return wide ? DoRun(xtions32, s, bv, n) : DoRun(xtions16, s, bv, n);
+    }
+
+    int NumStates() const { return static_cast<int>(accept.size()); }
+
+    unsigned int Size() const;
+
+private:
+    // Bytes that leave a state which otherwise loops back to itself.
+    struct Accel {
+        bool stay[256];
+        alignas(16) uint8_t exit_lo[16]; // Exits with high nibble 0-7.
+        alignas(16) uint8_t exit_hi[16]; // Exits with high nibble 8-15.
+    };
+
+    template<typename T>
+    static constexpr T AcceptFlag() {
+        return T(1) << (sizeof(T) * 8 - 1);
+    }
+
+    template<typename T>
+    static constexpr T AccelFlag() {
+        return T(1) << (sizeof(T) * 8 - 2);
+    }
+
+    template<typename T>
+    static constexpr T IdxMask() {
+        return AccelFlag<T>() - 1;
+    }
+
+    // Returns the number of leading bytes that stay in the accelerated
+    // state.
+    static int Skip(const Accel& a, const u_char* bv, int n);
+
+    template<typename T>
+    int DoRun(const T* xt, State* s, const u_char* bv, int n) const;
+
+    template<typename T>
+    void Fill(std::vector<T>* xt, const std::vector<State>& next);
+
+    // Checks that a loaded table's indices stay in bounds.
+    template<typename T>
+    bool Valid(const T* xt) const;
+
+    int num_ecs = 0;
+    State start = JAM;
+    bool wide = false;
+
+    // The transitions, pointing either into the vectors below or into a
+    // loaded file.
+    const uint16_t* xtions16 = nullptr;
+    const uint32_t* xtions32 = nullptr;
+    std::vector<uint16_t> xtions16_buf;
+    std::vector<uint32_t> xtions32_buf;
+    void* file_map = nullptr;
+    size_t file_map_len = 0;
+
+    std::vector<uint16_t> ec_map; // Equivalence class of each byte.
+
+    std::vector<int> accept; // Per state, index into accept_sets or -1.
+    std::vector<AcceptingSet> accept_sets;
+    std::vector<int> accel_idx; // Per state, index into accels or -1.
+    std::vector<Accel> accels;
+};
+
+template<typename T>
+int DFA_Table::DoRun(const T* xt, State* s, const u_char* bv, int n) const {
+    T cur = static_cast<T>(*s);
+    if ( accept[cur] >= 0 )
+        cur |= AcceptFlag<T>();
+    if ( accel_idx[cur & IdxMask<T>()] >= 0 )
+        cur |= AccelFlag<T>();
+
+    int i = 0;
+
+    while ( i < n ) {
+        if ( cur & AccelFlag<T>() ) {
+            i += Skip(accels[accel_idx[cur & IdxMask<T>()]], bv + i, n - i);
+            if ( i == n )
+                break;
+        }
+
+        T next = xt[(cur & IdxMask<T>()) * num_ecs + ec_map[bv[i]]];
+
+        if ( next == JAM ) {
+            *s = JAM;
+            return i;
+        }
+
+        ++i;
+
+        // Entering the same accepting state again doesn't add any matches.
+        if ( (next & AcceptFlag<T>()) && next != cur ) {
+            cur = next;
+            break;
+        }
+
+        cur = next;
+    }
+
+    *s = cur & IdxMask<T>();
+    return i;
+}
+
 inline DFA_State* DFA_State::Xtion(int sym, DFA_Machine* machine) {
     if ( xtions[sym] == DFA_UNCOMPUTED_STATE_PTR )
         return ComputeXtion(sym, machine);
@@ -716,6 +716,9 @@ public:
     // Total number of entries ever.
     uint64_t NumCumulativeInserts() const { return cum_entries; }
 
+    // Number of iterators currently active on the dictionary.
+    int NumIterators() const { return num_iterators; }
+
     // True if the dictionary is ordered, false otherwise.
     int IsOrdered() const { return order != nullptr; }
 
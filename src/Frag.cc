@@ -141,6 +141,14 @@ void FragReassembler::AddFragment(double t, const std::shared_ptr<IP_Hdr>& ip, c
     NewBlock(run_state::network_time, offset, len, pkt);
 }
 
+void FragReassembler::Evict() {
+    Weird("reassembly_memory_budget_exceeded");
+
+    // Incomplete fragments are of no use, so just drop them. The expiration
+    // timer will clean up the rest.
+    ClearBlocks();
+}
+
 void FragReassembler::Weird(const char* name) const {
     unsigned int version = ((const ip*)proto_hdr)->ip_v;
 
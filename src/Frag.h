@@ -43,6 +43,7 @@ public:
 protected:
     void BlockInserted(DataBlockMap::const_iterator it) override;
     void Overlap(const u_char* b1, const u_char* b2, uint64_t n) override;
+    void Evict() override;
     void Weird(const char* name) const;
 
     u_char* proto_hdr;
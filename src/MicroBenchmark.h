@@ -0,0 +1,68 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// Helpers for the microbenchmarks that live next to the unit tests as
+// doctest cases skipped by default. Run them with
+// "zeek --test --no-skip --test-case='<name>'".
+
+#pragma once
+
+#include <chrono>
+#include <cstdlib>
+#include <vector>
+
+namespace zeek::detail {
+
+/**
+ * Returns the problem sizes a microbenchmark should run with: the
+ * comma-separated list of numbers in the given environment variable if
+ * it's set, otherwise the defaults. Zero sizes are dropped.
+ *
+ * @param env_var the name of the environment variable.
+ * @param defaults the sizes to use if the variable isn't set.
+ */
+inline std::vector<size_t> benchmark_sizes(const char* env_var, std::vector<size_t> defaults) {
+    const char* env = getenv(env_var);
+
+    if ( ! env )
+        return defaults;
+
+    std::vector<size_t> sizes;
+
+    for ( const char* p = env; *p; ) {
+        char* end;
+        auto n = strtoull(p, &end, 10);
+        if ( end == p )
+            break;
+
+        if ( n > 0 )
+            sizes.push_back(n);
+
+        p = *end == ',' ? end + 1 : end;
+    }
+
+    return sizes;
+}
+
+/**
+ * Measures wall-clock time between laps.
+ */
+class Stopwatch {
+public:
+    Stopwatch() : last(clock::now()) {}
+
+    /**
+     * @return the seconds elapsed since construction or the previous lap.
+     */
+    double Lap() {
+        auto now = clock::now();
+        std::chrono::duration<double> d = now - last;
+        last = now;
+        return d.count();
+    }
+
+private:
+    using clock = std::chrono::steady_clock;
+    clock::time_point last;
+};
+
+} // namespace zeek::detail
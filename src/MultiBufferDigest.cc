@@ -0,0 +1,703 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+// The multi-buffer engine continues hashes in the low-level OpenSSL MD5, SHA1
+// and SHA256 states, which OpaqueVal.cc already relies on for serialization.
+// Those APIs are deprecated as of OpenSSL 3.0; see the comment there.
+
+#define OPENSSL_SUPPRESS_DEPRECATED
+
+#include "zeek/MultiBufferDigest.h"
+
+#include <openssl/md5.h>
+#include <openssl/sha.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+#include "zeek/3rdparty/doctest.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+namespace zeek::detail {
+
+namespace {
+
+constexpr int LANES = MultiBufferDigest::LANES;
+constexpr size_t BLOCK_SIZE = 64;
+
+// Hash states for all lanes, one row per state word and one column per lane.
+using LaneStates = uint32_t[8][LANES];
+
+using BlocksFunc = void (*)(LaneStates& st, const u_char* const* data, size_t blocks);
+
+#if defined(__GNUC__)
+
+#if ! defined(__clang__)
+// The vector types below never cross a call boundary, so GCC's note about
+// their ABI doesn't apply.
+#pragma GCC diagnostic ignored "-Wpsabi"
+#endif
+
+#define ZEEK_MB_INLINE inline __attribute__((always_inline))
+
+// One 32-bit word per lane. Depending on the target, the compiler maps
+// operations on it to a single AVX2/AVX-512 instruction or to several
+// narrower ones.
+using u32xL = uint32_t __attribute__((vector_size(LANES * sizeof(uint32_t))));
+
+ZEEK_MB_INLINE u32xL rotl(u32xL x, int n) { return (x << n) | (x >> (32 - n)); }
+
+ZEEK_MB_INLINE u32xL rotr(u32xL x, int n) { return (x >> n) | (x << (32 - n)); }
+
+ZEEK_MB_INLINE u32xL splat(uint32_t x) { return u32xL{} + x; }
+
+ZEEK_MB_INLINE u32xL load_lanes(const uint32_t* row) {
+    u32xL v;
+    memcpy(&v, row, sizeof(v));
+    return v;
+}
+
+ZEEK_MB_INLINE void store_lanes(uint32_t* row, u32xL v) { memcpy(row, &v, sizeof(v)); }
+
+// Transposes the message words of each lane's current block into one
+// vector per word.
+template<bool big_endian>
+ZEEK_MB_INLINE void load_block(const u_char* const* data, size_t offset, u32xL w[16]) {
+    alignas(64) uint32_t t[16][LANES];
+
+    for ( int l = 0; l < LANES; ++l ) {
+        const u_char* p = data[l] + offset;
+
+        for ( int i = 0; i < 16; ++i, p += 4 ) {
+            if ( big_endian )
+                t[i][l] = uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 8 | uint32_t(p[3]);
+            else
+                t[i][l] = uint32_t(p[3]) << 24 | uint32_t(p[2]) << 16 | uint32_t(p[1]) << 8 | uint32_t(p[0]);
+        }
+    }
+
+    for ( int i = 0; i < 16; ++i )
+        w[i] = load_lanes(t[i]);
+}
+
+// -- MD5
+
+constexpr uint32_t md5_k[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+#define MD5_STEP(f, a, b, c, d, x, i, s) a = b + rotl(a + f(b, c, d) + x + splat(md5_k[i]), s)
+#define MD5_F(b, c, d) (d ^ (b & (c ^ d)))
+#define MD5_G(b, c, d) (c ^ (d & (b ^ c)))
+#define MD5_H(b, c, d) (b ^ c ^ d)
+#define MD5_I(b, c, d) (c ^ (b | ~d))
+
+ZEEK_MB_INLINE void md5_blocks_impl(LaneStates& st, const u_char* const* data, size_t blocks) {
+    u32xL a = load_lanes(st[0]);
+    u32xL b = load_lanes(st[1]);
+    u32xL c = load_lanes(st[2]);
+    u32xL d = load_lanes(st[3]);
+
+    for ( size_t n = 0; n < blocks; ++n ) {
+        u32xL w[16];
+        load_block<false>(data, n * BLOCK_SIZE, w);
+
+        u32xL aa = a, bb = b, cc = c, dd = d;
+
+        MD5_STEP(MD5_F, a, b, c, d, w[0], 0, 7);
+        MD5_STEP(MD5_F, d, a, b, c, w[1], 1, 12);
+        MD5_STEP(MD5_F, c, d, a, b, w[2], 2, 17);
+        MD5_STEP(MD5_F, b, c, d, a, w[3], 3, 22);
+        MD5_STEP(MD5_F, a, b, c, d, w[4], 4, 7);
+        MD5_STEP(MD5_F, d, a, b, c, w[5], 5, 12);
+        MD5_STEP(MD5_F, c, d, a, b, w[6], 6, 17);
+        MD5_STEP(MD5_F, b, c, d, a, w[7], 7, 22);
+        MD5_STEP(MD5_F, a, b, c, d, w[8], 8, 7);
+        MD5_STEP(MD5_F, d, a, b, c, w[9], 9, 12);
+        MD5_STEP(MD5_F, c, d, a, b, w[10], 10, 17);
+        MD5_STEP(MD5_F, b, c, d, a, w[11], 11, 22);
+        MD5_STEP(MD5_F, a, b, c, d, w[12], 12, 7);
+        MD5_STEP(MD5_F, d, a, b, c, w[13], 13, 12);
+        MD5_STEP(MD5_F, c, d, a, b, w[14], 14, 17);
+        MD5_STEP(MD5_F, b, c, d, a, w[15], 15, 22);
+
+        MD5_STEP(MD5_G, a, b, c, d, w[1], 16, 5);
+        MD5_STEP(MD5_G, d, a, b, c, w[6], 17, 9);
+        MD5_STEP(MD5_G, c, d, a, b, w[11], 18, 14);
+        MD5_STEP(MD5_G, b, c, d, a, w[0], 19, 20);
+        MD5_STEP(MD5_G, a, b, c, d, w[5], 20, 5);
+        MD5_STEP(MD5_G, d, a, b, c, w[10], 21, 9);
+        MD5_STEP(MD5_G, c, d, a, b, w[15], 22, 14);
+        MD5_STEP(MD5_G, b, c, d, a, w[4], 23, 20);
+        MD5_STEP(MD5_G, a, b, c, d, w[9], 24, 5);
+        MD5_STEP(MD5_G, d, a, b, c, w[14], 25, 9);
+        MD5_STEP(MD5_G, c, d, a, b, w[3], 26, 14);
+        MD5_STEP(MD5_G, b, c, d, a, w[8], 27, 20);
+        MD5_STEP(MD5_G, a, b, c, d, w[13], 28, 5);
+        MD5_STEP(MD5_G, d, a, b, c, w[2], 29, 9);
+        MD5_STEP(MD5_G, c, d, a, b, w[7], 30, 14);
+        MD5_STEP(MD5_G, b, c, d, a, w[12], 31, 20);
+
+        MD5_STEP(MD5_H, a, b, c, d, w[5], 32, 4);
+        MD5_STEP(MD5_H, d, a, b, c, w[8], 33, 11);
+        MD5_STEP(MD5_H, c, d, a, b, w[11], 34, 16);
+        MD5_STEP(MD5_H, b, c, d, a, w[14], 35, 23);
+        MD5_STEP(MD5_H, a, b, c, d, w[1], 36, 4);
+        MD5_STEP(MD5_H, d, a, b, c, w[4], 37, 11);
+        MD5_STEP(MD5_H, c, d, a, b, w[7], 38, 16);
+        MD5_STEP(MD5_H, b, c, d, a, w[10], 39, 23);
+        MD5_STEP(MD5_H, a, b, c, d, w[13], 40, 4);
+        MD5_STEP(MD5_H, d, a, b, c, w[0], 41, 11);
+        MD5_STEP(MD5_H, c, d, a, b, w[3], 42, 16);
+        MD5_STEP(MD5_H, b, c, d, a, w[6], 43, 23);
+        MD5_STEP(MD5_H, a, b, c, d, w[9], 44, 4);
+        MD5_STEP(MD5_H, d, a, b, c, w[12], 45, 11);
+        MD5_STEP(MD5_H, c, d, a, b, w[15], 46, 16);
+        MD5_STEP(MD5_H, b, c, d, a, w[2], 47, 23);
+
+        MD5_STEP(MD5_I, a, b, c, d, w[0], 48, 6);
+        MD5_STEP(MD5_I, d, a, b, c, w[7], 49, 10);
+        MD5_STEP(MD5_I, c, d, a, b, w[14], 50, 15);
+        MD5_STEP(MD5_I, b, c, d, a, w[5], 51, 21);
+        MD5_STEP(MD5_I, a, b, c, d, w[12], 52, 6);
+        MD5_STEP(MD5_I, d, a, b, c, w[3], 53, 10);
+        MD5_STEP(MD5_I, c, d, a, b, w[10], 54, 15);
+        MD5_STEP(MD5_I, b, c, d, a, w[1], 55, 21);
+        MD5_STEP(MD5_I, a, b, c, d, w[8], 56, 6);
+        MD5_STEP(MD5_I, d, a, b, c, w[15], 57, 10);
+        MD5_STEP(MD5_I, c, d, a, b, w[6], 58, 15);
+        MD5_STEP(MD5_I, b, c, d, a, w[13], 59, 21);
+        MD5_STEP(MD5_I, a, b, c, d, w[4], 60, 6);
+        MD5_STEP(MD5_I, d, a, b, c, w[11], 61, 10);
+        MD5_STEP(MD5_I, c, d, a, b, w[2], 62, 15);
+        MD5_STEP(MD5_I, b, c, d, a, w[9], 63, 21);
+
+        a += aa;
+        b += bb;
+        c += cc;
+        d += dd;
+    }
+
+    store_lanes(st[0], a);
+    store_lanes(st[1], b);
+    store_lanes(st[2], c);
+    store_lanes(st[3], d);
+}
+
+#undef MD5_STEP
+#undef MD5_F
+#undef MD5_G
+#undef MD5_H
+#undef MD5_I
+
+// -- SHA1
+
+#define SHA1_ROUNDS(from, to, f, k)                                                                                    \
+    for ( int t = from; t < to; ++t ) {                                                                                \
+        if ( t >= 16 )                                                                                                 \
+            w[t & 15] = rotl(w[(t - 3) & 15] ^ w[(t - 8) & 15] ^ w[(t - 14) & 15] ^ w[t & 15], 1);                     \
+                                                                                                                       \
+        u32xL tmp = rotl(a, 5) + (f) + e + splat(k) + w[t & 15];                                                       \
+        e = d;                                                                                                         \
+        d = c;                                                                                                         \
+        c = rotl(b, 30);                                                                                               \
+        b = a;                                                                                                         \
+        a = tmp;                                                                                                       \
+    }
+
+ZEEK_MB_INLINE void sha1_blocks_impl(LaneStates& st, const u_char* const* data, size_t blocks) {
+    u32xL h[5];
+
+    for ( int i = 0; i < 5; ++i )
+        h[i] = load_lanes(st[i]);
+
+    for ( size_t n = 0; n < blocks; ++n ) {
+        u32xL w[16];
+        load_block<true>(data, n * BLOCK_SIZE, w);
+
+        u32xL a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+
+        SHA1_ROUNDS(0, 20, d ^ (b & (c ^ d)), 0x5a827999);
+        SHA1_ROUNDS(20, 40, b ^ c ^ d, 0x6ed9eba1);
+        SHA1_ROUNDS(40, 60, (b & c) | (d & (b | c)), 0x8f1bbcdc);
+        SHA1_ROUNDS(60, 80, b ^ c ^ d, 0xca62c1d6);
+
+#undef SHA1_ROUNDS
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    for ( int i = 0; i < 5; ++i )
+        store_lanes(st[i], h[i]);
+}
+
+// -- SHA256
+
+constexpr uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+ZEEK_MB_INLINE void sha256_blocks_impl(LaneStates& st, const u_char* const* data, size_t blocks) {
+    u32xL h[8];
+
+    for ( int i = 0; i < 8; ++i )
+        h[i] = load_lanes(st[i]);
+
+    for ( size_t n = 0; n < blocks; ++n ) {
+        u32xL w[16];
+        load_block<true>(data, n * BLOCK_SIZE, w);
+
+        u32xL a = h[0], b = h[1], c = h[2], d = h[3], e = h[4], f = h[5], g = h[6], hh = h[7];
+
+        for ( int t = 0; t < 64; ++t ) {
+            if ( t >= 16 ) {
+                u32xL w15 = w[(t - 15) & 15];
+                u32xL w2 = w[(t - 2) & 15];
+                u32xL s0 = rotr(w15, 7) ^ rotr(w15, 18) ^ (w15 >> 3);
+                u32xL s1 = rotr(w2, 17) ^ rotr(w2, 19) ^ (w2 >> 10);
+                w[t & 15] += s0 + w[(t - 7) & 15] + s1;
+            }
+
+            u32xL t1 = hh + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + (g ^ (e & (f ^ g))) + splat(sha256_k[t]) +
+                       w[t & 15];
+            u32xL t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) | (c & (a | b)));
+            hh = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+        h[5] += f;
+        h[6] += g;
+        h[7] += hh;
+    }
+
+    for ( int i = 0; i < 8; ++i )
+        store_lanes(st[i], h[i]);
+}
+
+// Instantiates the kernels for the baseline target and, on x86, for AVX2
+// and AVX-512, of which the best one the CPU supports gets picked at runtime.
+
+#define ZEEK_MB_KERNELS(suffix, attr)                                                                                  \
+    attr void md5_blocks_##suffix(LaneStates& st, const u_char* const* data, size_t blocks) {                          \
+        md5_blocks_impl(st, data, blocks);                                                                             \
+    }                                                                                                                  \
+    attr void sha1_blocks_##suffix(LaneStates& st, const u_char* const* data, size_t blocks) {                         \
+        sha1_blocks_impl(st, data, blocks);                                                                            \
+    }                                                                                                                  \
+    attr void sha256_blocks_##suffix(LaneStates& st, const u_char* const* data, size_t blocks) {                       \
+        sha256_blocks_impl(st, data, blocks);                                                                          \
+    }
+
+ZEEK_MB_KERNELS(generic, )
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ZEEK_MB_X86
+ZEEK_MB_KERNELS(avx2, __attribute__((target("avx2"))))
+ZEEK_MB_KERNELS(avx512, __attribute__((target("avx2,avx512f,avx512vl"))))
+#endif
+
+#undef ZEEK_MB_KERNELS
+
+// Returns true if the CPU has SHA instructions, with which OpenSSL's
+// single-stream SHA1 and SHA256 beat the multi-buffer kernels.
+bool have_sha_instructions() {
+#ifdef ZEEK_MB_X86
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & bit_SHA);
+#else
+    // Most other 64-bit platforms (in particular ARMv8) have them, too.
+    return true;
+#endif
+}
+
+BlocksFunc select_kernel(BlocksFunc generic, BlocksFunc avx2, BlocksFunc avx512) {
+#ifdef ZEEK_MB_X86
+    __builtin_cpu_init();
+
+    if ( __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512vl") )
+        return avx512;
+
+    if ( __builtin_cpu_supports("avx2") )
+        return avx2;
+#endif
+
+    return generic;
+}
+
+#ifdef ZEEK_MB_X86
+#define ZEEK_MB_SELECT(alg) select_kernel(alg##_blocks_generic, alg##_blocks_avx2, alg##_blocks_avx512)
+#else
+#define ZEEK_MB_SELECT(alg) select_kernel(alg##_blocks_generic, nullptr, nullptr)
+#endif
+
+#endif // __GNUC__
+
+// Adds a number of bytes to the bit count kept by OpenSSL's MD5/SHA states.
+void add_length(unsigned int& nl, unsigned int& nh, uint64_t len) {
+    unsigned int l = nl + static_cast<unsigned int>(len << 3);
+
+    if ( l < nl )
+        ++nh;
+
+    nh += static_cast<unsigned int>(len >> 29);
+    nl = l;
+}
+
+} // namespace
+
+// Glue between the engine and one algorithm's OpenSSL state and kernel.
+struct MultiBufferDigest::Algorithm {
+    int words;
+    BlocksFunc blocks;
+    unsigned int (*partial)(const void* state);
+    void (*update)(void* state, const void* data, size_t len);
+    void (*load)(const void* state, LaneStates& st, int lane);
+    void (*store)(void* state, const LaneStates& st, int lane, uint64_t len);
+};
+
+MultiBufferDigest* MultiBufferDigest::Get(HashAlgorithm alg, bool even_if_slower) {
+#if defined(__GNUC__)
+    static const Algorithm md5_alg = {
+        4,
+        ZEEK_MB_SELECT(md5),
+        [](const void* state) { return static_cast<const MD5_CTX*>(state)->num; },
+        [](void* state, const void* data, size_t len) { MD5_Update(static_cast<MD5_CTX*>(state), data, len); },
+        [](const void* state, LaneStates& st, int lane) {
+            auto ctx = static_cast<const MD5_CTX*>(state);
+            st[0][lane] = ctx->A;
+            st[1][lane] = ctx->B;
+            st[2][lane] = ctx->C;
+            st[3][lane] = ctx->D;
+        },
+        [](void* state, const LaneStates& st, int lane, uint64_t len) {
+            auto ctx = static_cast<MD5_CTX*>(state);
+            ctx->A = st[0][lane];
+            ctx->B = st[1][lane];
+            ctx->C = st[2][lane];
+            ctx->D = st[3][lane];
+            add_length(ctx->Nl, ctx->Nh, len);
+        },
+    };
+
+    static const Algorithm sha1_alg = {
+        5,
+        ZEEK_MB_SELECT(sha1),
+        [](const void* state) { return static_cast<const SHA_CTX*>(state)->num; },
+        [](void* state, const void* data, size_t len) { SHA1_Update(static_cast<SHA_CTX*>(state), data, len); },
+        [](const void* state, LaneStates& st, int lane) {
+            auto ctx = static_cast<const SHA_CTX*>(state);
+            st[0][lane] = ctx->h0;
+            st[1][lane] = ctx->h1;
+            st[2][lane] = ctx->h2;
+            st[3][lane] = ctx->h3;
+            st[4][lane] = ctx->h4;
+        },
+        [](void* state, const LaneStates& st, int lane, uint64_t len) {
+            auto ctx = static_cast<SHA_CTX*>(state);
+            ctx->h0 = st[0][lane];
+            ctx->h1 = st[1][lane];
+            ctx->h2 = st[2][lane];
+            ctx->h3 = st[3][lane];
+            ctx->h4 = st[4][lane];
+            add_length(ctx->Nl, ctx->Nh, len);
+        },
+    };
+
+    static const Algorithm sha256_alg = {
+        8,
+        ZEEK_MB_SELECT(sha256),
+        [](const void* state) { return static_cast<const SHA256_CTX*>(state)->num; },
+        [](void* state, const void* data, size_t len) { SHA256_Update(static_cast<SHA256_CTX*>(state), data, len); },
+        [](const void* state, LaneStates& st, int lane) {
+            auto ctx = static_cast<const SHA256_CTX*>(state);
+            for ( int i = 0; i < 8; ++i )
+                st[i][lane] = ctx->h[i];
+        },
+        [](void* state, const LaneStates& st, int lane, uint64_t len) {
+            auto ctx = static_cast<SHA256_CTX*>(state);
+            for ( int i = 0; i < 8; ++i )
+                ctx->h[i] = st[i][lane];
+            add_length(ctx->Nl, ctx->Nh, len);
+        },
+    };
+
+    static MultiBufferDigest md5_engine(&md5_alg);
+    static MultiBufferDigest sha1_engine(&sha1_alg);
+    static MultiBufferDigest sha256_engine(&sha256_alg);
+
+    static bool sha_instructions = have_sha_instructions();
+
+    switch ( alg ) {
+        case Hash_MD5: return &md5_engine;
+        case Hash_SHA1: return sha_instructions && ! even_if_slower ? nullptr : &sha1_engine;
+        case Hash_SHA256: return sha_instructions && ! even_if_slower ? nullptr : &sha256_engine;
+        default: return nullptr;
+    }
+#else
+    return nullptr;
+#endif
+}
+
+void MultiBufferDigest::Enqueue(MultiBufferDigestStream* s, size_t bytes) {
+    if ( ! s->queued ) {
+        s->queued = true;
+        queued.push_back(s);
+    }
+
+    queued_bytes += bytes;
+
+    if ( queued_bytes >= MAX_QUEUED_BYTES )
+        Run();
+}
+
+void MultiBufferDigest::Dequeue(MultiBufferDigestStream* s) {
+    if ( ! s->queued )
+        return;
+
+    queued.erase(std::find(queued.begin(), queued.end(), s));
+    queued_bytes -= s->pending.size();
+    s->queued = false;
+}
+
+void MultiBufferDigest::Run() {
+    // Input before the first block boundary, and after the last one, is
+    // left to OpenSSL. The blocks in between get hashed across the lanes.
+    struct Tail {
+        void* state;
+        const u_char* data;
+        size_t len;
+    };
+
+    std::vector<Job> jobs;
+    std::vector<Tail> tails;
+    jobs.reserve(queued.size());
+    tails.reserve(queued.size());
+
+    for ( auto s : queued ) {
+        const auto* data = reinterpret_cast<const u_char*>(s->pending.data());
+        size_t len = s->pending.size();
+
+        if ( auto partial = alg->partial(s->state) ) {
+            size_t n = std::min(len, BLOCK_SIZE - partial);
+            alg->update(s->state, data, n);
+            data += n;
+            len -= n;
+        }
+
+        size_t blocks = len / BLOCK_SIZE;
+
+        if ( blocks > 0 )
+            jobs.push_back({s->state, data, blocks});
+
+        if ( len % BLOCK_SIZE > 0 )
+            tails.push_back({s->state, data + blocks * BLOCK_SIZE, len % BLOCK_SIZE});
+    }
+
+    RunLanes(jobs);
+
+    for ( const auto& t : tails )
+        alg->update(t.state, t.data, t.len);
+
+    for ( auto s : queued ) {
+        s->pending.clear();
+        s->queued = false;
+    }
+
+    queued.clear();
+    queued_bytes = 0;
+}
+
+void MultiBufferDigest::RunLanes(const std::vector<Job>& jobs) {
+    alignas(64) LaneStates st = {};
+    const u_char* data[LANES];
+    size_t remaining[LANES];
+    size_t done[LANES];
+    const Job* lane_jobs[LANES] = {};
+    size_t next = 0;
+    int active = 0;
+
+    auto fill = [&](int l) {
+        if ( next == jobs.size() ) {
+            lane_jobs[l] = nullptr;
+            return;
+        }
+
+        const Job& j = jobs[next++];
+        lane_jobs[l] = &j;
+        data[l] = j.data;
+        remaining[l] = j.blocks;
+        done[l] = 0;
+        alg->load(j.state, st, l);
+        ++active;
+    };
+
+    for ( int l = 0; l < LANES; ++l )
+        fill(l);
+
+    // With a single stream left, OpenSSL's scalar implementation is faster.
+    while ( active > 1 ) {
+        size_t n = SIZE_MAX;
+        int some_lane = 0;
+
+        for ( int l = 0; l < LANES; ++l ) {
+            if ( lane_jobs[l] ) {
+                n = std::min(n, remaining[l]);
+                some_lane = l;
+            }
+        }
+
+        // Idle lanes hash a copy of an active lane's input. Their
+        // results are ignored.
+        for ( int l = 0; l < LANES; ++l ) {
+            if ( ! lane_jobs[l] )
+                data[l] = data[some_lane];
+        }
+
+        alg->blocks(st, data, n);
+
+        for ( int l = 0; l < LANES; ++l ) {
+            if ( ! lane_jobs[l] )
+                continue;
+
+            data[l] += n * BLOCK_SIZE;
+            remaining[l] -= n;
+            done[l] += n;
+
+            if ( remaining[l] == 0 ) {
+                alg->store(lane_jobs[l]->state, st, l, done[l] * BLOCK_SIZE);
+                --active;
+                fill(l);
+            }
+        }
+    }
+
+    for ( int l = 0; l < LANES; ++l ) {
+        if ( ! lane_jobs[l] )
+            continue;
+
+        alg->store(lane_jobs[l]->state, st, l, done[l] * BLOCK_SIZE);
+        alg->update(lane_jobs[l]->state, data[l], remaining[l] * BLOCK_SIZE);
+    }
+}
+
+MultiBufferDigestStream::MultiBufferDigestStream(MultiBufferDigest* engine, void* native_state)
+    : engine(engine), state(native_state) {}
+
+MultiBufferDigestStream::~MultiBufferDigestStream() { engine->Dequeue(this); }
+
+void MultiBufferDigestStream::Feed(const void* data, size_t size) {
+    if ( size == 0 )
+        return;
+
+    pending.append(static_cast<const char*>(data), size);
+    engine->Enqueue(this, size);
+}
+
+void MultiBufferDigestStream::Flush() {
+    if ( queued )
+        engine->Run();
+}
+
+TEST_SUITE_BEGIN("MultiBufferDigest");
+
+TEST_CASE("multi-buffer digests match OpenSSL") {
+    for ( auto alg : {Hash_MD5, Hash_SHA1, Hash_SHA256} ) {
+        auto engine = MultiBufferDigest::Get(alg, true);
+
+        if ( ! engine )
+            continue;
+
+        // More streams than lanes, with differing lengths and chunk sizes
+        // so that lanes finish at different times.
+        constexpr int num_streams = 2 * MultiBufferDigest::LANES + 3;
+        MD5_CTX md5[num_streams];
+        SHA_CTX sha1[num_streams];
+        SHA256_CTX sha256[num_streams];
+        std::vector<std::string> input(num_streams);
+        std::vector<std::unique_ptr<MultiBufferDigestStream>> streams;
+
+        for ( int i = 0; i < num_streams; ++i ) {
+            MD5_Init(&md5[i]);
+            SHA1_Init(&sha1[i]);
+            SHA256_Init(&sha256[i]);
+
+            void* state = alg == Hash_MD5 ? static_cast<void*>(&md5[i]) :
+                          alg == Hash_SHA1 ? static_cast<void*>(&sha1[i]) :
+                                             static_cast<void*>(&sha256[i]);
+
+            streams.push_back(std::make_unique<MultiBufferDigestStream>(engine, state));
+        }
+
+        for ( int round = 0; round < 50; ++round ) {
+            for ( int i = 0; i < num_streams; ++i ) {
+                if ( (round + i) % 5 == 0 )
+                    continue;
+
+                std::string chunk((round * 37 + i * 101) % 700, static_cast<char>('a' + (round + i) % 26));
+                input[i] += chunk;
+                streams[i]->Feed(chunk.data(), chunk.size());
+            }
+
+            if ( round % 7 == 0 )
+                streams[round % num_streams]->Flush();
+        }
+
+        for ( int i = 0; i < num_streams; ++i ) {
+            streams[i]->Flush();
+
+            u_char got[ZEEK_SHA256_DIGEST_LENGTH];
+            u_char expected[ZEEK_SHA256_DIGEST_LENGTH];
+            size_t len = ZEEK_SHA256_DIGEST_LENGTH;
+
+            if ( alg == Hash_MD5 ) {
+                MD5_Final(got, &md5[i]);
+                len = ZEEK_MD5_DIGEST_LENGTH;
+            }
+            else if ( alg == Hash_SHA1 ) {
+                SHA1_Final(got, &sha1[i]);
+                len = ZEEK_SHA_DIGEST_LENGTH;
+            }
+            else
+                SHA256_Final(got, &sha256[i]);
+
+            calculate_digest(alg, reinterpret_cast<const u_char*>(input[i].data()), input[i].size(), expected);
+            CHECK(memcmp(got, expected, len) == 0);
+        }
+    }
+}
+
+TEST_SUITE_END();
+
+} // namespace zeek::detail
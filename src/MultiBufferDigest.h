@@ -0,0 +1,122 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+/**
+ * Multi-buffer hashing: computes MD5, SHA1 and SHA256 digests of many
+ * independent streams at once by running one stream per SIMD lane.
+ */
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "zeek/digest.h"
+
+namespace zeek::detail {
+
+class MultiBufferDigest;
+
+/**
+ * A stream of input for one hash state. Input is buffered and hashed
+ * together with other streams of the same algorithm once enough has
+ * accumulated across all of them, or whenever Flush() is called.
+ *
+ * Streams aren't thread-safe: all streams of an algorithm must be fed
+ * from the same thread (the main thread).
+ */
+class MultiBufferDigestStream {
+public:
+    /**
+     * Constructor.
+     * @param engine the engine for the stream's algorithm, as returned by
+     * MultiBufferDigest::Get().
+     * @param native_state the OpenSSL state to update: an \c MD5_CTX,
+     * \c SHA_CTX or \c SHA256_CTX, depending on the algorithm. It must
+     * outlive the stream's use, though not its destruction.
+     */
+    MultiBufferDigestStream(MultiBufferDigest* engine, void* native_state);
+
+    /**
+     * Destructor. Discards any input not hashed yet.
+     */
+    ~MultiBufferDigestStream();
+
+    /**
+     * Adds input to the stream.
+     */
+    void Feed(const void* data, size_t size);
+
+    /**
+     * Hashes all buffered input into the native state, so that it can
+     * be finalized, copied or serialized.
+     */
+    void Flush();
+
+private:
+    friend class MultiBufferDigest;
+
+    MultiBufferDigest* engine;
+    void* state;
+    std::string pending;
+    bool queued = false;
+};
+
+/**
+ * The engine hashing all streams of one algorithm.
+ */
+class MultiBufferDigest {
+public:
+    /**
+     * Number of streams hashed in parallel.
+     */
+    static constexpr int LANES = 8;
+
+    /**
+     * Number of bytes buffered across all streams that triggers a Run().
+     */
+    static constexpr size_t MAX_QUEUED_BYTES = 256 * 1024;
+
+    /**
+     * Returns the engine for the given algorithm.
+     * @param alg the algorithm.
+     * @param even_if_slower if false, returns null when OpenSSL hashes
+     * single streams faster than the engine, as it does for SHA1 and SHA256
+     * on CPUs with SHA instructions. Mostly for testing.
+     * @return the engine, or null if there's no (worthwhile) multi-buffer
+     * implementation for the algorithm.
+     */
+    static MultiBufferDigest* Get(HashAlgorithm alg, bool even_if_slower = false);
+
+    /**
+     * Hashes the input buffered by all streams.
+     */
+    void Run();
+
+private:
+    friend class MultiBufferDigestStream;
+
+    struct Algorithm;
+
+    // Whole blocks of one stream's input still to hash.
+    struct Job {
+        void* state;
+        const u_char* data;
+        size_t blocks;
+    };
+
+    MultiBufferDigest(const Algorithm* alg) : alg(alg) {}
+
+    void Enqueue(MultiBufferDigestStream* s, size_t bytes);
+    void Dequeue(MultiBufferDigestStream* s);
+
+    // Runs the given jobs in parallel across the lanes.
+    void RunLanes(const std::vector<Job>& jobs);
+
+    const Algorithm* alg;
+    std::vector<MultiBufferDigestStream*> queued;
+    size_t queued_bytes = 0;
+};
+
+} // namespace zeek::detail
@@ -110,6 +110,7 @@ namespace zeek::detail {
 int watchdog_interval;
 
 int max_timer_expires;
+double timer_wheel_resolution;
 
 int ignore_checksums;
 int partial_connection_ok;
@@ -131,6 +132,11 @@ int tcp_max_above_hole_without_any_acks;
 int tcp_excessive_data_without_further_acks;
 int tcp_max_old_segments;
 
+zeek_uint_t reassem_buffer_pool_size;
+bool reassem_coalesce_blocks;
+zeek_uint_t reassem_memory_budget;
+int reassem_eviction_policy;
+
 double non_analyzed_lifetime;
 double tcp_inactivity_timeout;
 double udp_inactivity_timeout;
@@ -160,6 +166,7 @@ int dns_max_queries;
 double table_expire_interval;
 double table_expire_delay;
 int table_incremental_step;
+int table_expire_indexed;
 
 double connection_status_update_interval;
 
@@ -174,6 +181,7 @@ double pkt_profile_freq;
 int packet_filter_default;
 
 int sig_max_group_size;
+int sig_dfa_table_max_states;
 
 int dpd_reassemble_first_packets;
 int dpd_buffer_size;
@@ -225,8 +233,10 @@ void init_general_global_var() {
     table_expire_interval = id::find_val("table_expire_interval")->AsInterval();
     table_expire_delay = id::find_val("table_expire_delay")->AsInterval();
     table_incremental_step = id::find_val("table_incremental_step")->AsCount();
+    table_expire_indexed = id::find_val("table_expire_indexed")->AsBool();
     packet_filter_default = id::find_val("packet_filter_default")->AsBool();
     sig_max_group_size = id::find_val("sig_max_group_size")->AsCount();
+    sig_dfa_table_max_states = id::find_val("sig_dfa_table_max_states")->AsCount();
     record_all_packets = id::find_val("record_all_packets")->AsBool();
     bits_per_uid = id::find_val("bits_per_uid")->AsCount();
 }
@@ -259,6 +269,11 @@ void init_net_var() {
     tcp_excessive_data_without_further_acks = id::find_val("tcp_excessive_data_without_further_acks")->AsCount();
     tcp_max_old_segments = id::find_val("tcp_max_old_segments")->AsCount();
 
+    reassem_buffer_pool_size = id::find_val("reassem_buffer_pool_size")->AsCount();
+    reassem_coalesce_blocks = id::find_val("reassem_coalesce_blocks")->AsBool();
+    reassem_memory_budget = id::find_val("reassem_memory_budget")->AsCount();
+    reassem_eviction_policy = id::find_val("reassem_eviction_policy")->InternalInt();
+
     non_analyzed_lifetime = id::find_val("non_analyzed_lifetime")->AsInterval();
     tcp_inactivity_timeout = id::find_val("tcp_inactivity_timeout")->AsInterval();
     udp_inactivity_timeout = id::find_val("udp_inactivity_timeout")->AsInterval();
@@ -280,6 +295,7 @@ void init_net_var() {
     watchdog_interval = int(id::find_val("watchdog_interval")->AsInterval());
 
     max_timer_expires = id::find_val("max_timer_expires")->AsCount();
+    timer_wheel_resolution = id::find_val("timer_wheel_resolution")->AsInterval();
 
     mime_segment_length = id::find_val("mime_segment_length")->AsCount();
     mime_segment_overlap_length = id::find_val("mime_segment_overlap_length")->AsCount();
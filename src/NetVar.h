@@ -11,6 +11,7 @@ namespace zeek::detail {
 extern int watchdog_interval;
 
 extern int max_timer_expires;
+extern double timer_wheel_resolution;
 
 extern int ignore_checksums;
 extern int partial_connection_ok;
@@ -32,6 +33,11 @@ extern int tcp_max_above_hole_without_any_acks;
 extern int tcp_excessive_data_without_further_acks;
 extern int tcp_max_old_segments;
 
+extern zeek_uint_t reassem_buffer_pool_size;
+extern bool reassem_coalesce_blocks;
+extern zeek_uint_t reassem_memory_budget;
+extern int reassem_eviction_policy;
+
 extern double non_analyzed_lifetime;
 extern double tcp_inactivity_timeout;
 extern double udp_inactivity_timeout;
@@ -62,6 +68,7 @@ extern int dns_max_queries;
 extern double table_expire_interval;
 extern double table_expire_delay;
 extern int table_incremental_step;
+extern int table_expire_indexed;
 
 extern int orig_addr_anonymization, resp_addr_anonymization;
 extern int other_addr_anonymization;
@@ -77,6 +84,7 @@ extern double pkt_profile_freq;
 extern int packet_filter_default;
 
 extern int sig_max_group_size;
+extern int sig_dfa_table_max_states;
 
 extern int dpd_reassemble_first_packets;
 extern int dpd_buffer_size;
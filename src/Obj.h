@@ -6,6 +6,10 @@
 
 #include <climits>
 
+#ifdef USE_OBJ_POOL
+#include "zeek/ObjPool.h"
+#endif
+
 namespace zeek {
 
 class ODesc;
@@ -81,6 +85,19 @@ public:
 
     virtual ~Obj();
 
+#ifdef USE_OBJ_POOL
+    // Objects of all derived classes come from the pool, so they must only
+    // be created and destroyed on the main thread. The virtual destructor
+    // makes sure the sized delete gets the dynamic type's size.
+    static void* operator new(size_t size) { return detail::ObjPool::Allocate(size); }
+    static void operator delete(void* p, size_t size) { detail::ObjPool::Release(p, size); }
+
+    // The pool only guarantees fundamental alignment, so over-aligned
+    // derived classes bypass it.
+    static void* operator new(size_t size, std::align_val_t al) { return ::operator new(size, al); }
+    static void operator delete(void* p, size_t size, std::align_val_t al) { ::operator delete(p, size, al); }
+#endif
+
     /* disallow copying */
     Obj(const Obj&) = delete;
     Obj& operator=(const Obj&) = delete;
@@ -0,0 +1,148 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/ObjPool.h"
+
+#include "zeek/zeek-config.h"
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef HAVE_LINUX
+#include <sys/mman.h>
+#endif
+
+#include "zeek/3rdparty/doctest.h"
+#include "zeek/telemetry/Manager.h"
+
+namespace zeek::detail {
+
+// Allocates a chunk aligned to its size, so that the OS can back it with
+// huge pages.
+static char* allocate_chunk() {
+    void* p = nullptr;
+
+#ifdef _MSC_VER
+    p = _aligned_malloc(ObjPool::CHUNK_SIZE, ObjPool::CHUNK_SIZE);
+#else
+    if ( posix_memalign(&p, ObjPool::CHUNK_SIZE, ObjPool::CHUNK_SIZE) != 0 )
+        p = nullptr;
+#endif
+
+    if ( ! p )
+        throw std::bad_alloc();
+
+#if defined(HAVE_LINUX) && defined(MADV_HUGEPAGE)
+    // Only a hint: whether it's followed depends on the system's
+    // transparent huge page settings.
+    madvise(p, ObjPool::CHUNK_SIZE, MADV_HUGEPAGE);
+#endif
+
+    return static_cast<char*>(p);
+}
+
+void* ObjPool::Carve(size_t size_class) {
+    size_t size = (size_class + 1) * GRANULARITY;
+
+    if ( chunk_end - chunk_pos < static_cast<ptrdiff_t>(size) ) {
+        // Whatever is left of the previous chunk goes unused.
+        chunk_pos = allocate_chunk();
+        chunk_end = chunk_pos + CHUNK_SIZE;
+        ++num_chunks;
+    }
+
+    void* p = chunk_pos;
+    chunk_pos += size;
+    return p;
+}
+
+void ObjPool::InitPostScript() {
+    static std::vector<telemetry::GaugePtr> in_use_metrics;
+    static std::vector<telemetry::GaugePtr> free_metrics;
+
+    auto in_use_family = telemetry_mgr->GaugeFamily("zeek", "obj_pool_objects_in_use", {"size"},
+                                                    "Number of pooled script objects in use, by size class");
+    auto free_family = telemetry_mgr->GaugeFamily("zeek", "obj_pool_objects_free", {"size"},
+                                                  "Number of released script objects kept for reuse, by size class");
+
+    for ( size_t i = 0; i < NUM_CLASSES; i++ ) {
+        auto size = std::to_string((i + 1) * GRANULARITY);
+        telemetry::LabelView label = {"size", size};
+
+        in_use_metrics.push_back(in_use_family->GetOrAdd({label}, [i]() -> prometheus::ClientMetric {
+            prometheus::ClientMetric metric;
+            metric.gauge.value = static_cast<double>(ObjPool::InUse(i));
+            return metric;
+        }));
+
+        free_metrics.push_back(free_family->GetOrAdd({label}, [i]() -> prometheus::ClientMetric {
+            prometheus::ClientMetric metric;
+            metric.gauge.value = static_cast<double>(ObjPool::Free(i));
+            return metric;
+        }));
+    }
+
+    static auto reserved_metric =
+        telemetry_mgr->GaugeInstance("zeek", "obj_pool_reserved", {}, "Memory reserved for pooled script objects",
+                                     "bytes", []() -> prometheus::ClientMetric {
+                                         prometheus::ClientMetric metric;
+                                         metric.gauge.value = static_cast<double>(ObjPool::ReservedBytes());
+                                         return metric;
+                                     });
+}
+
+TEST_SUITE_BEGIN("ObjPool");
+
+TEST_CASE("obj pool reuse") {
+    auto in_use = ObjPool::InUse(1);
+
+    void* a = ObjPool::Allocate(24);
+    void* b = ObjPool::Allocate(32);
+    CHECK(a != b);
+    CHECK(reinterpret_cast<uintptr_t>(a) % ObjPool::GRANULARITY == 0);
+    CHECK(reinterpret_cast<uintptr_t>(b) % ObjPool::GRANULARITY == 0);
+    CHECK(ObjPool::InUse(1) == in_use + 2);
+
+    auto num_free = ObjPool::Free(1);
+    ObjPool::Release(a, 24);
+    CHECK(ObjPool::Free(1) == num_free + 1);
+
+    // The most recently released object of a size class comes back first.
+    void* c = ObjPool::Allocate(20);
+    CHECK(c == a);
+
+    ObjPool::Release(b, 32);
+    ObjPool::Release(c, 20);
+    CHECK(ObjPool::InUse(1) == in_use);
+}
+
+TEST_CASE("obj pool large objects") {
+    auto reserved = ObjPool::ReservedBytes();
+
+    void* p = ObjPool::Allocate(ObjPool::MAX_SIZE + 1);
+    CHECK(p != nullptr);
+    CHECK(ObjPool::ReservedBytes() == reserved);
+    ObjPool::Release(p, ObjPool::MAX_SIZE + 1);
+}
+
+TEST_CASE("obj pool chunks") {
+    // Fill more than one chunk with objects of the largest size class.
+    std::vector<void*> objs;
+    auto reserved = ObjPool::ReservedBytes();
+    auto in_use = ObjPool::InUse(ObjPool::NUM_CLASSES - 1);
+    size_t n = ObjPool::CHUNK_SIZE / ObjPool::MAX_SIZE + 1;
+
+    for ( size_t i = 0; i < n; ++i )
+        objs.push_back(ObjPool::Allocate(ObjPool::MAX_SIZE));
+
+    CHECK(ObjPool::ReservedBytes() > reserved);
+
+    for ( auto* p : objs )
+        ObjPool::Release(p, ObjPool::MAX_SIZE);
+
+    CHECK(ObjPool::InUse(ObjPool::NUM_CLASSES - 1) == in_use);
+}
+
+TEST_SUITE_END();
+
+} // namespace zeek::detail
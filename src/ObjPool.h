@@ -0,0 +1,125 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace zeek::detail {
+
+/**
+ * A size-class allocator for Obj instances.
+ *
+ * Scripts create and destroy values at a high rate, most of them small and
+ * short-lived: the records and strings built for an event are usually gone
+ * right after its handlers ran. Obj routes its allocations through this
+ * pool, which keeps a free list of released objects per size class for
+ * reuse. New objects get carved from large chunks that are aligned for
+ * and, on Linux, advised to use transparent huge pages, which reduces TLB
+ * pressure.
+ *
+ * The pool must only be used from the main thread: like Obj's reference
+ * counting, it does no locking at all, and Obj instances must not be
+ * created or destroyed elsewhere. It never returns memory to the OS; freed
+ * objects stay on their size class's free list for reuse.
+ *
+ * Pooled objects are aligned to GRANULARITY, which covers every type
+ * without an extended alignment. Obj sends over-aligned types to the
+ * global allocator instead.
+ */
+class ObjPool {
+public:
+    // Allocation granularity, and the alignment of all pooled objects.
+    static constexpr size_t GRANULARITY = 16;
+
+    static_assert(alignof(std::max_align_t) <= GRANULARITY, "pooled objects would be misaligned");
+
+    // Objects larger than this come from the global allocator.
+    static constexpr size_t MAX_SIZE = 512;
+
+    static constexpr size_t NUM_CLASSES = MAX_SIZE / GRANULARITY;
+
+    // Size of the chunks that objects are carved from, matching the
+    // common huge page size.
+    static constexpr size_t CHUNK_SIZE = 2 * 1024 * 1024;
+
+    static void* Allocate(size_t size) {
+        if ( size > MAX_SIZE )
+            return ::operator new(size);
+
+        auto& c = classes[SizeClass(size)];
+        ++c.in_use;
+
+        if ( auto* f = c.free_list ) {
+            c.free_list = f->next;
+            --c.num_free;
+            return f;
+        }
+
+        return Carve(SizeClass(size));
+    }
+
+    /**
+     * Returns an object to the pool. The size must match the one that was
+     * passed to Allocate().
+     */
+    static void Release(void* p, size_t size) {
+        if ( size > MAX_SIZE ) {
+            ::operator delete(p);
+            return;
+        }
+
+        auto& c = classes[SizeClass(size)];
+        --c.in_use;
+        ++c.num_free;
+
+        auto* f = static_cast<FreeObj*>(p);
+        f->next = c.free_list;
+        c.free_list = f;
+    }
+
+    /**
+     * Returns the number of objects of a size class that are in use.
+     */
+    static uint64_t InUse(size_t size_class) { return classes[size_class].in_use; }
+
+    /**
+     * Returns the number of objects of a size class that wait for reuse.
+     */
+    static uint64_t Free(size_t size_class) { return classes[size_class].num_free; }
+
+    /**
+     * Returns the number of bytes that the pool has reserved for chunks.
+     */
+    static uint64_t ReservedBytes() { return num_chunks * CHUNK_SIZE; }
+
+    /**
+     * Registers the pool's metrics with the telemetry manager.
+     */
+    static void InitPostScript();
+
+private:
+    struct FreeObj {
+        FreeObj* next;
+    };
+
+    // Static storage, so zero-initialized.
+    struct Class {
+        FreeObj* free_list;
+        uint64_t in_use;
+        uint64_t num_free;
+    };
+
+    static size_t SizeClass(size_t size) { return size ? (size - 1) / GRANULARITY : 0; }
+
+    // Takes a new object of the given size class from the current chunk.
+    static void* Carve(size_t size_class);
+
+    static inline Class classes[NUM_CLASSES];
+    static inline char* chunk_pos = nullptr;
+    static inline char* chunk_end = nullptr;
+    static inline uint64_t num_chunks = 0;
+};
+
+} // namespace zeek::detail
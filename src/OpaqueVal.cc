@@ -19,6 +19,7 @@
 
 #include "zeek/CompHash.h"
 #include "zeek/Desc.h"
+#include "zeek/MultiBufferDigest.h"
 #include "zeek/NetVar.h"
 #include "zeek/Reporter.h"
 #include "zeek/Scope.h"
@@ -174,6 +175,8 @@ void OpaqueVal::ValDescribe(ODesc* d) const { d->Add(util::fmt("<opaque of %s>",
 
 void OpaqueVal::ValDescribeReST(ODesc* d) const { d->Add(util::fmt("<opaque of %s>", OpaqueName())); }
 
+HashVal::~HashVal() = default;
+
 bool HashVal::IsValid() const { return valid; }
 
 bool HashVal::Init() {
@@ -188,19 +191,39 @@ StringValPtr HashVal::Get() {
     if ( ! valid )
         return val_mgr->EmptyString();
 
+    FlushMultiBuffer();
     auto result = DoGet();
     valid = false;
+    mb_stream.reset();
     return result;
 }
 
 bool HashVal::Feed(const void* data, size_t size) {
-    if ( valid )
+    if ( valid ) {
+        if ( mb_stream ) {
+            mb_stream->Feed(data, size);
+            return true;
+        }
+
         return DoFeed(data, size);
+    }
 
     Error("attempt to update an invalid opaque hash value");
     return false;
 }
 
+void HashVal::UseMultiBuffer() {
+    static bool enabled = id::find_val("multi_buffer_hashing")->AsBool();
+
+    if ( enabled && valid && ! mb_stream )
+        mb_stream = NewMultiBufferStream();
+}
+
+void HashVal::FlushMultiBuffer() const {
+    if ( mb_stream )
+        mb_stream->Flush();
+}
+
 bool HashVal::DoInit() {
     assert(! "missing implementation of DoInit()");
     return false;
@@ -216,6 +239,8 @@ StringValPtr HashVal::DoGet() {
     return val_mgr->EmptyString();
 }
 
+std::unique_ptr<detail::MultiBufferDigestStream> HashVal::NewMultiBufferStream() { return nullptr; }
+
 HashVal::HashVal(OpaqueTypePtr t) : OpaqueVal(std::move(t)) { valid = false; }
 
 namespace {
@@ -256,6 +281,8 @@ void do_unserialize(MD5Val::StatePtr ptr, const char* bytes, size_t len) {
 
 void do_destroy(MD5Val::StatePtr ptr) { hash_state_free(to_digest_ptr(ptr)); }
 
+void* native_state(MD5Val::StatePtr ptr) { return EVP_MD_CTX_md_data(to_native_ptr(ptr)); }
+
 // -- SHA1
 
 auto* to_native_ptr(SHA1Val::StatePtr ptr) { return reinterpret_cast<EVP_MD_CTX*>(ptr); }
@@ -286,6 +313,8 @@ void do_unserialize(SHA1Val::StatePtr ptr, const char* bytes, size_t len) {
 
 void do_destroy(SHA1Val::StatePtr ptr) { hash_state_free(to_digest_ptr(ptr)); }
 
+void* native_state(SHA1Val::StatePtr ptr) { return EVP_MD_CTX_md_data(to_native_ptr(ptr)); }
+
 // -- SHA256
 
 auto* to_native_ptr(SHA256Val::StatePtr ptr) { return reinterpret_cast<EVP_MD_CTX*>(ptr); }
@@ -318,6 +347,8 @@ void do_unserialize(SHA256Val::StatePtr ptr, const char* bytes, size_t len) {
 
 void do_destroy(SHA256Val::StatePtr ptr) { hash_state_free(to_digest_ptr(ptr)); }
 
+void* native_state(SHA256Val::StatePtr ptr) { return EVP_MD_CTX_md_data(to_native_ptr(ptr)); }
+
 #else
 
 // -- MD5
@@ -342,6 +373,8 @@ void do_unserialize(MD5Val::StatePtr ptr, const char* bytes, size_t len) { memcp
 
 void do_destroy(MD5Val::StatePtr ptr) { delete to_native_ptr(ptr); }
 
+void* native_state(MD5Val::StatePtr ptr) { return to_native_ptr(ptr); }
+
 // -- SHA1
 
 auto* to_native_ptr(SHA1Val::StatePtr ptr) { return reinterpret_cast<SHA_CTX*>(ptr); }
@@ -364,6 +397,8 @@ void do_unserialize(SHA1Val::StatePtr ptr, const char* bytes, size_t len) { memc
 
 void do_destroy(SHA1Val::StatePtr ptr) { delete to_native_ptr(ptr); }
 
+void* native_state(SHA1Val::StatePtr ptr) { return to_native_ptr(ptr); }
+
 // -- SHA256
 
 auto* to_native_ptr(SHA256Val::StatePtr ptr) { return reinterpret_cast<SHA256_CTX*>(ptr); }
@@ -386,8 +421,17 @@ void do_unserialize(SHA256Val::StatePtr ptr, const char* bytes, size_t len) { me
 
 void do_destroy(SHA256Val::StatePtr ptr) { delete to_native_ptr(ptr); }
 
+void* native_state(SHA256Val::StatePtr ptr) { return to_native_ptr(ptr); }
+
 #endif
 
+std::unique_ptr<detail::MultiBufferDigestStream> new_multi_buffer_stream(detail::HashAlgorithm alg, void* state) {
+    if ( auto engine = detail::MultiBufferDigest::Get(alg) )
+        return std::make_unique<detail::MultiBufferDigestStream>(engine, state);
+
+    return nullptr;
+}
+
 } // namespace
 
 MD5Val::MD5Val() : HashVal(md5_type) {}
@@ -412,6 +456,8 @@ ValPtr MD5Val::DoClone(CloneState* state) {
     auto out = make_intrusive<MD5Val>();
 
     if ( IsValid() ) {
+        FlushMultiBuffer();
+
         if ( ! out->Init() )
             return nullptr;
         do_clone(out->ctx, ctx);
@@ -442,6 +488,10 @@ StringValPtr MD5Val::DoGet() {
     return make_intrusive<StringVal>(detail::md5_digest_print(digest));
 }
 
+std::unique_ptr<detail::MultiBufferDigestStream> MD5Val::NewMultiBufferStream() {
+    return new_multi_buffer_stream(detail::Hash_MD5, native_state(ctx));
+}
+
 IMPLEMENT_OPAQUE_VALUE(MD5Val)
 
 std::optional<BrokerData> MD5Val::DoSerializeData() const {
@@ -452,6 +502,8 @@ std::optional<BrokerData> MD5Val::DoSerializeData() const {
         return std::move(builder).Build();
     }
 
+    FlushMultiBuffer();
+
     builder.Reserve(2);
     builder.Add(true);
     builder.Add(do_serialize(ctx));
@@ -492,6 +544,8 @@ ValPtr SHA1Val::DoClone(CloneState* state) {
     auto out = make_intrusive<SHA1Val>();
 
     if ( IsValid() ) {
+        FlushMultiBuffer();
+
         if ( ! out->Init() )
             return nullptr;
 
@@ -524,6 +578,10 @@ StringValPtr SHA1Val::DoGet() {
     return make_intrusive<StringVal>(detail::sha1_digest_print(digest));
 }
 
+std::unique_ptr<detail::MultiBufferDigestStream> SHA1Val::NewMultiBufferStream() {
+    return new_multi_buffer_stream(detail::Hash_SHA1, native_state(ctx));
+}
+
 IMPLEMENT_OPAQUE_VALUE(SHA1Val)
 
 std::optional<BrokerData> SHA1Val::DoSerializeData() const {
@@ -534,6 +592,8 @@ std::optional<BrokerData> SHA1Val::DoSerializeData() const {
         return std::move(builder).Build();
     }
 
+    FlushMultiBuffer();
+
     builder.Reserve(2);
     builder.Add(true);
     builder.Add(do_serialize(ctx));
@@ -578,6 +638,8 @@ ValPtr SHA256Val::DoClone(CloneState* state) {
     auto out = make_intrusive<SHA256Val>();
 
     if ( IsValid() ) {
+        FlushMultiBuffer();
+
         if ( ! out->Init() )
             return nullptr;
 
@@ -610,6 +672,10 @@ StringValPtr SHA256Val::DoGet() {
     return make_intrusive<StringVal>(detail::sha256_digest_print(digest));
 }
 
+std::unique_ptr<detail::MultiBufferDigestStream> SHA256Val::NewMultiBufferStream() {
+    return new_multi_buffer_stream(detail::Hash_SHA256, native_state(ctx));
+}
+
 IMPLEMENT_OPAQUE_VALUE(SHA256Val)
 
 std::optional<BrokerData> SHA256Val::DoSerializeData() const {
@@ -620,6 +686,8 @@ std::optional<BrokerData> SHA256Val::DoSerializeData() const {
         return std::move(builder).Build();
     }
 
+    FlushMultiBuffer();
+
     builder.Add(true);
     builder.Add(do_serialize(ctx));
     return std::move(builder).Build();
@@ -9,6 +9,7 @@
 #include <broker/expected.hh>
 #include <paraglob/paraglob.h>
 #include <sys/types.h> // for u_char
+#include <memory>
 #include <optional>
 
 #include "zeek/IntrusivePtr.h"
@@ -35,6 +36,9 @@ class BloomFilter;
 namespace probabilistic::detail {
 class CardinalityCounter;
 }
+namespace detail {
+class MultiBufferDigestStream;
+}
 
 class OpaqueVal;
 using OpaqueValPtr = IntrusivePtr<OpaqueVal>;
@@ -197,11 +201,23 @@ public:
         detail::hash_final(h, result);
     }
 
+    ~HashVal() override;
+
     bool IsValid() const;
     bool Init();
     bool Feed(const void* data, size_t size);
     StringValPtr Get();
 
+    /**
+     * Hashes further input together with that of other hashes of the same
+     * algorithm, using the multi-buffer engine, if ``multi_buffer_hashing``
+     * is set and the engine beats OpenSSL for the algorithm on this CPU.
+     * Input is then buffered until enough has accumulated across all hashes,
+     * or until the hash gets retrieved, copied or serialized. Only for
+     * initialized hashes that get fed on the main thread.
+     */
+    void UseMultiBuffer();
+
 protected:
     static void digest_one(detail::HashDigestState* h, const Val* v);
     static void digest_one(detail::HashDigestState* h, const ValPtr& v);
@@ -212,9 +228,23 @@ protected:
     virtual bool DoFeed(const void* data, size_t size);
     virtual StringValPtr DoGet();
 
+    /**
+     * Returns a new multi-buffer stream updating the hash's state, or null
+     * if the algorithm doesn't support multi-buffer hashing.
+     */
+    virtual std::unique_ptr<detail::MultiBufferDigestStream> NewMultiBufferStream();
+
+    /**
+     * Hashes any input still buffered for the multi-buffer engine, so the
+     * hash's state is current.
+     */
+    void FlushMultiBuffer() const;
+
 private:
     // This flag exists because Get() can only be called once.
     bool valid;
+
+    std::unique_ptr<detail::MultiBufferDigestStream> mb_stream;
 };
 
 class MD5Val : public HashVal {
@@ -249,6 +279,7 @@ protected:
     bool DoInit() override;
     bool DoFeed(const void* data, size_t size) override;
     StringValPtr DoGet() override;
+    std::unique_ptr<detail::MultiBufferDigestStream> NewMultiBufferStream() override;
 
     DECLARE_OPAQUE_VALUE_DATA(MD5Val)
 private:
@@ -277,6 +308,7 @@ protected:
     bool DoInit() override;
     bool DoFeed(const void* data, size_t size) override;
     StringValPtr DoGet() override;
+    std::unique_ptr<detail::MultiBufferDigestStream> NewMultiBufferStream() override;
 
     DECLARE_OPAQUE_VALUE_DATA(SHA1Val)
 private:
@@ -305,6 +337,7 @@ protected:
     bool DoInit() override;
     bool DoFeed(const void* data, size_t size) override;
     StringValPtr DoGet() override;
+    std::unique_ptr<detail::MultiBufferDigestStream> NewMultiBufferStream() override;
 
     DECLARE_OPAQUE_VALUE_DATA(SHA256Val)
 private:
@@ -198,6 +198,7 @@ static void print_analysis_help() {
     fprintf(stderr, "    xform	transform scripts to \"reduced\" form\n");
 
     fprintf(stderr, "\n--optimize options when generating C++:\n");
+    fprintf(stderr, "    add-C++	generate C++ as a plugin for script bodies lacking compiled versions\n");
     fprintf(stderr, "    allow-cond	allow standalone compilation of functions influenced by conditionals\n");
     fprintf(stderr, "    gen-C++	generate C++ script bodies\n");
     fprintf(stderr, "    gen-standalone-C++	generate \"standalone\" C++ script bodies\n");
@@ -221,7 +222,9 @@ static void set_analysis_option(const char* opt, Options& opts) {
         exit(0);
     }
 
-    if ( util::streq(opt, "allow-cond") )
+    if ( util::streq(opt, "add-C++") )
+        a_o.add_CPP = true;
+    else if ( util::streq(opt, "allow-cond") )
         a_o.allow_cond = true;
     else if ( util::streq(opt, "dump-uds") )
         a_o.activate = a_o.dump_uds = true;
@@ -23,10 +23,16 @@ public:
 
     void MinimizeTime() { time = -HUGE_VAL; }
 
+    // Used by TimerWheel to record which of its slots currently
+    // holds the element.  Offset() is then the index within that slot.
+    uint16_t Bucket() const { return bucket; }
+    void SetBucket(uint16_t b) { bucket = b; }
+
 protected:
     PQ_Element() = default;
     double time = 0.0;
     int offset = -1;
+    uint16_t bucket = 0;
 };
 
 class PriorityQueue {
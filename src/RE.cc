@@ -4,6 +4,8 @@
 
 #include "zeek/zeek-config.h"
 
+#include <unistd.h>
+#include <algorithm>
 #include <cstdlib>
 #include <utility>
 
@@ -34,6 +36,7 @@ Specific_RE_Matcher::Specific_RE_Matcher(match_type arg_mt, bool arg_multiline)
     any_ccl = nullptr;
     single_line_ccl = nullptr;
     dfa = nullptr;
+    table = nullptr;
     ecs = nullptr;
     accepted = new AcceptingSet();
 }
@@ -42,6 +45,7 @@ Specific_RE_Matcher::~Specific_RE_Matcher() {
     for ( int i = 0; i < ccl_list.length(); ++i )
         delete ccl_list[i];
 
+    delete table;
     Unref(dfa);
     delete accepted;
 }
@@ -131,6 +135,9 @@ bool Specific_RE_Matcher::Compile(bool lazy) {
 
     ecs = EC()->EquivClasses();
 
+    // The parser accepts single patterns with an index of 1.
+    accept_ids = {1};
+
     return true;
 }
 
@@ -160,6 +167,7 @@ bool Specific_RE_Matcher::CompileSet(const string_list& set, const int_list& idx
         }
 
         nfa->FinalState()->SetAccept(idx[i]);
+        accept_ids.insert(idx[i]);
         set_nfa = set_nfa ? make_alternate(nfa, set_nfa) : nfa;
     }
 
@@ -267,6 +275,22 @@ int Specific_RE_Matcher::Match(const u_char* bv, int n) {
     return 0;
 }
 
+bool Specific_RE_Matcher::Freeze(int max_states) {
+    if ( ! dfa || table )
+        return table != nullptr;
+
+    table = DFA_Table::Build(dfa, max_states);
+    return table != nullptr;
+}
+
+bool Specific_RE_Matcher::FreezeFromFile(const char* path) {
+    if ( ! dfa || table )
+        return table != nullptr;
+
+    table = DFA_Table::Load(path, &equiv_class, accept_ids);
+    return table != nullptr;
+}
+
 void Specific_RE_Matcher::Dump(FILE* f) { dfa->Dump(f); }
 
 inline void RE_Match_State::AddMatches(const AcceptingSet& as, MatchPos position) {
@@ -277,6 +301,9 @@ inline void RE_Match_State::AddMatches(const AcceptingSet& as, MatchPos position
 }
 
 bool RE_Match_State::Match(const u_char* bv, int n, bool bol, bool eol, bool clear) {
+    if ( table )
+        return MatchTable(bv, n, bol, eol, clear);
+
     if ( current_pos == -1 ) {
         // First call to Match().
         if ( ! dfa )
@@ -336,6 +363,67 @@ bool RE_Match_State::Match(const u_char* bv, int n, bool bol, bool eol, bool cle
     return accepted_matches.size() != old_matches;
 }
 
+bool RE_Match_State::TableStep(int ec) {
+    DFA_Table::State next = table->Next(table_state, ec);
+
+    if ( next == DFA_Table::JAM ) {
+        table_state = DFA_Table::JAM;
+        return false;
+    }
+
+    if ( const AcceptingSet* ac = table->Accept(next) )
+        AddMatches(*ac, current_pos);
+
+    ++current_pos;
+    table_state = next;
+    return true;
+}
+
+bool RE_Match_State::MatchTable(const u_char* bv, int n, bool bol, bool eol, bool clear) {
+    // This mirrors the DFA-based matching above, see there.
+    if ( current_pos == -1 ) {
+        current_pos = 0;
+        table_state = table->Start();
+
+        if ( const AcceptingSet* ac = table->Accept(table_state) )
+            AddMatches(*ac, 0);
+    }
+
+    else if ( clear ) {
+        current_pos = 0;
+        table_state = table->Start();
+    }
+
+    if ( table_state == DFA_Table::JAM )
+        return false;
+
+    size_t old_matches = accepted_matches.size();
+
+    if ( bol && ! TableStep(ecs[SYM_BOL]) )
+        return accepted_matches.size() != old_matches;
+
+    while ( n > 0 ) {
+        int consumed = table->Run(&table_state, bv, n);
+        current_pos += consumed;
+
+        if ( table_state == DFA_Table::JAM )
+            return accepted_matches.size() != old_matches;
+
+        // Unless it runs out of input, Run() stops right after entering an
+        // accepting state.
+        if ( const AcceptingSet* ac = table->Accept(table_state) )
+            AddMatches(*ac, current_pos - 1);
+
+        bv += consumed;
+        n -= consumed;
+    }
+
+    if ( eol )
+        TableStep(ecs[SYM_EOL]);
+
+    return accepted_matches.size() != old_matches;
+}
+
 int Specific_RE_Matcher::LongestMatch(const u_char* bv, int n, bool bol, bool eol) {
     if ( ! dfa )
         // An empty pattern matches anything.
@@ -565,6 +653,116 @@ TEST_SUITE("re_matcher") {
         RE_Matcher match9("a\\\"b");
         CHECK(match9.Compile());
     }
+
+    TEST_CASE("frozen DFA matches like the lazy one") {
+        // Signature-style groups: anchored patterns and ones that search
+        // for a literal anywhere, feeding the input in chunks.
+        detail::string_list exprs;
+        exprs.push_back(const_cast<char*>("GET /"));
+        exprs.push_back(const_cast<char*>(".*password"));
+        exprs.push_back(const_cast<char*>(".*pass[a-z]+d"));
+        exprs.push_back(const_cast<char*>(".*\\x00\\x01"));
+        exprs.push_back(const_cast<char*>("^HTTP/1\\.[01]"));
+        detail::int_list ids = {1, 2, 3, 4, 5};
+
+        detail::Specific_RE_Matcher lazy(detail::MATCH_EXACTLY, true);
+        detail::Specific_RE_Matcher frozen(detail::MATCH_EXACTLY, true);
+        REQUIRE(lazy.CompileSet(exprs, ids));
+        REQUIRE(frozen.CompileSet(exprs, ids));
+        REQUIRE(frozen.Freeze(10000));
+        CHECK(frozen.Table() != nullptr);
+
+        detail::Specific_RE_Matcher small(detail::MATCH_EXACTLY, true);
+        REQUIRE(small.CompileSet(exprs, ids));
+        CHECK_FALSE(small.Freeze(2));
+
+        std::string inputs[] = {
+            "GET /index.html HTTP/1.1",
+            "HTTP/1.0 200 OK\r\nno secrets here",
+            std::string(100, 'x') + "user=foo&password=bar" + std::string(100, 'y'),
+            std::string(50, 'a') + "passxyzd" + std::string("\x00\x01", 2) + "trailer",
+            "pass",
+            "",
+        };
+
+        for ( const auto& input : inputs ) {
+            for ( int chunk : {1, 3, 16, 1000} ) {
+                detail::RE_Match_State ls(&lazy);
+                detail::RE_Match_State fs(&frozen);
+                auto data = reinterpret_cast<const u_char*>(input.data());
+                int len = static_cast<int>(input.size());
+
+                for ( int i = 0; i == 0 || i < len; i += chunk ) {
+                    int n = std::min(chunk, len - i);
+                    bool bol = i == 0;
+                    bool eol = i + n >= len;
+                    CHECK(ls.Match(data + i, n, bol, eol, false) == fs.Match(data + i, n, bol, eol, false));
+                }
+
+                CHECK(ls.AcceptedMatches() == fs.AcceptedMatches());
+                CHECK(ls.Length() == fs.Length());
+            }
+        }
+    }
+
+    TEST_CASE("frozen DFA round trip through a file") {
+#ifndef _MSC_VER
+        char path[] = "/tmp/zeek-unit-test-XXXXXX";
+        int fd = mkstemp(path);
+        REQUIRE(fd >= 0);
+        close(fd);
+
+        detail::string_list exprs;
+        exprs.push_back(const_cast<char*>(".*password"));
+        exprs.push_back(const_cast<char*>("^HTTP/1\\.[01]"));
+        detail::int_list ids = {1, 2};
+
+        detail::Specific_RE_Matcher built(detail::MATCH_EXACTLY, true);
+        REQUIRE(built.CompileSet(exprs, ids));
+        REQUIRE(built.Freeze(10000));
+        REQUIRE(built.Table()->Save(path));
+
+        detail::Specific_RE_Matcher loaded(detail::MATCH_EXACTLY, true);
+        REQUIRE(loaded.CompileSet(exprs, ids));
+        REQUIRE(loaded.FreezeFromFile(path));
+        CHECK(loaded.Table()->NumStates() == built.Table()->NumStates());
+
+        std::string inputs[] = {"HTTP/1.1 200 OK", std::string(100, 'x') + "password", "nothing"};
+
+        for ( const auto& input : inputs ) {
+            detail::RE_Match_State bs(&built);
+            detail::RE_Match_State ls(&loaded);
+            auto data = reinterpret_cast<const u_char*>(input.data());
+            int len = static_cast<int>(input.size());
+            CHECK(bs.Match(data, len, true, true, false) == ls.Match(data, len, true, true, false));
+            CHECK(bs.AcceptedMatches() == ls.AcceptedMatches());
+        }
+
+        // A table doesn't fit patterns with other equivalence classes.
+        exprs.push_back(const_cast<char*>("[0-9]+"));
+        detail::Specific_RE_Matcher more(detail::MATCH_EXACTLY, true);
+        REQUIRE(more.CompileSet(exprs, {1, 2, 3}));
+        CHECK_FALSE(more.FreezeFromFile(path));
+
+        // Nor does one with accept indices the patterns don't have.
+        detail::Specific_RE_Matcher other_ids(detail::MATCH_EXACTLY, true);
+        REQUIRE(other_ids.CompileSet(exprs, {1, 5, 3}));
+        REQUIRE(other_ids.Freeze(10000));
+        REQUIRE(other_ids.Table()->Save(path));
+
+        detail::Specific_RE_Matcher fewer_ids(detail::MATCH_EXACTLY, true);
+        REQUIRE(fewer_ids.CompileSet(exprs, {1, 2, 3}));
+        CHECK_FALSE(fewer_ids.FreezeFromFile(path));
+
+        // Nor does a truncated file load.
+        REQUIRE(truncate(path, 100) == 0);
+        detail::Specific_RE_Matcher truncated(detail::MATCH_EXACTLY, true);
+        REQUIRE(truncated.CompileSet(exprs, {1, 2, 3}));
+        CHECK_FALSE(truncated.FreezeFromFile(path));
+
+        unlink(path);
+#endif
+    }
 }
 
 } // namespace zeek
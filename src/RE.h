@@ -27,6 +27,7 @@ namespace detail {
 class NFA_Machine;
 class DFA_Machine;
 class DFA_State;
+class DFA_Table;
 class Specific_RE_Matcher;
 class CCL;
 
@@ -122,6 +123,18 @@ public:
 
     DFA_Machine* DFA() const { return dfa; }
 
+    // Expands the DFA into a compact transition table, which matching
+    // then uses instead of the DFA. Fails if the DFA has more than
+    // max_states states.
+    bool Freeze(int max_states);
+
+    // Like Freeze(), but takes the table from a file that DFA_Table::Save()
+    // wrote for the same patterns. Fails if the file can't be used,
+    // including when it refers to accept indices the patterns don't have.
+    bool FreezeFromFile(const char* path);
+
+    const DFA_Table* Table() const { return table; }
+
     void Dump(FILE* f);
 
 protected:
@@ -147,7 +160,9 @@ protected:
     EquivClass equiv_class;
     int* ecs;
     DFA_Machine* dfa;
+    DFA_Table* table;
     AcceptingSet* accepted;
+    AcceptingSet accept_ids; // All accept indices the patterns use.
 
     CCL* any_ccl;
     CCL* single_line_ccl;
@@ -157,9 +172,11 @@ class RE_Match_State {
 public:
     explicit RE_Match_State(Specific_RE_Matcher* matcher) {
         dfa = matcher->DFA() ? matcher->DFA() : nullptr;
+        table = matcher->Table();
         ecs = matcher->EC()->EquivClasses();
         current_pos = -1;
         current_state = nullptr;
+        table_state = 0;
     }
 
     const AcceptingMatchSet& AcceptedMatches() const { return accepted_matches; }
@@ -174,17 +191,26 @@ public:
     void Clear() {
         current_pos = -1;
         current_state = nullptr;
+        table_state = 0;
         accepted_matches.clear();
     }
 
     void AddMatches(const AcceptingSet& as, MatchPos position);
 
 protected:
+    // Match() for matchers with a frozen DFA.
+    bool MatchTable(const u_char* bv, int n, bool bol, bool eol, bool clear);
+
+    // Makes one transition in the frozen DFA, returns false if it jams.
+    bool TableStep(int ec);
+
     DFA_Machine* dfa;
+    const DFA_Table* table;
     int* ecs;
 
     AcceptingMatchSet accepted_matches;
     DFA_State* current_state;
+    uint32_t table_state; // Used instead of current_state with a table.
     int current_pos;
 };
 
@@ -6,9 +6,14 @@
 
 #include <algorithm>
 #include <limits>
+#include <string>
+#include <vector>
 
+#include "zeek/3rdparty/doctest.h"
 #include "zeek/Desc.h"
+#include "zeek/NetVar.h"
 #include "zeek/Reporter.h"
+#include "zeek/telemetry/Manager.h"
 
 using std::min;
 
@@ -16,14 +21,142 @@ namespace zeek {
 
 uint64_t Reassembler::total_size = 0;
 uint64_t Reassembler::sizes[REASSEM_NUM];
+Reassembler* Reassembler::buffering_head = nullptr;
+Reassembler* Reassembler::buffering_tail = nullptr;
+size_t Reassembler::num_buffering = 0;
+uint64_t Reassembler::evictions[REASSEM_NUM];
+std::vector<Reassembler*> Reassembler::largest_heaps[REASSEM_NUM];
+
+namespace {
+
+// Keeps released block buffers around for reuse, so that reassembly on
+// lossy links doesn't keep going back to the allocator. Buffers come in
+// power-of-two size classes, which also leaves room for coalescing
+// contiguous blocks without reallocating every time.
+class BlockPool {
+public:
+    static constexpr int MIN_SHIFT = 6;
+    static constexpr int MAX_SHIFT = 16;
+    static constexpr uint64_t MAX_SIZE = 1 << MAX_SHIFT;
+
+    u_char* Allocate(uint64_t size, uint64_t* capacity) {
+        if ( ! zeek::detail::reassem_buffer_pool_size || size > MAX_SIZE ) {
+            *capacity = 0;
+            return new u_char[size];
+        }
+
+        int shift = MIN_SHIFT;
+        while ( (uint64_t(1) << shift) < size )
+            ++shift;
+
+        *capacity = uint64_t(1) << shift;
+        slack += *capacity - size;
+        auto& l = free_lists[shift - MIN_SHIFT];
+
+        if ( l.empty() )
+            return new u_char[*capacity];
+
+        auto* b = l.back();
+        l.pop_back();
+        cached -= *capacity;
+        return b;
+    }
+
+    // The size is how much of the buffer was in use.
+    void Release(u_char* b, uint64_t capacity, uint64_t size) {
+        if ( ! capacity ) {
+            delete[] b;
+            return;
+        }
+
+        slack -= capacity - size;
+
+        if ( cached + capacity > zeek::detail::reassem_buffer_pool_size ) {
+            delete[] b;
+            return;
+        }
+
+        int shift = MIN_SHIFT;
+        while ( (uint64_t(1) << shift) < capacity )
+            ++shift;
+
+        free_lists[shift - MIN_SHIFT].push_back(b);
+        cached += capacity;
+    }
+
+    // Records that a buffer's used part grew in place.
+    void Grow(uint64_t n) { slack -= n; }
+
+    // Frees cached buffers, largest first, until at most max_cached bytes
+    // remain cached.
+    void Trim(uint64_t max_cached) {
+        for ( int i = MAX_SHIFT - MIN_SHIFT; i >= 0 && cached > max_cached; --i ) {
+            auto& l = free_lists[i];
+
+            while ( ! l.empty() && cached > max_cached ) {
+                delete[] l.back();
+                l.pop_back();
+                cached -= uint64_t(1) << (i + MIN_SHIFT);
+            }
+        }
+    }
+
+    // Memory held beyond the data in pooled buffers.
+    uint64_t Overhead() const { return slack + cached; }
+
+    uint64_t Cached() const { return cached; }
+
+private:
+    std::vector<u_char*> free_lists[MAX_SHIFT - MIN_SHIFT + 1];
+    uint64_t cached = 0; // Bytes in the free lists.
+    uint64_t slack = 0;  // Unused bytes of buffers handed out.
+};
+
+// Never destroyed, since blocks may still get released during shutdown.
+BlockPool& block_pool() {
+    static auto* pool = new BlockPool();
+    return *pool;
+}
+
+} // namespace
 
 DataBlock::DataBlock(const u_char* data, uint64_t size, uint64_t arg_seq) {
     seq = arg_seq;
     upper = seq + size;
-    block = new u_char[size];
+    block = Allocate(size, &capacity);
     memcpy(block, data, size);
 }
 
+bool DataBlock::Extend(const u_char* data, uint64_t size) {
+    auto old_size = Size();
+    auto new_size = old_size + size;
+
+    if ( ! capacity || new_size > BlockPool::MAX_SIZE )
+        return false;
+
+    if ( new_size > capacity ) {
+        uint64_t new_capacity;
+        auto* new_block = Allocate(new_size, &new_capacity);
+        memcpy(new_block, block, old_size);
+        Release(block, capacity, old_size);
+        block = new_block;
+        capacity = new_capacity;
+    }
+    else
+        block_pool().Grow(size);
+
+    memcpy(block + old_size, data, size);
+    upper += size;
+    return true;
+}
+
+u_char* DataBlock::Allocate(uint64_t size, uint64_t* capacity) { return block_pool().Allocate(size, capacity); }
+
+void DataBlock::Release(u_char* block, uint64_t capacity, uint64_t size) {
+    if ( block )
+        block_pool().Release(block, capacity, size);
+}
+
 void DataBlockList::DataSize(uint64_t seq_cutoff, uint64_t* below, uint64_t* above) const {
     for ( const auto& e : block_map ) {
         const auto& b = e.second;
@@ -93,9 +226,34 @@ DataBlockMap::const_iterator DataBlockList::FirstBlockAtOrBefore(uint64_t seq) c
     return std::prev(it);
 }
 
+bool DataBlockList::Extend(DataBlockMap::const_iterator it, const u_char* data, uint64_t size) {
+    // Turns the const_iterator into a mutable one.
+    auto& b = block_map.erase(it, it)->second;
+
+    if ( ! b.Extend(data, size) )
+        return false;
+
+    total_data_size += size;
+    Reassembler::sizes[reassembler->rtype] += size;
+    Reassembler::total_size += size;
+    return true;
+}
+
 DataBlockMap::const_iterator DataBlockList::Insert(uint64_t seq, uint64_t upper, const u_char* data,
                                                    DataBlockMap::const_iterator hint) {
     auto size = upper - seq;
+
+    // Merge the data into the preceding block if they are contiguous and
+    // neither has been delivered yet. The reassembler then sees them as one
+    // block that starts above a hole, same as it would have the first of
+    // two separate blocks, and delivers all of it once the hole fills.
+    if ( zeek::detail::reassem_coalesce_blocks && hint != block_map.begin() ) {
+        auto prev = std::prev(hint);
+
+        if ( prev->second.upper == seq && prev->second.seq > reassembler->LastReassemSeq() &&
+             Extend(prev, data, size) )
+            return prev;
+    }
     auto rval = block_map.emplace_hint(hint, seq, DataBlock(data, size, seq));
 
     total_data_size += size;
@@ -251,6 +409,8 @@ Reassembler::Reassembler(uint64_t init_seq, ReassemblerType reassem_type)
       max_old_blocks(0),
       rtype(reassem_type) {}
 
+Reassembler::~Reassembler() { Unlink(); }
+
 void Reassembler::CheckOverlap(const DataBlockList& list, uint64_t seq, uint64_t len, const u_char* data) {
     if ( list.Empty() )
         return;
@@ -330,13 +490,24 @@ void Reassembler::NewBlock(double t, uint64_t seq, uint64_t len, const u_char* d
     auto it = block_list.Insert(seq, upper_seq, data);
     ;
     BlockInserted(it);
+    UpdateBufferingList(true);
 }
 
-uint64_t Reassembler::TrimToSeq(uint64_t seq) { return block_list.Trim(seq, max_old_blocks, &old_block_list); }
+uint64_t Reassembler::TrimToSeq(uint64_t seq) {
+    auto rval = block_list.Trim(seq, max_old_blocks, &old_block_list);
+    UpdateBufferingList(false);
+    return rval;
+}
 
-void Reassembler::ClearBlocks() { block_list.Clear(); }
+void Reassembler::ClearBlocks() {
+    block_list.Clear();
+    UpdateBufferingList(false);
+}
 
-void Reassembler::ClearOldBlocks() { old_block_list.Clear(); }
+void Reassembler::ClearOldBlocks() {
+    old_block_list.Clear();
+    UpdateBufferingList(false);
+}
 
 uint64_t Reassembler::TotalSize() const { return block_list.DataSize() + old_block_list.DataSize(); }
 
@@ -349,4 +520,433 @@ void Reassembler::Undelivered(uint64_t up_to_seq) {
 
 uint64_t Reassembler::MemoryAllocation(ReassemblerType rtype) { return Reassembler::sizes[rtype]; }
 
+void Reassembler::Evict() {
+    if ( ! block_list.Empty() )
+        TrimToSeq(block_list.LastBlock().upper);
+
+    ClearBlocks();
+    ClearOldBlocks();
+}
+
+void Reassembler::UpdateBufferingList(bool touch) {
+    if ( block_list.Empty() && old_block_list.Empty() ) {
+        Unlink();
+        return;
+    }
+
+    if ( ! buffering ) {
+        LinkTail();
+        HeapPush();
+        buffering = true;
+        ++num_buffering;
+        return;
+    }
+
+    HeapUpdate(TotalSize());
+
+    if ( touch && this != buffering_tail ) {
+        UnlinkList();
+        LinkTail();
+    }
+}
+
+void Reassembler::Unlink() {
+    if ( ! buffering )
+        return;
+
+    UnlinkList();
+    HeapRemove();
+    buffering = false;
+    --num_buffering;
+}
+
+void Reassembler::LinkTail() {
+    prev_buffering = buffering_tail;
+    next_buffering = nullptr;
+
+    if ( buffering_tail )
+        buffering_tail->next_buffering = this;
+    else
+        buffering_head = this;
+
+    buffering_tail = this;
+}
+
+void Reassembler::UnlinkList() {
+    if ( prev_buffering )
+        prev_buffering->next_buffering = next_buffering;
+    else
+        buffering_head = next_buffering;
+
+    if ( next_buffering )
+        next_buffering->prev_buffering = prev_buffering;
+    else
+        buffering_tail = prev_buffering;
+
+    prev_buffering = next_buffering = nullptr;
+}
+
+void Reassembler::HeapPush() {
+    auto& heap = largest_heaps[rtype];
+    heap_size = TotalSize();
+    heap_index = heap.size();
+    heap.push_back(this);
+    HeapSiftUp(heap, heap_index);
+}
+
+void Reassembler::HeapRemove() {
+    auto& heap = largest_heaps[rtype];
+    auto i = heap_index;
+    auto* last = heap.back();
+    heap.pop_back();
+
+    if ( last == this )
+        return;
+
+    heap[i] = last;
+    last->heap_index = i;
+    HeapSiftUp(heap, i);
+    HeapSiftDown(heap, last->heap_index);
+}
+
+void Reassembler::HeapUpdate(uint64_t size) {
+    if ( size == heap_size )
+        return;
+
+    auto& heap = largest_heaps[rtype];
+    bool grew = size > heap_size;
+    heap_size = size;
+
+    if ( grew )
+        HeapSiftUp(heap, heap_index);
+    else
+        HeapSiftDown(heap, heap_index);
+}
+
+void Reassembler::HeapSiftUp(std::vector<Reassembler*>& heap, size_t i) {
+    auto* r = heap[i];
+
+    while ( i > 0 ) {
+        auto parent = (i - 1) / 2;
+
+        if ( heap[parent]->heap_size >= r->heap_size )
+            break;
+
+        heap[i] = heap[parent];
+        heap[i]->heap_index = i;
+        i = parent;
+    }
+
+    heap[i] = r;
+    r->heap_index = i;
+}
+
+void Reassembler::HeapSiftDown(std::vector<Reassembler*>& heap, size_t i) {
+    auto* r = heap[i];
+
+    for ( ;; ) {
+        auto child = 2 * i + 1;
+
+        if ( child >= heap.size() )
+            break;
+
+        if ( child + 1 < heap.size() && heap[child + 1]->heap_size > heap[child]->heap_size )
+            ++child;
+
+        if ( heap[child]->heap_size <= r->heap_size )
+            break;
+
+        heap[i] = heap[child];
+        heap[i]->heap_index = i;
+        i = child;
+    }
+
+    heap[i] = r;
+    r->heap_index = i;
+}
+
+Reassembler* Reassembler::LargestBuffering() {
+    Reassembler* largest = nullptr;
+
+    for ( const auto& heap : largest_heaps ) {
+        if ( ! heap.empty() && (! largest || heap[0]->heap_size > largest->heap_size) )
+            largest = heap[0];
+    }
+
+    return largest;
+}
+
+uint64_t Reassembler::BudgetedMemory() { return total_size + block_pool().Overhead(); }
+
+void Reassembler::TrimBufferPool(uint64_t max_cached) { block_pool().Trim(max_cached); }
+
+void Reassembler::EnforceMemoryBudget() {
+    auto budget = zeek::detail::reassem_memory_budget;
+
+    if ( ! budget || BudgetedMemory() <= budget )
+        return;
+
+    // Evict a bit more than needed so that we don't end up doing this for
+    // every packet once we're at the limit.
+    uint64_t target = budget - budget / 10;
+
+    // Evicting normally removes a reassembler from the list, but don't
+    // rely on it to avoid getting stuck.
+    size_t n = num_buffering;
+
+    for ( ;; ) {
+        auto usage = BudgetedMemory();
+
+        if ( usage <= target )
+            break;
+
+        // Buffers cached for reuse are the cheapest to give up. Evicting
+        // adds more of them, so check again after each eviction.
+        auto excess = usage - target;
+        auto cached = block_pool().Cached();
+
+        if ( cached ) {
+            TrimBufferPool(cached > excess ? cached - excess : 0);
+            continue;
+        }
+
+        if ( n == 0 || ! buffering_head )
+            break;
+
+        --n;
+
+        Reassembler* victim =
+            zeek::detail::reassem_eviction_policy == EVICT_LARGEST ? LargestBuffering() : buffering_head;
+        ++evictions[victim->rtype];
+        victim->Evict();
+    }
+}
+
+void Reassembler::InitPostScript() {
+    static const char* type_names[REASSEM_NUM] = {"unknown", "tcp", "frag", "file"};
+
+    static std::vector<telemetry::GaugePtr> buffered_metrics;
+    static std::vector<telemetry::GaugePtr> largest_metrics;
+    static std::vector<telemetry::CounterPtr> eviction_metrics;
+
+    auto buffered_family = telemetry_mgr->GaugeFamily("zeek", "reassembly_buffered_bytes", {"type"},
+                                                      "Number of bytes buffered by reassemblers of a certain type");
+    auto largest_family =
+        telemetry_mgr->GaugeFamily("zeek", "reassembly_largest_buffered_bytes", {"type"},
+                                   "Number of bytes buffered by the largest reassembler of a certain type");
+    auto eviction_family =
+        telemetry_mgr->CounterFamily("zeek", "reassembly_evictions", {"type"},
+                                     "Number of reassemblers flushed to stay within reassem_memory_budget");
+
+    for ( int i = 0; i < REASSEM_NUM; i++ ) {
+        telemetry::LabelView label = {"type", type_names[i]};
+
+        buffered_metrics.push_back(buffered_family->GetOrAdd({label}, [i]() -> prometheus::ClientMetric {
+            prometheus::ClientMetric metric;
+            metric.gauge.value = static_cast<double>(Reassembler::sizes[i]);
+            return metric;
+        }));
+
+        largest_metrics.push_back(largest_family->GetOrAdd({label}, [i]() -> prometheus::ClientMetric {
+            const auto& heap = Reassembler::largest_heaps[i];
+            prometheus::ClientMetric metric;
+            metric.gauge.value = heap.empty() ? 0.0 : static_cast<double>(heap[0]->heap_size);
+            return metric;
+        }));
+
+        eviction_metrics.push_back(eviction_family->GetOrAdd({label}, [i]() -> prometheus::ClientMetric {
+            prometheus::ClientMetric metric;
+            metric.counter.value = static_cast<double>(Reassembler::evictions[i]);
+            return metric;
+        }));
+    }
+}
+
+namespace {
+
+// Delivers in-order data like the TCP reassembler does, but into a string.
+class TestReassembler : public Reassembler {
+public:
+    TestReassembler() : Reassembler(0) {}
+
+    size_t NumBlocks() const { return block_list.NumBlocks(); }
+
+    std::vector<std::string> deliveries;
+
+protected:
+    void BlockInserted(DataBlockMap::const_iterator it) override {
+        for ( ; it != block_list.End() && it->second.seq <= last_reassem_seq; ++it ) {
+            const auto& b = it->second;
+
+            if ( b.seq == last_reassem_seq ) {
+                deliveries.emplace_back(reinterpret_cast<const char*>(b.block), b.Size());
+                last_reassem_seq = b.upper;
+            }
+        }
+    }
+
+    void Overlap(const u_char* b1, const u_char* b2, uint64_t n) override {}
+};
+
+void new_block(TestReassembler& r, uint64_t seq, const char* data) {
+    r.NewBlock(0.0, seq, strlen(data), reinterpret_cast<const u_char*>(data));
+}
+
+} // namespace
+
+TEST_CASE("reassembler coalesce blocks") {
+    auto saved_coalesce = zeek::detail::reassem_coalesce_blocks;
+    auto saved_pool_size = zeek::detail::reassem_buffer_pool_size;
+
+    zeek::detail::reassem_buffer_pool_size = 1024 * 1024;
+
+    SUBCASE("enabled") {
+        zeek::detail::reassem_coalesce_blocks = true;
+        TestReassembler r;
+
+        // Contiguous blocks above a hole get merged.
+        new_block(r, 5, "fgh");
+        new_block(r, 8, "ij");
+        new_block(r, 12, "mn");
+        CHECK(r.NumBlocks() == 2);
+        CHECK(r.TotalSize() == 7);
+
+        // Overlapping data only adds what's new.
+        new_block(r, 9, "jkl");
+        CHECK(r.NumBlocks() == 2);
+        CHECK(r.TotalSize() == 9);
+
+        new_block(r, 0, "abcde");
+        std::vector<std::string> expected = {"abcde", "fghijkl", "mn"};
+        CHECK(r.deliveries == expected);
+
+        // Delivered blocks don't get extended.
+        new_block(r, 14, "op");
+        CHECK(r.NumBlocks() == 4);
+        CHECK(r.deliveries.back() == "op");
+    }
+
+    SUBCASE("disabled") {
+        zeek::detail::reassem_coalesce_blocks = false;
+        TestReassembler r;
+
+        new_block(r, 5, "fgh");
+        new_block(r, 8, "ij");
+        CHECK(r.NumBlocks() == 2);
+
+        new_block(r, 0, "abcde");
+        std::vector<std::string> expected = {"abcde", "fgh", "ij"};
+        CHECK(r.deliveries == expected);
+    }
+
+    SUBCASE("large blocks") {
+        zeek::detail::reassem_coalesce_blocks = true;
+        TestReassembler r;
+
+        std::string big(70000, 'x');
+        new_block(r, 5, big.c_str());
+        new_block(r, 5 + big.size(), "y");
+        CHECK(r.NumBlocks() == 2);
+    }
+
+    zeek::detail::reassem_coalesce_blocks = saved_coalesce;
+    zeek::detail::reassem_buffer_pool_size = saved_pool_size;
+}
+
+TEST_CASE("reassembler memory budget") {
+    auto saved_budget = zeek::detail::reassem_memory_budget;
+    auto saved_policy = zeek::detail::reassem_eviction_policy;
+
+    std::string small(100, 'x');
+    std::string large(1000, 'x');
+
+    // Start out without cached buffers, which the budget counts as well.
+    Reassembler::TrimBufferPool(0);
+
+    TestReassembler a;
+    TestReassembler b;
+    TestReassembler c;
+
+    // All data sits above a hole, with "a" used least recently.
+    new_block(a, 10, small.c_str());
+    new_block(b, 10, large.c_str());
+    new_block(c, 10, small.c_str());
+
+    // Requires evicting more than the small ones.
+    auto evictions = Reassembler::NumEvictions(REASSEM_UNKNOWN);
+    zeek::detail::reassem_memory_budget = Reassembler::BudgetedMemory() - small.size() - 1;
+
+    SUBCASE("lru") {
+        zeek::detail::reassem_eviction_policy = Reassembler::EVICT_LRU;
+        Reassembler::EnforceMemoryBudget();
+
+        CHECK(a.TotalSize() == 0);
+        CHECK(b.TotalSize() == 0);
+        CHECK(c.TotalSize() == small.size());
+        CHECK(Reassembler::NumEvictions(REASSEM_UNKNOWN) == evictions + 2);
+
+        // Evicted data counts as delivered.
+        CHECK(a.LastReassemSeq() == 10 + small.size());
+        CHECK(a.TrimSeq() == 10 + small.size());
+    }
+
+    SUBCASE("largest") {
+        zeek::detail::reassem_eviction_policy = Reassembler::EVICT_LARGEST;
+        Reassembler::EnforceMemoryBudget();
+
+        CHECK(a.TotalSize() == small.size());
+        CHECK(b.TotalSize() == 0);
+        CHECK(c.TotalSize() == small.size());
+        CHECK(Reassembler::NumEvictions(REASSEM_UNKNOWN) == evictions + 1);
+    }
+
+    SUBCASE("largest after growth") {
+        // "a" overtakes "b" as the largest.
+        new_block(a, 10 + small.size(), (large + large).c_str());
+        zeek::detail::reassem_memory_budget = Reassembler::BudgetedMemory() - small.size() - 1;
+        zeek::detail::reassem_eviction_policy = Reassembler::EVICT_LARGEST;
+        Reassembler::EnforceMemoryBudget();
+
+        CHECK(a.TotalSize() == 0);
+        CHECK(b.TotalSize() == large.size());
+        CHECK(c.TotalSize() == small.size());
+        CHECK(Reassembler::NumEvictions(REASSEM_UNKNOWN) == evictions + 1);
+    }
+
+    SUBCASE("within budget") {
+        zeek::detail::reassem_memory_budget = Reassembler::BudgetedMemory();
+        Reassembler::EnforceMemoryBudget();
+
+        CHECK(a.TotalSize() + b.TotalSize() + c.TotalSize() == 2 * small.size() + large.size());
+        CHECK(Reassembler::NumEvictions(REASSEM_UNKNOWN) == evictions);
+    }
+
+    zeek::detail::reassem_memory_budget = saved_budget;
+    zeek::detail::reassem_eviction_policy = saved_policy;
+}
+
+TEST_CASE("reassembler memory budget counts pooled buffers") {
+    auto saved_pool_size = zeek::detail::reassem_buffer_pool_size;
+    zeek::detail::reassem_buffer_pool_size = 1024 * 1024;
+
+    Reassembler::TrimBufferPool(0);
+    auto base = Reassembler::BudgetedMemory();
+
+    TestReassembler r;
+    std::string data(100, 'x');
+    new_block(r, 10, data.c_str());
+
+    // The block's buffer is rounded up to 128 bytes.
+    CHECK(Reassembler::BudgetedMemory() - base == 128 + sizeof(DataBlock));
+
+    // Released buffers stay cached in the pool until trimmed.
+    r.ClearBlocks();
+    CHECK(Reassembler::BudgetedMemory() - base == 128);
+
+    Reassembler::TrimBufferPool(0);
+    CHECK(Reassembler::BudgetedMemory() == base);
+
+    zeek::detail::reassem_buffer_pool_size = saved_pool_size;
+}
+
 } // namespace zeek
@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <cstring>
 #include <map>
+#include <vector>
 
 #include "zeek/Obj.h"
 
@@ -40,7 +41,7 @@ public:
         seq = other.seq;
         upper = other.upper;
         auto size = other.Size();
-        block = new u_char[size];
+        block = Allocate(size, &capacity);
         memcpy(block, other.block, size);
     }
 
@@ -48,18 +49,20 @@ public:
         seq = other.seq;
         upper = other.upper;
         block = other.block;
+        capacity = other.capacity;
         other.block = nullptr;
+        other.capacity = 0;
     }
 
     DataBlock& operator=(const DataBlock& other) {
         if ( this == &other )
             return *this;
 
+        Release(block, capacity, Size());
         seq = other.seq;
         upper = other.upper;
         auto size = other.Size();
-        delete[] block;
-        block = new u_char[size];
+        block = Allocate(size, &capacity);
         memcpy(block, other.block, size);
         return *this;
     }
@@ -68,24 +71,42 @@ public:
         if ( this == &other )
             return *this;
 
+        Release(block, capacity, Size());
         seq = other.seq;
         upper = other.upper;
-        delete[] block;
         block = other.block;
+        capacity = other.capacity;
         other.block = nullptr;
+        other.capacity = 0;
         return *this;
     }
 
-    ~DataBlock() { delete[] block; }
+    ~DataBlock() { Release(block, capacity, Size()); }
 
     /**
      * @return length of the data block
      */
     uint64_t Size() const { return upper - seq; }
 
+    /**
+     * Appends data to the end of the block, growing its buffer if needed.
+     * @param data  the data to append
+     * @param size  the number of bytes to append
+     * @return false if the block's buffer didn't come from the buffer
+     * pool or would grow too large, in which case nothing changes
+     */
+    bool Extend(const u_char* data, uint64_t size);
+
     uint64_t seq;
     uint64_t upper;
     u_char* block;
+
+    // Size of the buffer if it came from the buffer pool, zero otherwise.
+    uint64_t capacity = 0;
+
+private:
+    static u_char* Allocate(uint64_t size, uint64_t* capacity);
+    static void Release(u_char* block, uint64_t capacity, uint64_t size);
 };
 
 using DataBlockMap = std::map<uint64_t, DataBlock>;
@@ -214,6 +235,16 @@ private:
     DataBlockMap::const_iterator Insert(uint64_t seq, uint64_t upper, const u_char* data,
                                         DataBlockMap::const_iterator hint);
 
+    /**
+     * Appends data to an existing block and updates other state which
+     * keeps track of total size of blocks.
+     * @param it  the block to extend
+     * @param data  the data to append
+     * @param size  the number of bytes to append
+     * @return false if the block couldn't be extended
+     */
+    bool Extend(DataBlockMap::const_iterator it, const u_char* data, uint64_t size);
+
     /**
      * Removes a block from the list and updates other state which keeps
      * track of total size of blocks.
@@ -237,7 +268,7 @@ private:
 class Reassembler : public Obj {
 public:
     Reassembler(uint64_t init_seq, ReassemblerType reassem_type = REASSEM_UNKNOWN);
-    ~Reassembler() override {}
+    ~Reassembler() override;
 
     void NewBlock(double t, uint64_t seq, uint64_t len, const u_char* data);
 
@@ -269,13 +300,56 @@ public:
     // Data buffered by type of reassembler.
     static uint64_t MemoryAllocation(ReassemblerType rtype);
 
+    /**
+     * @return the memory counted against reassem_memory_budget: the
+     * buffered data plus the unused parts of pooled buffers holding it and
+     * the buffers cached by the pool for reuse.
+     */
+    static uint64_t BudgetedMemory();
+
+    /**
+     * Frees buffers cached by the buffer pool until it holds at most the
+     * given number of bytes.
+     */
+    static void TrimBufferPool(uint64_t max_cached);
+
     void SetMaxOldBlocks(uint32_t count) { max_old_blocks = count; }
 
+    // Values of reassem_eviction_policy.
+    static const int EVICT_LRU = 0;
+    static const int EVICT_LARGEST = 1;
+
+    // Number of reassemblers flushed to stay within the memory budget.
+    static uint64_t NumEvictions(ReassemblerType rtype) { return evictions[rtype]; }
+
+    /**
+     * If all reassemblers together buffer more than reassem_memory_budget
+     * bytes, evicts the data of some of them (chosen according to
+     * reassem_eviction_policy) until usage drops below 90% of the budget.
+     * Must be called between packets, since evicting delivers data.
+     */
+    static void EnforceMemoryBudget();
+
+    /**
+     * Sets up the reassembly metrics. Called once the telemetry manager
+     * is ready.
+     */
+    static void InitPostScript();
+
 protected:
     friend class DataBlockList;
 
     virtual void Undelivered(uint64_t up_to_seq);
 
+    /**
+     * Discards all buffered data to free up memory. The default skips
+     * ahead to the end of the buffered data, as if it had all been
+     * acknowledged: data above holes gets delivered, and the holes get
+     * reported through Undelivered(). Subclasses may override this to
+     * report the eviction as well.
+     */
+    virtual void Evict();
+
     virtual void BlockInserted(DataBlockMap::const_iterator it) = 0;
     virtual void Overlap(const u_char* b1, const u_char* b2, uint64_t n) = 0;
 
@@ -292,6 +366,39 @@ protected:
 
     static uint64_t total_size;
     static uint64_t sizes[REASSEM_NUM];
+
+private:
+    // Keeps track of which reassemblers hold data, in the order they last
+    // received any. If touch is true, moves this one to the end.
+    void UpdateBufferingList(bool touch);
+    void Unlink();
+    void LinkTail();
+    void UnlinkList();
+
+    // Maintains the per-type max-heaps of reassemblers holding data, keyed
+    // by heap_size.
+    void HeapPush();
+    void HeapRemove();
+    void HeapUpdate(uint64_t size);
+    static void HeapSiftUp(std::vector<Reassembler*>& heap, size_t i);
+    static void HeapSiftDown(std::vector<Reassembler*>& heap, size_t i);
+
+    static Reassembler* LargestBuffering();
+
+    // Reassemblers holding data, least recently used first.
+    Reassembler* prev_buffering = nullptr;
+    Reassembler* next_buffering = nullptr;
+    bool buffering = false;
+
+    // Position in, and size as last seen by, the heap for the type.
+    size_t heap_index = 0;
+    uint64_t heap_size = 0;
+
+    static Reassembler* buffering_head;
+    static Reassembler* buffering_tail;
+    static size_t num_buffering;
+    static std::vector<Reassembler*> largest_heaps[REASSEM_NUM];
+    static uint64_t evictions[REASSEM_NUM];
 };
 
 } // namespace zeek
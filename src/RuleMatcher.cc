@@ -4,6 +4,8 @@
 #include "zeek/zeek-config.h"
 
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <functional>
 
 #include "zeek/DFA.h"
@@ -23,6 +25,7 @@
 #include "zeek/Var.h"
 #include "zeek/ZeekString.h"
 #include "zeek/analyzer/Analyzer.h"
+#include "zeek/digest.h"
 #include "zeek/module_util.h"
 
 using namespace std;
@@ -464,6 +467,10 @@ void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst, const str
             RuleHdrTest::PatternSet* set = new RuleHdrTest::PatternSet;
             set->re = new Specific_RE_Matcher(MATCH_EXACTLY, true);
             set->re->CompileSet(group_exprs, group_ids);
+
+            if ( sig_dfa_table_max_states > 0 )
+                FreezePatternSet(set->re, group_exprs, group_ids);
+
             set->patterns = group_exprs;
             set->ids = group_ids;
             dst->push_back(set);
@@ -474,6 +481,47 @@ void RuleMatcher::BuildPatternSets(RuleHdrTest::pattern_set_list* dst, const str
     }
 }
 
+void RuleMatcher::FreezePatternSet(Specific_RE_Matcher* re, const string_list& exprs, const int_list& ids) {
+    static auto cache_dir = id::find_val<StringVal>("sig_dfa_cache_dir");
+
+    std::string cache_file;
+
+    if ( cache_dir->Len() > 0 ) {
+        // Name the file after everything that goes into the table, so that
+        // changed rules or a new version never pick up a stale one.
+        u_char digest[ZEEK_SHA256_DIGEST_LENGTH];
+        auto* ctx = hash_init(Hash_SHA256);
+        uint32_t format = DFA_Table::FORMAT_VERSION;
+
+        hash_update(ctx, VERSION, strlen(VERSION));
+        hash_update(ctx, &format, sizeof(format));
+        hash_update(ctx, &sig_dfa_table_max_states, sizeof(sig_dfa_table_max_states));
+
+        for ( int i = 0; i < exprs.length(); ++i ) {
+            // Include the terminating null to keep the patterns apart.
+            hash_update(ctx, exprs[i], strlen(exprs[i]) + 1);
+            hash_update(ctx, &ids[i], sizeof(ids[i]));
+        }
+
+        hash_final(ctx, digest);
+
+        cache_file = util::fmt("%s/%s.dfa", cache_dir->CheckString(), sha256_digest_print(digest));
+
+        if ( re->FreezeFromFile(cache_file.c_str()) ) {
+            DBG_LOG(DBG_RULES, "loaded DFA of group with %d patterns from %s", exprs.length(), cache_file.c_str());
+            return;
+        }
+    }
+
+    if ( ! re->Freeze(sig_dfa_table_max_states) ) {
+        DBG_LOG(DBG_RULES, "DFA of group with %d patterns exceeds sig_dfa_table_max_states", exprs.length());
+        return;
+    }
+
+    if ( ! cache_file.empty() && ! re->Table()->Save(cache_file.c_str()) )
+        reporter->Warning("cannot write signature DFA cache file %s: %s", cache_file.c_str(), strerror(errno));
+}
+
 // Get a 8/16/32-bit value from the given position in the packet header
 static inline uint32_t getval(const u_char* data, int size) {
     switch ( size ) {
@@ -1079,6 +1127,8 @@ void RuleMatcher::GetStats(Stats* stats, RuleHdrTest* hdr_test) const {
             stats->dfa_states += cstats.dfa_states;
             stats->computed += cstats.computed;
             stats->mem += cstats.mem;
+            if ( set->re->Table() )
+                stats->mem += set->re->Table()->Size();
             stats->hits += cstats.hits;
             stats->misses += cstats.misses;
             stats->nfa_states += cstats.nfa_states;
@@ -328,6 +328,10 @@ private:
     // Build groups of regular expressions.
     void BuildPatternSets(RuleHdrTest::pattern_set_list* dst, const string_list& exprs, const int_list& ids);
 
+    // Freeze a group's DFA into a table, going through the cache in
+    // sig_dfa_cache_dir if set.
+    void FreezePatternSet(Specific_RE_Matcher* re, const string_list& exprs, const int_list& ids);
+
     // Check an arbitrary rule if it's satisfied right now.
     // eos signals end of stream
     void ExecRule(Rule* rule, RuleEndpointState* state, bool eos);
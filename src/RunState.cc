@@ -28,6 +28,7 @@ extern "C" {
 #include "zeek/Event.h"
 #include "zeek/ID.h"
 #include "zeek/NetVar.h"
+#include "zeek/Reassem.h"
 #include "zeek/Reporter.h"
 #include "zeek/Scope.h"
 #include "zeek/Timer.h"
@@ -240,6 +241,7 @@ void dispatch_packet(Packet* pkt, iosource::PktSrc* pkt_src) {
     expire_timers();
 
     packet_mgr->ProcessPacket(pkt);
+    Reassembler::EnforceMemoryBudget();
     event_mgr.Drain();
 
     processing_start_time = 0.0; // = "we're not processing now"
@@ -1141,7 +1141,7 @@ ValPtr ForStmt::DoExec(Frame* f, Val* v, StmtFlowType& flow) {
 
     if ( v->GetType()->Tag() == TYPE_TABLE ) {
         TableVal* tv = v->AsTableVal();
-        const PDict<TableEntryVal>* loop_vals = tv->AsTable();
+        const PDict<TableEntryVal>* loop_vals = tv->GetForIteration();
 
         if ( ! loop_vals->Length() )
             return nullptr;
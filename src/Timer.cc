@@ -98,6 +98,12 @@ void TimerMgr::InitPostScript() {
 
     dispatch_all_expired = zeek::detail::max_timer_expires == 0;
 
+    if ( timer_wheel_resolution > 0.0 && ! wheel ) {
+        // Carry over whatever got scheduled while parsing scripts.
+        wheel = std::make_unique<TimerWheel>(timer_wheel_resolution);
+        wheel->Absorb(q.get());
+    }
+
     cumulative_num_metric = telemetry_mgr->CounterInstance("zeek", "timers", {}, "Cumulative number of timers", "",
                                                            []() -> prometheus::ClientMetric {
                                                                prometheus::ClientMetric metric;
@@ -133,7 +139,7 @@ void TimerMgr::Add(Timer* timer) {
     // Add the timer even if it's already expired - that way, if
     // multiple already-added timers are added, they'll still
     // execute in sorted order.
-    if ( ! q->Add(timer) )
+    if ( ! (wheel ? wheel->Add(timer) : q->Add(timer)) )
         reporter->InternalError("out of memory");
 
     ++current_timers[timer->Type()];
@@ -150,6 +156,9 @@ void TimerMgr::Expire() {
 }
 
 int TimerMgr::DoAdvance(double new_t, int max_expire) {
+    if ( wheel )
+        wheel->Advance(new_t);
+
     Timer* timer = Top();
     for ( num_expired = 0; (num_expired < max_expire || dispatch_all_expired) && timer && timer->Time() <= new_t;
           ++num_expired ) {
@@ -172,7 +181,7 @@ int TimerMgr::DoAdvance(double new_t, int max_expire) {
 }
 
 void TimerMgr::Remove(Timer* timer) {
-    if ( ! q->Remove(timer) )
+    if ( ! (wheel ? wheel->Remove(timer) : q->Remove(timer)) )
         reporter->InternalError("asked to remove a missing timer");
 
     --current_timers[timer->Type()];
@@ -180,6 +189,14 @@ void TimerMgr::Remove(Timer* timer) {
 }
 
 double TimerMgr::GetNextTimeout() {
+    if ( wheel ) {
+        auto next = wheel->NextTime();
+        if ( next )
+            return std::max(0.0, *next - run_state::network_time);
+
+        return -1;
+    }
+
     Timer* top = Top();
     if ( top )
         return std::max(0.0, top->Time() - run_state::network_time);
@@ -187,8 +204,8 @@ double TimerMgr::GetNextTimeout() {
     return -1;
 }
 
-Timer* TimerMgr::Remove() { return (Timer*)q->Remove(); }
+Timer* TimerMgr::Remove() { return (Timer*)(wheel ? wheel->Remove() : q->Remove()); }
 
-Timer* TimerMgr::Top() { return (Timer*)q->Top(); }
+Timer* TimerMgr::Top() { return (Timer*)(wheel ? wheel->Top() : q->Top()); }
 
 } // namespace zeek::detail
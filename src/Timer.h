@@ -6,6 +6,7 @@
 #include <memory>
 
 #include "zeek/PriorityQueue.h"
+#include "zeek/TimerWheel.h"
 #include "zeek/iosource/IOSource.h"
 
 namespace zeek {
@@ -120,9 +121,9 @@ public:
 
     double Time() const { return t ? t : 1; } // 1 > 0
 
-    size_t Size() const { return q->Size(); }
-    size_t PeakSize() const { return q->PeakSize(); }
-    size_t CumulativeNum() const { return q->CumulativeNum(); }
+    size_t Size() const { return wheel ? wheel->Size() : q->Size(); }
+    size_t PeakSize() const { return wheel ? wheel->PeakSize() : q->PeakSize(); }
+    size_t CumulativeNum() const { return wheel ? wheel->CumulativeNum() : q->CumulativeNum(); }
 
     double LastTimestamp() const { return last_timestamp; }
 
@@ -167,6 +168,10 @@ private:
     telemetry::GaugePtr current_timer_metrics[NUM_TIMER_TYPES];
 
     std::unique_ptr<PriorityQueue> q;
+
+    // If set (via timer_wheel_resolution), pending timers live here
+    // instead of in q.
+    std::unique_ptr<TimerWheel> wheel;
 };
 
 extern TimerMgr* timer_mgr;
@@ -0,0 +1,496 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/TimerWheel.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "zeek/3rdparty/doctest.h"
+#include "zeek/MicroBenchmark.h"
+
+namespace zeek::detail {
+
+namespace {
+
+// Index of the lowest set bit; x must be non-zero.
+int lowest_bit(uint64_t x) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward64(&idx, x);
+    return static_cast<int>(idx);
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// Index of the highest set bit; x must be non-zero.
+int highest_bit(uint64_t x) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanReverse64(&idx, x);
+    return static_cast<int>(idx);
+#else
+    return 63 - __builtin_clzll(x);
+#endif
+}
+
+// Ticks beyond this are clamped, keeping far-future times (like the
+// HUGE_VAL some timers use) well-defined.
+constexpr uint64_t MAX_TICK = uint64_t(1) << 62;
+
+} // namespace
+
+TimerWheel::TimerWheel(double arg_resolution) : resolution(arg_resolution) {}
+
+TimerWheel::~TimerWheel() {
+    for ( auto& slot : slots )
+        for ( auto* e : slot )
+            delete e;
+
+    // The ready and overflow queues delete their own elements.
+}
+
+void TimerWheel::Absorb(PriorityQueue* pq) {
+    PQ_Element* e;
+    while ( (e = pq->Remove()) ) {
+        Place(e, TickOf(e->Time()));
+        ++size;
+    }
+
+    cumulative_num += pq->CumulativeNum();
+    peak_size = std::max({peak_size, size, pq->PeakSize()});
+}
+
+bool TimerWheel::Add(PQ_Element* e) {
+    Place(e, TickOf(e->Time()));
+
+    ++cumulative_num;
+
+    if ( ++size > peak_size )
+        peak_size = size;
+
+    return true;
+}
+
+PQ_Element* TimerWheel::Remove(PQ_Element* e) {
+    auto bucket = e->Bucket();
+
+    if ( bucket == READY_BUCKET ) {
+        if ( ! ready.Remove(e) )
+            return nullptr;
+    }
+
+    else if ( bucket == OVERFLOW_BUCKET ) {
+        if ( ! overflow.Remove(e) )
+            return nullptr;
+    }
+
+    else if ( bucket >= FIRST_SLOT && bucket < FIRST_SLOT + LEVELS * SLOTS ) {
+        int idx = bucket - FIRST_SLOT;
+        auto& slot = slots[idx];
+        int off = e->Offset();
+
+        if ( off < 0 || static_cast<size_t>(off) >= slot.size() || slot[off] != e )
+            return nullptr;
+
+        slot[off] = slot.back();
+        slot[off]->SetOffset(off);
+        slot.pop_back();
+
+        if ( slot.empty() )
+            occupied[idx / SLOTS] &= ~(uint64_t(1) << (idx % SLOTS));
+    }
+
+    else
+        return nullptr;
+
+    e->SetBucket(NO_BUCKET);
+    e->SetOffset(-1);
+    --size;
+
+    return e;
+}
+
+void TimerWheel::Advance(double t) { AdvanceTo(TickOf(t)); }
+
+PQ_Element* TimerWheel::Remove() {
+    uint64_t tick;
+    while ( ready.Size() == 0 && NextTick(&tick) )
+        AdvanceTo(tick);
+
+    PQ_Element* e = ready.Remove();
+    if ( ! e )
+        return nullptr;
+
+    e->SetBucket(NO_BUCKET);
+    --size;
+
+    return e;
+}
+
+std::optional<double> TimerWheel::NextTime() const {
+    if ( ready.Size() > 0 )
+        return ready.Top()->Time();
+
+    int level, slot;
+    if ( EarliestSlot(&level, &slot) ) {
+        if ( level > 0 )
+            return SlotStart(level, slot) * resolution;
+
+        // All elements of a level-0 slot share the same tick.
+        double t = HUGE_VAL;
+        for ( const auto* e : slots[slot] )
+            t = std::min(t, e->Time());
+
+        return t;
+    }
+
+    if ( overflow.Size() > 0 )
+        return overflow.Top()->Time();
+
+    return std::nullopt;
+}
+
+uint64_t TimerWheel::TickOf(double t) const {
+    // Written so that NaN ends up as 0.
+    if ( ! (t > 0.0) )
+        return 0;
+
+    double tick = std::floor(t / resolution);
+    if ( tick >= static_cast<double>(MAX_TICK) )
+        return MAX_TICK;
+
+    return static_cast<uint64_t>(tick);
+}
+
+void TimerWheel::Place(PQ_Element* e, uint64_t tick) {
+    if ( tick <= cur_tick ) {
+        ready.Add(e);
+        e->SetBucket(READY_BUCKET);
+        return;
+    }
+
+    int level = highest_bit(tick ^ cur_tick) / SLOT_BITS;
+
+    if ( level >= LEVELS ) {
+        overflow.Add(e);
+        e->SetBucket(OVERFLOW_BUCKET);
+        return;
+    }
+
+    int slot = static_cast<int>(tick >> (level * SLOT_BITS)) & (SLOTS - 1);
+    int idx = level * SLOTS + slot;
+
+    e->SetBucket(FIRST_SLOT + idx);
+    e->SetOffset(static_cast<int>(slots[idx].size()));
+    slots[idx].push_back(e);
+    occupied[level] |= uint64_t(1) << slot;
+}
+
+void TimerWheel::AdvanceTo(uint64_t target) {
+    // Every element still in the wheel has a tick beyond cur_tick, and
+    // on each level the occupied slots all lie ahead of cur_tick's digit
+    // for that level.  So the lowest occupied slot on the lowest
+    // occupied level always starts the earliest pending range, and
+    // moving cur_tick up to just before it requires no reshuffling.
+    while ( cur_tick < target ) {
+        int level = -1;
+        int slot = 0;
+        uint64_t next;
+
+        if ( EarliestSlot(&level, &slot) )
+            next = SlotStart(level, slot);
+        else if ( overflow.Size() > 0 )
+            next = TickOf(overflow.Top()->Time());
+        else
+            next = MAX_TICK + 1;
+
+        if ( next > target ) {
+            cur_tick = target;
+            PullOverflow();
+            break;
+        }
+
+        cur_tick = next;
+
+        if ( level >= 0 )
+            Cascade(level, slot);
+
+        PullOverflow();
+    }
+}
+
+bool TimerWheel::EarliestSlot(int* level, int* slot) const {
+    for ( int l = 0; l < LEVELS; ++l ) {
+        if ( occupied[l] ) {
+            *level = l;
+            *slot = lowest_bit(occupied[l]);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint64_t TimerWheel::SlotStart(int level, int slot) const {
+    int shift = level * SLOT_BITS;
+    uint64_t prefix = (cur_tick >> (shift + SLOT_BITS)) << (shift + SLOT_BITS);
+    return prefix | (static_cast<uint64_t>(slot) << shift);
+}
+
+bool TimerWheel::NextTick(uint64_t* tick) const {
+    int level, slot;
+    if ( EarliestSlot(&level, &slot) ) {
+        *tick = SlotStart(level, slot);
+        return true;
+    }
+
+    if ( overflow.Size() > 0 ) {
+        *tick = TickOf(overflow.Top()->Time());
+        return true;
+    }
+
+    return false;
+}
+
+void TimerWheel::Cascade(int level, int slot) {
+    int idx = level * SLOTS + slot;
+
+    std::vector<PQ_Element*> elems;
+    elems.swap(slots[idx]);
+    occupied[level] &= ~(uint64_t(1) << slot);
+
+    // All of these now either are due or belong to a lower level, so
+    // none of them come back into this slot.
+    for ( auto* e : elems )
+        Place(e, TickOf(e->Time()));
+
+    // Hand the storage back to keep its capacity around.
+    elems.clear();
+    slots[idx].swap(elems);
+}
+
+void TimerWheel::PullOverflow() {
+    constexpr int top_shift = LEVELS * SLOT_BITS;
+
+    while ( overflow.Size() > 0 ) {
+        uint64_t tick = TickOf(overflow.Top()->Time());
+
+        if ( (tick >> top_shift) != (cur_tick >> top_shift) && tick > cur_tick )
+            break;
+
+        Place(overflow.Remove(), tick);
+    }
+}
+
+TEST_SUITE_BEGIN("TimerWheel");
+
+namespace {
+
+class TestElement : public PQ_Element {
+public:
+    explicit TestElement(double t) : PQ_Element(t) {}
+};
+
+} // namespace
+
+TEST_CASE("timer wheel ordering") {
+    TimerWheel w(0.01);
+
+    double times[] = {5.0, 0.5, 1e6, 0.003, 70.25, 0.5, 3600.0, 1e9, 42.0};
+    for ( double t : times )
+        w.Add(new TestElement(t));
+
+    CHECK(w.Size() == 9);
+    CHECK(w.CumulativeNum() == 9);
+
+    std::vector<double> sorted(std::begin(times), std::end(times));
+    std::sort(sorted.begin(), sorted.end());
+
+    for ( double t : sorted ) {
+        PQ_Element* e = w.Remove();
+        REQUIRE(e);
+        CHECK(e->Time() == t);
+        delete e;
+    }
+
+    CHECK(w.Remove() == nullptr);
+    CHECK(w.Size() == 0);
+    CHECK(w.PeakSize() == 9);
+}
+
+TEST_CASE("timer wheel advance") {
+    TimerWheel w(0.001);
+
+    for ( int i = 1; i <= 1000; ++i )
+        w.Add(new TestElement(1000.0 + i * 0.25));
+
+    CHECK(! w.Top());
+    CHECK(*w.NextTime() <= 1000.25);
+
+    w.Advance(1010.0);
+
+    int n = 0;
+    double last = 0.0;
+    while ( w.Top() && w.Top()->Time() <= 1010.0 ) {
+        PQ_Element* e = w.Remove();
+        CHECK(e->Time() >= last);
+        last = e->Time();
+        delete e;
+        ++n;
+    }
+
+    CHECK(n == 40);
+    CHECK(w.Size() == 960);
+
+    // Adding something already due makes it ready right away.
+    w.Add(new TestElement(1005.0));
+    REQUIRE(w.Top());
+    CHECK(w.Top()->Time() == 1005.0);
+    delete w.Remove();
+}
+
+TEST_CASE("timer wheel removal") {
+    TimerWheel w(1.0);
+
+    std::vector<TestElement*> elems;
+    for ( int i = 0; i < 100; ++i ) {
+        elems.push_back(new TestElement(i * 37.0));
+        w.Add(elems.back());
+    }
+
+    w.Advance(100.0);
+
+    for ( int i = 0; i < 100; i += 2 ) {
+        CHECK(w.Remove(elems[i]) == elems[i]);
+        CHECK(w.Remove(elems[i]) == nullptr);
+        delete elems[i];
+    }
+
+    CHECK(w.Size() == 50);
+
+    for ( int i = 1; i < 100; i += 2 ) {
+        PQ_Element* e = w.Remove();
+        CHECK(e == elems[i]);
+        delete e;
+    }
+
+    CHECK(! w.NextTime());
+}
+
+TEST_CASE("timer wheel absorb") {
+    PriorityQueue pq;
+    pq.Add(new TestElement(3.0));
+    pq.Add(new TestElement(1.0));
+    pq.Add(new TestElement(2.0));
+
+    TimerWheel w(0.5);
+    w.Absorb(&pq);
+
+    CHECK(pq.Size() == 0);
+    CHECK(w.Size() == 3);
+    CHECK(w.CumulativeNum() == 3);
+
+    for ( double t : {1.0, 2.0, 3.0} ) {
+        PQ_Element* e = w.Remove();
+        CHECK(e->Time() == t);
+        delete e;
+    }
+}
+
+// Microbenchmark comparing the wheel against the binary heap.  It keeps a
+// given number of timers pending while simulating a minute of traffic in
+// 1 msec steps: expired timers get rescheduled, and a share of the
+// pending ones gets canceled and re-added, like connection inactivity
+// timers do.  Skipped by default; set ZEEK_TIMER_BENCHMARK_SIZES to a
+// comma-separated list of sizes (say, "1000000,10000000,50000000"), see
+// MicroBenchmark.h.
+
+namespace {
+
+class BenchElement : public PQ_Element {
+public:
+    explicit BenchElement(double t) : PQ_Element(t) {}
+    void SetTime(double t) { time = t; }
+};
+
+template<typename Queue, typename AdvanceFunc>
+void run_timer_benchmark(const char* name, Queue& q, size_t num, AdvanceFunc advance) {
+    constexpr double start = 1700000000.0;
+    constexpr double step = 0.001;
+    constexpr int steps = 60000;
+
+    std::mt19937_64 rng(42);
+    std::uniform_real_distribution<double> horizon(1.0, 300.0);
+
+    std::vector<BenchElement*> elems;
+    elems.reserve(num);
+
+    Stopwatch sw;
+
+    for ( size_t i = 0; i < num; ++i ) {
+        elems.push_back(new BenchElement(start + horizon(rng)));
+        q.Add(elems.back());
+    }
+
+    double fill = sw.Lap();
+
+    size_t cancels_per_step = std::max<size_t>(1, num / 10000);
+    uint64_t ops = 0;
+    double now = start;
+
+    for ( int i = 0; i < steps; ++i ) {
+        now += step;
+        advance(now);
+
+        while ( q.Top() && q.Top()->Time() <= now ) {
+            auto* e = static_cast<BenchElement*>(q.Remove());
+            e->SetTime(now + horizon(rng));
+            q.Add(e);
+            ops += 2;
+        }
+
+        for ( size_t j = 0; j < cancels_per_step; ++j ) {
+            auto* e = elems[rng() % num];
+            q.Remove(e);
+            e->SetTime(now + horizon(rng));
+            q.Add(e);
+            ops += 2;
+        }
+    }
+
+    double run = sw.Lap();
+
+    printf("%-6s %10zu timers: fill %.3fs (%.1f ns/add), churn %.3fs (%.1f ns/op, %" PRIu64 " ops)\n", name, num,
+           fill, fill * 1e9 / num, run, run * 1e9 / ops, ops);
+
+    // The queues delete whatever they still hold.
+}
+
+} // namespace
+
+TEST_CASE("timer wheel benchmark" * doctest::skip(true)) {
+    for ( auto n : benchmark_sizes("ZEEK_TIMER_BENCHMARK_SIZES", {100000}) ) {
+        {
+            PriorityQueue heap;
+            run_timer_benchmark("heap", heap, n, [](double) {});
+        }
+
+        {
+            TimerWheel wheel(0.001);
+            wheel.Advance(1700000000.0);
+            run_timer_benchmark("wheel", wheel, n, [&wheel](double t) { wheel.Advance(t); });
+        }
+    }
+}
+
+TEST_SUITE_END();
+
+} // namespace zeek::detail
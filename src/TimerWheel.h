@@ -0,0 +1,124 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "zeek/PriorityQueue.h"
+
+namespace zeek::detail {
+
+/**
+ * A hierarchical timing wheel holding PQ_Elements, as an alternative to
+ * the binary heap in PriorityQueue.  Adding and removing an element takes
+ * constant time regardless of how many elements are pending.
+ *
+ * Time is divided into ticks of a fixed resolution.  The wheel has
+ * LEVELS levels of SLOTS slots each; an element lives on the level of the
+ * highest base-SLOTS digit in which its tick differs from the wheel's
+ * current tick.  When the wheel advances, the slots it passes get
+ * cascaded down a level, and the elements of a tick that has been reached
+ * are moved as a batch into a small "ready" PriorityQueue.  The ready
+ * queue orders the elements of the current tick by their exact time, so
+ * elements still come out of the wheel in timestamp order.  Elements too
+ * far in the future for the top level go into an overflow heap.
+ */
+class TimerWheel {
+public:
+    /**
+     * Constructor.
+     *
+     * @param resolution the duration of one tick, in seconds.
+     */
+    explicit TimerWheel(double resolution);
+    ~TimerWheel();
+
+    /**
+     * Moves all elements of another queue into the wheel, taking over its
+     * statistics.  Leaves the other queue empty.
+     */
+    void Absorb(PriorityQueue* pq);
+
+    // Adds a new element.  Returns false on failure, true on success.
+    bool Add(PQ_Element* e);
+
+    // Removes element e.  Returns e, or nullptr if e wasn't in the wheel.
+    PQ_Element* Remove(PQ_Element* e);
+
+    // Advances the wheel to time t, making all elements with a time
+    // at or before t (and possibly some in the same tick after it)
+    // available through Top().
+    void Advance(double t);
+
+    // Returns the earliest element that the wheel has made ready, or
+    // nil if there's none.  Note that there may be later elements pending
+    // even if this returns nil; use NextTime() to find out.
+    PQ_Element* Top() const { return ready.Top(); }
+
+    // Removes (and returns) the earliest element, advancing the wheel
+    // as far as necessary to find it.  Returns nil if the wheel is empty.
+    PQ_Element* Remove();
+
+    // Returns a lower bound for the time of the earliest pending
+    // element, or no value if the wheel is empty.  The bound is exact
+    // if an element is ready, and otherwise at most one slot early.
+    std::optional<double> NextTime() const;
+
+    int Size() const { return size; }
+    int PeakSize() const { return peak_size; }
+    uint64_t CumulativeNum() const { return cumulative_num; }
+
+private:
+    static constexpr int SLOT_BITS = 6;
+    static constexpr int SLOTS = 1 << SLOT_BITS;
+    static constexpr int LEVELS = 6;
+
+    // Values for PQ_Element::Bucket().  Slot buckets follow FIRST_SLOT.
+    static constexpr uint16_t NO_BUCKET = 0;
+    static constexpr uint16_t READY_BUCKET = 1;
+    static constexpr uint16_t OVERFLOW_BUCKET = 2;
+    static constexpr uint16_t FIRST_SLOT = 3;
+
+    uint64_t TickOf(double t) const;
+
+    // Places an element according to the current tick.
+    void Place(PQ_Element* e, uint64_t tick);
+
+    // Moves the wheel's current tick forward to target.
+    void AdvanceTo(uint64_t target);
+
+    // Returns the earliest occupied level and slot, or false if there
+    // is none.
+    bool EarliestSlot(int* level, int* slot) const;
+
+    // Returns the first tick covered by the given slot.
+    uint64_t SlotStart(int level, int slot) const;
+
+    // Returns the first tick that holds pending elements not yet ready,
+    // or false if there is none.
+    bool NextTick(uint64_t* tick) const;
+
+    // Moves the elements of a slot to where they belong now.
+    void Cascade(int level, int slot);
+
+    // Moves elements from the overflow heap into the wheel once the
+    // wheel's range covers them.
+    void PullOverflow();
+
+    double resolution;
+    uint64_t cur_tick = 0;
+
+    std::vector<PQ_Element*> slots[LEVELS * SLOTS];
+    uint64_t occupied[LEVELS] = {0};
+
+    PriorityQueue ready;
+    PriorityQueue overflow;
+
+    int size = 0;
+    int peak_size = 0;
+    uint64_t cumulative_num = 0;
+};
+
+} // namespace zeek::detail
@@ -12,10 +12,13 @@
 #include <sys/param.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <map>
 #include <set>
+#include <string>
 
 #include "zeek/Attr.h"
 #include "zeek/CompHash.h"
@@ -1509,84 +1512,362 @@ static void find_nested_record_types(const TypePtr& t, std::set<RecordType*>* fo
     }
 }
 
+// Orders the entries of a table with expiration by the time of their
+// last relevant access, so that expiration only needs to visit the ones
+// that are due. Used if table_expire_indexed is set.
+//
+// The index holds a handle with a copy of each entry's hash key in a
+// bucket per second of access time. Accesses don't update the index:
+// when an entry's bucket comes due, expiration checks the entry's actual
+// access time and moves the handle along if there was an access since.
+// Handle ids must match the entry's expire_handle, so that the handles
+// of removed entries get dropped even if their index got inserted again.
+class detail::TableExpiryIndex {
+public:
+    struct Handle {
+        std::unique_ptr<detail::HashKey> key;
+        uint32_t id;
+    };
+
+    // Returns an id for a new handle. Zero marks entries without one.
+    uint32_t NextId() {
+        if ( ++last_id == 0 )
+            ++last_id;
+
+        return last_id;
+    }
+
+    void Add(Handle h, int access_time) { buckets[access_time].push_back(std::move(h)); }
+
+    // Removes a handle with an access time before the cutoff, returning
+    // false if there's none.
+    bool PopDue(double cutoff, Handle* h) {
+        while ( ! buckets.empty() ) {
+            auto it = buckets.begin();
+
+            if ( it->first >= cutoff )
+                return false;
+
+            if ( it->second.empty() ) {
+                buckets.erase(it);
+                continue;
+            }
+
+            *h = std::move(it->second.back());
+            it->second.pop_back();
+            return true;
+        }
+
+        return false;
+    }
+
+private:
+    std::map<int, std::vector<Handle>> buckets;
+    uint32_t last_id = 0;
+};
+
 // Support class for returning multiple values from a table[pattern]
 // when indexed with a string.
+//
+// The patterns get compiled into disjunctive matchers, so that a lookup
+// takes one pass over the string per matcher. To keep single insertions
+// and deletions from recompiling all patterns, they're spread across
+// segments in the manner of a binomial heap: new patterns go into a small
+// tail segment, which gets sealed once full. Sealed segments of similar
+// size then get merged, so there are only logarithmically many of them,
+// and each pattern only gets recompiled a logarithmic number of times.
+// Deleting from a sealed segment merely marks the entry until enough of
+// them are gone to warrant compacting the segment.
 class detail::TablePatternMatcher {
 public:
     TablePatternMatcher(const TableVal* _tbl, TypePtr _yield) : tbl(_tbl) {
         vtype = make_intrusive<VectorType>(std::move(_yield));
     }
 
-    void Clear() { matcher.reset(); }
+    // Forgets about all patterns. They get picked up from the table
+    // again when next needed.
+    void Clear();
+
+    // Tracks the assignment of a value to an index.
+    void Insert(const detail::HashKey& k, ValPtr yield);
+
+    // Tracks the removal of an index.
+    void Remove(const detail::HashKey& k);
 
     VectorValPtr Lookup(const StringValPtr& s);
 
-    // Delegate to matcher->MatchAll().
+    // Returns true if any of the patterns matches all of s.
     bool MatchAll(const StringValPtr& s);
 
-    void GetStats(detail::DFA_State_Cache_Stats* stats) const {
-        if ( matcher && matcher->DFA() )
-            matcher->DFA()->Cache()->GetStats(stats);
-        else
-            *stats = {0};
-    };
+    void GetStats(detail::DFA_State_Cache_Stats* stats) const;
 
 private:
+    // New patterns accumulate in the tail until it has this many.
+    static constexpr size_t TAIL_SIZE = 32;
+
+    struct Entry {
+        std::unique_ptr<detail::HashKey> key; // Null once removed.
+        ValPtr yield;
+    };
+
+    struct Segment {
+        size_t NumLive() const { return entries.size() - num_removed; }
+
+        // Entry i corresponds to the matcher's accept index i + 1.
+        std::vector<Entry> entries;
+        size_t num_removed = 0;
+
+        // If matcher is nil then we know we need to build it. This gives
+        // us an easy way to cache matchers in the common case that these
+        // sorts of tables don't change their elements very often, and
+        // also keeps us from having to re-build the matcher on every
+        // insert/delete in the common case that a whole bunch of those
+        // are done in a single batch.
+        std::unique_ptr<detail::Specific_RE_Matcher> matcher;
+    };
+
+    static std::string KeyString(const detail::HashKey& k) {
+        return {static_cast<const char*>(k.Key()), k.Size()};
+    }
+
+    // Fills the segments with the table's contents.
     void Build();
 
+    // Compiles the segment's matcher if needed.
+    void Compile(Segment* seg);
+
+    // Calls f(const Entry&) for each entry whose pattern matches all of s.
+    template<typename F>
+    void ForEachMatch(const StringValPtr& s, F f);
+
+    // Turns the tail into a sealed segment.
+    void Seal();
+
+    // Drops the segment's removed entries.
+    void Compact(Segment* seg);
+
+    void UpdateLocations(Segment* seg, size_t first = 0);
+
     const TableVal* tbl;
     VectorTypePtr vtype;
 
-    // If matcher is nil then we know we need to build it. This gives
-    // us an easy way to cache matchers in the common case that these
-    // sorts of tables don't change their elements very often (indeed,
-    // they'll frequently be constructed just once), and also keeps us
-    // from having to re-build the matcher on every insert/delete in
-    // the common case that a whole bunch of those are done in a single
-    // batch.
-    std::unique_ptr<detail::Specific_RE_Matcher> matcher = nullptr;
-
-    // Maps matcher values to corresponding yields. When building the
-    // matcher we insert a nil at the head to accommodate how
-    // disjunctive matchers use numbering starting at 1 rather than 0.
-    std::vector<ValPtr> matcher_yields;
+    // Sealed segments, from largest to smallest.
+    std::vector<std::unique_ptr<Segment>> segments;
+    Segment tail;
+
+    // Maps the bytes of each index's hash key to the segment and position
+    // of its entry.
+    std::unordered_map<std::string, std::pair<Segment*, size_t>> locations;
+
+    // False if the segments don't reflect the table's contents yet, which
+    // is the case for new tables as well as after Clear(). Lookups then
+    // rebuild them first.
+    bool built = false;
 };
 
-VectorValPtr detail::TablePatternMatcher::Lookup(const StringValPtr& s) {
-    auto results = make_intrusive<VectorVal>(vtype);
+void detail::TablePatternMatcher::Clear() {
+    segments.clear();
+    tail.entries.clear();
+    tail.matcher.reset();
+    locations.clear();
+    built = false;
+}
 
-    if ( ! matcher ) {
-        if ( tbl->Get()->Length() == 0 )
-            return results;
+void detail::TablePatternMatcher::Insert(const detail::HashKey& k, ValPtr yield) {
+    if ( ! built )
+        return;
 
-        Build();
+    auto key = KeyString(k);
+
+    if ( auto it = locations.find(key); it != locations.end() ) {
+        // Same pattern, so the matchers remain valid.
+        auto [seg, idx] = it->second;
+        seg->entries[idx].yield = std::move(yield);
+        return;
     }
 
+    locations[key] = {&tail, tail.entries.size()};
+    tail.entries.push_back({std::make_unique<detail::HashKey>(k.Key(), k.Size(), k.Hash()), std::move(yield)});
+    tail.matcher.reset();
+
+    if ( tail.entries.size() >= TAIL_SIZE )
+        Seal();
+}
+
+void detail::TablePatternMatcher::Remove(const detail::HashKey& k) {
+    if ( ! built )
+        return;
+
+    auto it = locations.find(KeyString(k));
+    if ( it == locations.end() )
+        return;
+
+    auto [seg, idx] = it->second;
+    locations.erase(it);
+
+    if ( seg == &tail ) {
+        // The tail is small and gets recompiled anyway.
+        tail.entries.erase(tail.entries.begin() + idx);
+        tail.matcher.reset();
+        UpdateLocations(&tail, idx);
+        return;
+    }
+
+    seg->entries[idx].key.reset();
+    seg->entries[idx].yield = nullptr;
+    ++seg->num_removed;
+
+    if ( seg->num_removed > seg->NumLive() )
+        Compact(seg);
+}
+
+void detail::TablePatternMatcher::Seal() {
+    auto seg = std::make_unique<Segment>();
+    seg->entries = std::move(tail.entries);
+    tail.entries.clear();
+    tail.matcher.reset();
+
+    UpdateLocations(seg.get());
+    segments.push_back(std::move(seg));
+
+    // Merge the newest segments while they're no larger than the ones
+    // before them.
+    while ( segments.size() > 1 ) {
+        auto& prev = segments[segments.size() - 2];
+        auto& last = segments.back();
+
+        if ( prev->NumLive() > last->NumLive() )
+            break;
+
+        Compact(prev.get());
+        size_t first = prev->entries.size();
+
+        for ( auto& e : last->entries ) {
+            if ( e.key )
+                prev->entries.push_back(std::move(e));
+        }
+
+        prev->matcher.reset();
+        UpdateLocations(prev.get(), first);
+        segments.pop_back();
+    }
+}
+
+void detail::TablePatternMatcher::Compact(Segment* seg) {
+    if ( seg->num_removed == 0 )
+        return;
+
+    auto& entries = seg->entries;
+    entries.erase(std::remove_if(entries.begin(), entries.end(), [](const Entry& e) { return ! e.key; }),
+                  entries.end());
+    seg->num_removed = 0;
+    seg->matcher.reset();
+
+    if ( entries.empty() ) {
+        auto it = std::find_if(segments.begin(), segments.end(), [seg](const auto& s) { return s.get() == seg; });
+        segments.erase(it);
+        return;
+    }
+
+    UpdateLocations(seg);
+}
+
+void detail::TablePatternMatcher::UpdateLocations(Segment* seg, size_t first) {
+    for ( size_t i = first; i < seg->entries.size(); ++i ) {
+        if ( const auto& k = seg->entries[i].key )
+            locations[KeyString(*k)] = {seg, i};
+    }
+}
+
+template<typename F>
+void detail::TablePatternMatcher::ForEachMatch(const StringValPtr& s, F f) {
+    if ( ! built )
+        Build();
+
     std::vector<AcceptIdx> matches;
-    matcher->MatchSet(s->AsString(), matches);
 
-    for ( auto m : matches )
-        results->Append(matcher_yields[m]);
+    auto match_segment = [&](Segment* seg) {
+        Compile(seg);
+
+        if ( ! seg->matcher )
+            return;
+
+        matches.clear();
+        seg->matcher->MatchSet(s->AsString(), matches);
+
+        for ( auto m : matches ) {
+            const auto& e = seg->entries[m - 1];
+
+            if ( e.key )
+                f(e);
+        }
+    };
+
+    for ( auto& seg : segments )
+        match_segment(seg.get());
+
+    match_segment(&tail);
+}
+
+VectorValPtr detail::TablePatternMatcher::Lookup(const StringValPtr& s) {
+    auto results = make_intrusive<VectorVal>(vtype);
+
+    if ( tbl->Get()->Length() == 0 )
+        return results;
+
+    ForEachMatch(s, [&results](const Entry& e) { results->Append(e.yield); });
 
     return results;
 }
 
 bool detail::TablePatternMatcher::MatchAll(const StringValPtr& s) {
-    if ( ! matcher ) {
-        if ( tbl->Get()->Length() == 0 )
-            return false;
+    if ( tbl->Get()->Length() == 0 )
+        return false;
 
+    if ( ! built )
         Build();
+
+    std::vector<AcceptIdx> matches;
+
+    auto match_segment = [&](Segment* seg) {
+        Compile(seg);
+
+        if ( ! seg->matcher )
+            return false;
+
+        // Without removed entries, any accepting state will do.
+        if ( seg->num_removed == 0 )
+            return seg->matcher->MatchAll(s->AsString());
+
+        matches.clear();
+        seg->matcher->MatchSet(s->AsString(), matches);
+
+        return std::any_of(matches.begin(), matches.end(),
+                           [seg](auto m) { return seg->entries[m - 1].key != nullptr; });
+    };
+
+    for ( auto& seg : segments ) {
+        if ( match_segment(seg.get()) )
+            return true;
     }
 
-    return matcher->MatchAll(s->AsString());
+    return match_segment(&tail);
 }
 
 void detail::TablePatternMatcher::Build() {
-    matcher_yields.clear();
-    matcher_yields.push_back(nullptr);
+    Clear();
+    built = true;
+
+    for ( auto& iter : *tbl->Get() ) {
+        auto k = iter.GetHashKey();
+        Insert(*k, iter.value->GetVal());
+    }
+}
+
+void detail::TablePatternMatcher::Compile(Segment* seg) {
+    if ( seg->matcher || seg->NumLive() == 0 )
+        return;
 
-    auto& tbl_dict = *tbl->Get();
     auto& tbl_hash = *tbl->GetTableHash();
 
     zeek::detail::string_list pattern_list;
@@ -1596,25 +1877,51 @@ void detail::TablePatternMatcher::Build() {
     // get lost once a loop iteration goes out of scope.
     std::vector<ListValPtr> hash_key_vals;
 
-    for ( auto& iter : tbl_dict ) {
-        auto k = iter.GetHashKey();
-        auto v = iter.value;
+    for ( size_t i = 0; i < seg->entries.size(); ++i ) {
+        const auto& k = seg->entries[i].key;
+        if ( ! k )
+            continue;
+
         auto vl = tbl_hash.RecoverVals(*k);
 
         char* pt = const_cast<char*>(vl->AsListVal()->Idx(0)->AsPattern()->PatternText());
         pattern_list.push_back(pt);
-        index_list.push_back(pattern_list.size());
-        matcher_yields.push_back(v->GetVal());
+        index_list.push_back(i + 1);
 
         hash_key_vals.push_back(std::move(vl));
     }
 
-    matcher = std::make_unique<detail::Specific_RE_Matcher>(detail::MATCH_EXACTLY);
+    seg->matcher = std::make_unique<detail::Specific_RE_Matcher>(detail::MATCH_EXACTLY);
 
-    if ( ! matcher->CompileSet(pattern_list, index_list) )
+    if ( ! seg->matcher->CompileSet(pattern_list, index_list) )
         reporter->FatalError("failed compile set for disjunctive matching");
 }
 
+void detail::TablePatternMatcher::GetStats(detail::DFA_State_Cache_Stats* stats) const {
+    *stats = {0};
+
+    auto add = [stats](const Segment& seg) {
+        if ( ! seg.matcher || ! seg.matcher->DFA() )
+            return;
+
+        detail::DFA_State_Cache_Stats s;
+        seg.matcher->DFA()->Cache()->GetStats(&s);
+
+        stats->nfa_states += s.nfa_states;
+        stats->dfa_states += s.dfa_states;
+        stats->computed += s.computed;
+        stats->uncomputed += s.uncomputed;
+        stats->mem += s.mem;
+        stats->hits += s.hits;
+        stats->misses += s.misses;
+    };
+
+    for ( const auto& seg : segments )
+        add(*seg);
+
+    add(tail);
+}
+
 TableVal::TableVal(TableTypePtr t, detail::AttributesPtr a) : Val(t) {
     bool ordered = (a != nullptr && a->Find(detail::ATTR_ORDERED) != nullptr);
     Init(std::move(t), ordered);
@@ -1661,15 +1968,16 @@ TableVal::~TableVal() {
     if ( timer )
         detail::timer_mgr->Cancel(timer);
 
-    delete table_val;
+    ReleaseEntries();
     delete expire_iterator;
 }
 
 void TableVal::RemoveAll() {
     delete expire_iterator;
     expire_iterator = nullptr;
+    expire_index = nullptr;
     // Here we take the brute force approach.
-    delete table_val;
+    ReleaseEntries();
     table_val = new PDict<TableEntryVal>;
     table_val->SetDeleteFunc(table_entry_val_delete_func);
 
@@ -1695,6 +2003,9 @@ int TableVal::RecursiveSize() const {
 }
 
 void TableVal::SetAttrs(detail::AttributesPtr a) {
+    // Expiration updates entries in place.
+    Unshare();
+
     attrs = std::move(a);
 
     if ( ! attrs )
@@ -1769,6 +2080,8 @@ bool TableVal::Assign(ValPtr index, std::unique_ptr<detail::HashKey> k, ValPtr n
     if ( is_set == (bool)new_val )
         InternalWarning("bad set/table in TableVal::Assign");
 
+    Unshare();
+
     TableEntryVal* new_entry_val = new TableEntryVal(std::move(new_val));
     detail::HashKey k_copy(k->Key(), k->Size(), k->Hash());
     TableEntryVal* old_entry_val = table_val->Insert(k.get(), new_entry_val, iterators_invalidated);
@@ -1788,12 +2101,17 @@ bool TableVal::Assign(ValPtr index, std::unique_ptr<detail::HashKey> k, ValPtr n
     }
 
     if ( pattern_matcher )
-        pattern_matcher->Clear();
+        pattern_matcher->Insert(k_copy, new_entry_val->GetVal());
 
     // Keep old expiration time if necessary.
     if ( old_entry_val && attrs && attrs->Find(detail::ATTR_EXPIRE_CREATE) )
         new_entry_val->SetExpireAccess(old_entry_val->ExpireAccessTime());
 
+    if ( old_entry_val )
+        new_entry_val->expire_handle = old_entry_val->expire_handle;
+    else if ( expire_index )
+        IndexForExpiry(k_copy, new_entry_val);
+
     Modified();
 
     if ( change_func || (broker_forward && ! broker_store.empty()) ) {
@@ -2150,6 +2468,8 @@ void TableVal::GetPatternMatcherStats(detail::DFA_State_Cache_Stats* stats) cons
 }
 
 bool TableVal::UpdateTimestamp(Val* index) {
+    Unshare();
+
     TableEntryVal* v;
 
     if ( subnets )
@@ -2321,6 +2641,9 @@ void TableVal::SendToStore(const Val* index, const TableEntryVal* new_entry_val,
 ValPtr TableVal::Remove(const Val& index, bool broker_forward, bool* iterators_invalidated) {
     auto k = MakeHashKey(index);
 
+    if ( k && table_val_refs && table_val->Lookup(k.get()) )
+        Unshare();
+
     TableEntryVal* v = k ? table_val->RemoveEntry(k.get(), iterators_invalidated) : nullptr;
     ValPtr va;
 
@@ -2333,8 +2656,8 @@ ValPtr TableVal::Remove(const Val& index, bool broker_forward, bool* iterators_i
         // non-existent table elements.
         reporter->InternalWarning("index not in prefix table");
 
-    if ( pattern_matcher )
-        pattern_matcher->Clear();
+    if ( pattern_matcher && v )
+        pattern_matcher->Remove(*k);
 
     delete v;
 
@@ -2353,6 +2676,9 @@ ValPtr TableVal::Remove(const Val& index, bool broker_forward, bool* iterators_i
 }
 
 ValPtr TableVal::Remove(const detail::HashKey& k, bool* iterators_invalidated) {
+    if ( table_val_refs && table_val->Lookup(&k) )
+        Unshare();
+
     TableEntryVal* v = table_val->RemoveEntry(k, iterators_invalidated);
     ValPtr va;
 
@@ -2366,6 +2692,9 @@ ValPtr TableVal::Remove(const detail::HashKey& k, bool* iterators_invalidated) {
             reporter->InternalWarning("index not in prefix table");
     }
 
+    if ( pattern_matcher && v )
+        pattern_matcher->Remove(k);
+
     delete v;
 
     Modified();
@@ -2571,6 +2900,11 @@ void TableVal::DoExpire(double t) {
     if ( ! type )
         return; // FIX ME ###
 
+    if ( zeek::detail::table_expire_indexed ) {
+        DoIndexedExpire(t);
+        return;
+    }
+
     double timeout = GetExpireTime();
 
     if ( timeout < 0 )
@@ -2626,22 +2960,7 @@ void TableVal::DoExpire(double t) {
                 }
             }
 
-            if ( subnets ) {
-                if ( ! idx )
-                    idx = RecreateIndex(*k);
-                if ( ! subnets->Remove(idx.get()) )
-                    reporter->InternalWarning("index not in prefix table");
-            }
-
-            table_val->RemoveEntry(k.get());
-            if ( change_func ) {
-                if ( ! idx )
-                    idx = RecreateIndex(*k);
-
-                CallChangeFunc(idx, v->GetVal(), ELEMENT_EXPIRED);
-            }
-
-            delete v;
+            RemoveExpired(*k, v, std::move(idx));
             modified = true;
         }
     }
@@ -2658,6 +2977,125 @@ void TableVal::DoExpire(double t) {
         InitTimer(zeek::detail::table_expire_delay);
 }
 
+void TableVal::DoIndexedExpire(double t) {
+    double timeout = GetExpireTime();
+
+    if ( timeout < 0 )
+        return;
+
+    if ( ! expire_index ) {
+        expire_index = std::make_unique<detail::TableExpiryIndex>();
+
+        for ( const auto& tble : *table_val ) {
+            auto k = tble.GetHashKey();
+            IndexForExpiry(*k, tble.value);
+        }
+    }
+
+    // Entries whose access time, in seconds since Zeek's start, lies
+    // before this are due.
+    double cutoff = t - timeout - run_state::zeek_start_network_time;
+
+    // Entries that can't expire yet, to go back into the index once done.
+    // Adding them right away could make PopDue() return them again in this
+    // round: access times have a granularity of whole seconds, so a new
+    // time can still fall below the cutoff.
+    std::vector<std::pair<detail::TableExpiryIndex::Handle, int>> deferred;
+
+    bool modified = false;
+    detail::TableExpiryIndex::Handle h;
+    int i = 0;
+
+    for ( ; i < zeek::detail::table_incremental_step && expire_index->PopDue(cutoff, &h); ++i ) {
+        auto v = table_val->Lookup(h.key.get());
+
+        if ( ! v || v->expire_handle != h.id )
+            // Removed since, possibly added again with a new handle.
+            continue;
+
+        if ( v->ExpireAccessTime() == 0 ) {
+            // See DoExpire().
+            deferred.emplace_back(std::move(h), v->expire_access_time);
+            continue;
+        }
+
+        if ( v->ExpireAccessTime() + timeout >= t ) {
+            // Accessed since it got indexed.
+            deferred.emplace_back(std::move(h), v->expire_access_time);
+            continue;
+        }
+
+        ListValPtr idx = nullptr;
+
+        if ( expire_func ) {
+            idx = RecreateIndex(*h.key);
+            double secs = CallExpireFunc(idx);
+
+            // It's possible that the user-provided function modified or
+            // deleted the table value, so look it up again.
+            v = table_val->Lookup(h.key.get());
+
+            if ( ! expire_index )
+                // Entire table got dropped (e.g. clear_table() / RemoveAll())
+                break;
+
+            if ( ! v )
+                continue;
+
+            if ( secs > 0 ) {
+                // User doesn't want us to expire this now.
+                v->SetExpireAccess(run_state::network_time - timeout + secs);
+                deferred.emplace_back(std::move(h), v->expire_access_time);
+                continue;
+            }
+        }
+
+        RemoveExpired(*h.key, v, std::move(idx));
+        modified = true;
+    }
+
+    if ( expire_index ) {
+        for ( auto& [dh, access_time] : deferred )
+            expire_index->Add(std::move(dh), access_time);
+    }
+
+    if ( modified )
+        Modified();
+
+    if ( i < zeek::detail::table_incremental_step )
+        InitTimer(zeek::detail::table_expire_interval);
+    else
+        InitTimer(zeek::detail::table_expire_delay);
+}
+
+void TableVal::RemoveExpired(const detail::HashKey& k, TableEntryVal* v, ListValPtr idx) {
+    if ( subnets ) {
+        if ( ! idx )
+            idx = RecreateIndex(k);
+        if ( ! subnets->Remove(idx.get()) )
+            reporter->InternalWarning("index not in prefix table");
+    }
+
+    if ( pattern_matcher )
+        pattern_matcher->Remove(k);
+
+    table_val->RemoveEntry(&k);
+    if ( change_func ) {
+        if ( ! idx )
+            idx = RecreateIndex(k);
+
+        CallChangeFunc(idx, v->GetVal(), ELEMENT_EXPIRED);
+    }
+
+    delete v;
+}
+
+void TableVal::IndexForExpiry(const detail::HashKey& k, TableEntryVal* v) {
+    v->expire_handle = expire_index->NextId();
+    expire_index->Add({std::make_unique<detail::HashKey>(k.Key(), k.Size(), k.Hash()), v->expire_handle},
+                      v->expire_access_time);
+}
+
 double TableVal::GetExpireTime() {
     if ( ! expire_time )
         return -1;
@@ -2754,15 +3192,28 @@ ValPtr TableVal::DoClone(CloneState* state) {
     auto tv = make_intrusive<TableVal>(table_type, init_attrs);
     state->NewClone(this, tv);
 
-    for ( const auto& tble : *table_val ) {
-        auto key = tble.GetHashKey();
-        auto* val = tble.value;
-        TableEntryVal* nval = val->Clone(state);
-        tv->table_val->Insert(key.get(), nval);
+    if ( CanShareEntries() ) {
+        // The copy uses the same entries until either table changes.
+        if ( ! table_val_refs )
+            table_val_refs = new int(1);
+
+        ++*table_val_refs;
+        tv->ReleaseEntries();
+        tv->table_val = table_val;
+        tv->table_val_refs = table_val_refs;
+    }
+
+    else {
+        for ( const auto& tble : *table_val ) {
+            auto key = tble.GetHashKey();
+            auto* val = tble.value;
+            TableEntryVal* nval = val->Clone(state);
+            tv->table_val->Insert(key.get(), nval);
 
-        if ( subnets ) {
-            auto idx = RecreateIndex(*key);
-            tv->subnets->Insert(idx.get(), nval);
+            if ( subnets ) {
+                auto idx = RecreateIndex(*key);
+                tv->subnets->Insert(idx.get(), nval);
+            }
         }
     }
 
@@ -2789,6 +3240,61 @@ ValPtr TableVal::DoClone(CloneState* state) {
     return tv;
 }
 
+bool TableVal::CanShareEntries() const {
+    // Tables with additional indices into their entries, or with expiration,
+    // update their entries in ways the copies must not see.
+    if ( subnets || pattern_matcher || expire_time )
+        return false;
+
+    // A loop may be iterating over the entries and modifying the table,
+    // which would move it to fresh entries and leave the iterator behind.
+    if ( table_val->NumIterators() > 0 )
+        return false;
+
+    // Copying needs to clone any aggregate values.
+    return table_type->IsSet() || is_atomic_type(table_type->Yield());
+}
+
+void TableVal::DoUnshare() {
+    if ( --*table_val_refs == 0 ) {
+        // The copies are gone, so the entries are all ours.
+        delete table_val_refs;
+        table_val_refs = nullptr;
+        return;
+    }
+
+    table_val_refs = nullptr;
+
+    const auto* shared = table_val;
+    table_val = new PDict<TableEntryVal>(shared->IsOrdered() ? DictOrder::ORDERED : DictOrder::UNORDERED);
+    table_val->SetDeleteFunc(table_entry_val_delete_func);
+
+    for ( const auto& tble : *shared ) {
+        auto key = tble.GetHashKey();
+        auto* nval = new TableEntryVal(tble.value->GetVal());
+        nval->expire_access_time = tble.value->expire_access_time;
+        table_val->Insert(key.get(), nval);
+    }
+}
+
+void TableVal::ReleaseEntries() {
+    if ( table_val_refs ) {
+        bool last = --*table_val_refs == 0;
+        if ( last )
+            delete table_val_refs;
+
+        table_val_refs = nullptr;
+
+        if ( ! last ) {
+            table_val = nullptr;
+            return;
+        }
+    }
+
+    delete table_val;
+    table_val = nullptr;
+}
+
 unsigned int TableVal::ComputeFootprint(std::unordered_set<const Val*>* analyzed_vals) const {
     unsigned int fp = table_val->Length();
 
@@ -3635,6 +4141,18 @@ ValPtr VectorVal::DoClone(CloneState* state) {
     vv->Reserve(vector_val.size());
     state->NewClone(this, vv);
 
+    if ( ! any_yield && is_atomic_type(yield_type) ) {
+        // Atomic values don't change, so the copy can refer to the same ones.
+        vv->vector_val = vector_val;
+
+        if ( managed_yield )
+            for ( auto& elem : vv->vector_val )
+                if ( elem )
+                    Ref(elem->ManagedVal());
+
+        return vv;
+    }
+
     int n = vector_val.size();
 
     for ( auto i = 0; i < n; ++i ) {
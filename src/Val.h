@@ -51,6 +51,7 @@ class Frame;
 class PrefixTable;
 class HashKey;
 class TablePatternMatcher;
+class TableExpiryIndex;
 
 struct DFA_State_Cache_Stats;
 
@@ -731,6 +732,9 @@ protected:
     // to save a few bytes, as we do not need a high resolution for these
     // anyway.
     int expire_access_time;
+
+    // Identifies the entry's handle in the table's expiry index, if any.
+    uint32_t expire_handle = 0;
 };
 
 class TableValTimer final : public detail::Timer {
@@ -955,6 +959,14 @@ public:
 
     const PDict<TableEntryVal>* Get() const { return table_val; }
 
+    // Returns the table's entries for a loop whose body may modify the
+    // table. The table first stops sharing them with any copies, so they
+    // remain its own for as long as the loop iterates over them.
+    const PDict<TableEntryVal>* GetForIteration() {
+        Unshare();
+        return table_val;
+    }
+
     const detail::CompositeHash* GetTableHash() const { return table_type->GetTableHash(); }
 
     // Returns the size of the table.
@@ -971,6 +983,7 @@ public:
 
     void InitTimer(double delay);
     void DoExpire(double t);
+    void DoIndexedExpire(double t);
 
     // If the &default attribute is not a function, or the function has
     // already been initialized, this does nothing. Otherwise, evaluates
@@ -1054,6 +1067,28 @@ protected:
     // Calls &expire_func and returns its return interval;
     double CallExpireFunc(ListValPtr idx);
 
+    // Removes an entry that expired. idx may be nil.
+    void RemoveExpired(const detail::HashKey& k, TableEntryVal* v, ListValPtr idx);
+
+    // Adds an entry to the expiry index.
+    void IndexForExpiry(const detail::HashKey& k, TableEntryVal* v);
+
+    // Returns true if copies of this table may share its entries until
+    // one of them gets modified.
+    bool CanShareEntries() const;
+
+    // Gives the table entries of its own if it shares them with copies.
+    // Needs calling before anything modifies the entries.
+    void Unshare() {
+        if ( table_val_refs )
+            DoUnshare();
+    }
+
+    void DoUnshare();
+
+    // Drops the table's entries, deleting them unless copies still use them.
+    void ReleaseEntries();
+
     // Enum for the different kinds of changes an &on_change handler can see
     enum OnChangeType { ELEMENT_NEW, ELEMENT_CHANGED, ELEMENT_REMOVED, ELEMENT_EXPIRED };
 
@@ -1073,6 +1108,7 @@ protected:
     detail::ExprPtr expire_func;
     TableValTimer* timer;
     RobustDictIterator<TableEntryVal>* expire_iterator;
+    std::unique_ptr<detail::TableExpiryIndex> expire_index; // With table_expire_indexed.
     std::unique_ptr<detail::PrefixTable> subnets;
     std::unique_ptr<detail::TablePatternMatcher> pattern_matcher;
     ValPtr def_val;
@@ -1086,6 +1122,10 @@ protected:
 
 private:
     PDict<TableEntryVal>* table_val;
+
+    // Non-nil while table_val is shared with copies of this table, counting
+    // the tables that use it.
+    int* table_val_refs = nullptr;
 };
 
 // This would be way easier with is_convertible_v, but sadly that won't
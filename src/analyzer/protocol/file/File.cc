@@ -25,19 +25,13 @@ void File_Analyzer::DeliverStream(int len, const u_char* data, bool orig) {
             Identify();
     }
 
-    if ( orig )
-        file_id_orig = file_mgr->DataIn(data, len, GetAnalyzerTag(), Conn(), orig, file_id_orig);
-    else
-        file_id_resp = file_mgr->DataIn(data, len, GetAnalyzerTag(), Conn(), orig, file_id_resp);
+    file_mgr->DataIn(data, len, GetAnalyzerTag(), Conn(), orig, orig ? file_ref_orig : file_ref_resp);
 }
 
 void File_Analyzer::Undelivered(uint64_t seq, int len, bool orig) {
     TCP_ApplicationAnalyzer::Undelivered(seq, len, orig);
 
-    if ( orig )
-        file_id_orig = file_mgr->Gap(seq, len, GetAnalyzerTag(), Conn(), orig, file_id_orig);
-    else
-        file_id_resp = file_mgr->Gap(seq, len, GetAnalyzerTag(), Conn(), orig, file_id_resp);
+    file_mgr->Gap(seq, len, GetAnalyzerTag(), Conn(), orig, orig ? file_ref_orig : file_ref_resp);
 }
 
 void File_Analyzer::Done() {
@@ -46,13 +40,13 @@ void File_Analyzer::Done() {
     if ( buffer_len && buffer_len != BUFFER_SIZE )
         Identify();
 
-    if ( ! file_id_orig.empty() )
-        file_mgr->EndOfFile(file_id_orig);
+    if ( file_ref_orig )
+        file_mgr->EndOfFile(file_ref_orig);
     else
         file_mgr->EndOfFile(GetAnalyzerTag(), Conn(), true);
 
-    if ( ! file_id_resp.empty() )
-        file_mgr->EndOfFile(file_id_resp);
+    if ( file_ref_resp )
+        file_mgr->EndOfFile(file_ref_resp);
     else
         file_mgr->EndOfFile(GetAnalyzerTag(), Conn(), false);
 }
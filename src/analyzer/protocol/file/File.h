@@ -5,6 +5,7 @@
 #include <string>
 
 #include "zeek/analyzer/protocol/tcp/TCP.h"
+#include "zeek/file_analysis/FileKey.h"
 
 namespace zeek::analyzer::file {
 
@@ -27,8 +28,8 @@ protected:
     static const int BUFFER_SIZE = 1024;
     char buffer[BUFFER_SIZE] = {0};
     int buffer_len = 0;
-    std::string file_id_orig;
-    std::string file_id_resp;
+    file_analysis::FileRef file_ref_orig;
+    file_analysis::FileRef file_ref_resp;
 };
 
 class FTP_Data : public File_Analyzer {
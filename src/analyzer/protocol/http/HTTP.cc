@@ -227,16 +227,14 @@ bool HTTP_Entity::Undelivered(int64_t len) {
         return false;
 
     if ( is_partial_content ) {
-        precomputed_file_id =
-            file_mgr->Gap(body_length, len, http_message->MyHTTP_Analyzer()->GetAnalyzerTag(),
-                          http_message->MyHTTP_Analyzer()->Conn(), http_message->IsOrig(), precomputed_file_id);
+        file_mgr->Gap(body_length, len, http_message->MyHTTP_Analyzer()->GetAnalyzerTag(),
+                      http_message->MyHTTP_Analyzer()->Conn(), http_message->IsOrig(), file_ref);
 
         offset += len;
     }
     else
-        precomputed_file_id =
-            file_mgr->Gap(body_length, len, http_message->MyHTTP_Analyzer()->GetAnalyzerTag(),
-                          http_message->MyHTTP_Analyzer()->Conn(), http_message->IsOrig(), precomputed_file_id);
+        file_mgr->Gap(body_length, len, http_message->MyHTTP_Analyzer()->GetAnalyzerTag(),
+                      http_message->MyHTTP_Analyzer()->Conn(), http_message->IsOrig(), file_ref);
 
     if ( chunked_transfer_state != NON_CHUNKED_TRANSFER ) {
         if ( chunked_transfer_state == EXPECT_CHUNK_DATA && expect_data_length >= len ) {
@@ -283,27 +281,22 @@ void HTTP_Entity::SubmitData(int len, const char* buf) {
 
     if ( is_partial_content ) {
         if ( send_size && instance_length > 0 )
-            precomputed_file_id =
-                file_mgr->SetSize(instance_length, http_message->MyHTTP_Analyzer()->GetAnalyzerTag(),
-                                  http_message->MyHTTP_Analyzer()->Conn(), http_message->IsOrig(), precomputed_file_id);
+            file_mgr->SetSize(instance_length, http_message->MyHTTP_Analyzer()->GetAnalyzerTag(),
+                              http_message->MyHTTP_Analyzer()->Conn(), http_message->IsOrig(), file_ref);
 
-        precomputed_file_id =
-            file_mgr->DataIn(reinterpret_cast<const u_char*>(buf), len, offset,
-                             http_message->MyHTTP_Analyzer()->GetAnalyzerTag(), http_message->MyHTTP_Analyzer()->Conn(),
-                             http_message->IsOrig(), precomputed_file_id);
+        file_mgr->DataIn(reinterpret_cast<const u_char*>(buf), len, offset,
+                         http_message->MyHTTP_Analyzer()->GetAnalyzerTag(), http_message->MyHTTP_Analyzer()->Conn(),
+                         http_message->IsOrig(), file_ref);
 
         offset += len;
     }
     else {
         if ( send_size && content_length > 0 )
-            precomputed_file_id =
-                file_mgr->SetSize(content_length, http_message->MyHTTP_Analyzer()->GetAnalyzerTag(),
-                                  http_message->MyHTTP_Analyzer()->Conn(), http_message->IsOrig(), precomputed_file_id);
+            file_mgr->SetSize(content_length, http_message->MyHTTP_Analyzer()->GetAnalyzerTag(),
+                              http_message->MyHTTP_Analyzer()->Conn(), http_message->IsOrig(), file_ref);
 
-        precomputed_file_id =
-            file_mgr->DataIn(reinterpret_cast<const u_char*>(buf), len,
-                             http_message->MyHTTP_Analyzer()->GetAnalyzerTag(), http_message->MyHTTP_Analyzer()->Conn(),
-                             http_message->IsOrig(), precomputed_file_id);
+        file_mgr->DataIn(reinterpret_cast<const u_char*>(buf), len, http_message->MyHTTP_Analyzer()->GetAnalyzerTag(),
+                         http_message->MyHTTP_Analyzer()->Conn(), http_message->IsOrig(), file_ref);
     }
 
     send_size = false;
@@ -573,8 +566,8 @@ void HTTP_Message::Done(bool interrupted, const char* detail) {
         // multipart/byteranges may span multiple connections, so don't EOF.
         HTTP_Entity* he = dynamic_cast<HTTP_Entity*>(top_level);
 
-        if ( he && ! he->FileID().empty() )
-            file_mgr->EndOfFile(he->FileID());
+        if ( he && he->GetFileRef() )
+            file_mgr->EndOfFile(he->GetFileRef());
         else
             file_mgr->EndOfFile(MyHTTP_Analyzer()->GetAnalyzerTag(), MyHTTP_Analyzer()->Conn(), is_orig);
     }
@@ -634,8 +627,8 @@ void HTTP_Message::EndEntity(analyzer::mime::MIME_Entity* entity) {
     else if ( is_orig || MyHTTP_Analyzer()->HTTP_ReplyCode() != 206 ) {
         HTTP_Entity* he = dynamic_cast<HTTP_Entity*>(entity);
 
-        if ( he && ! he->FileID().empty() )
-            file_mgr->EndOfFile(he->FileID());
+        if ( he && he->GetFileRef() )
+            file_mgr->EndOfFile(he->GetFileRef());
         else
             file_mgr->EndOfFile(MyHTTP_Analyzer()->GetAnalyzerTag(), MyHTTP_Analyzer()->Conn(), is_orig);
     }
@@ -123,8 +123,7 @@ int fputs(data_chunk_t b, FILE* fp) {
 }
 
 void MIME_Mail::Undelivered(int len) {
-    cur_entity_id =
-        file_mgr->Gap(cur_entity_len, len, analyzer->GetAnalyzerTag(), analyzer->Conn(), is_orig, cur_entity_id);
+    file_mgr->Gap(cur_entity_len, len, analyzer->GetAnalyzerTag(), analyzer->Conn(), is_orig, cur_entity_ref);
 }
 
 bool istrequal(data_chunk_t s, const char* t) {
@@ -1206,7 +1205,7 @@ MIME_Mail::~MIME_Mail() {
 
 void MIME_Mail::BeginEntity(MIME_Entity* /* entity */) {
     cur_entity_len = 0;
-    cur_entity_id.clear();
+    cur_entity_ref.Clear();
 
     if ( mime_begin_entity )
         analyzer->EnqueueConnEvent(mime_begin_entity, analyzer->ConnVal());
@@ -1231,12 +1230,12 @@ void MIME_Mail::EndEntity(MIME_Entity* /* entity */) {
     if ( mime_end_entity )
         analyzer->EnqueueConnEvent(mime_end_entity, analyzer->ConnVal());
 
-    if ( ! cur_entity_id.empty() )
-        file_mgr->EndOfFile(cur_entity_id);
+    if ( cur_entity_ref )
+        file_mgr->EndOfFile(cur_entity_ref);
     else
         file_mgr->EndOfFile(analyzer->GetAnalyzerTag(), analyzer->Conn());
 
-    cur_entity_id.clear();
+    cur_entity_ref.Clear();
 }
 
 void MIME_Mail::SubmitHeader(MIME_Header* h) {
@@ -1277,8 +1276,8 @@ void MIME_Mail::SubmitData(int len, const char* buf) {
                                    make_intrusive<StringVal>(data_len, data));
     }
 
-    cur_entity_id = file_mgr->DataIn(reinterpret_cast<const u_char*>(buf), len, analyzer->GetAnalyzerTag(),
-                                     analyzer->Conn(), is_orig, cur_entity_id);
+    file_mgr->DataIn(reinterpret_cast<const u_char*>(buf), len, analyzer->GetAnalyzerTag(), analyzer->Conn(), is_orig,
+                     cur_entity_ref);
 
     cur_entity_len += len;
     buffer_start = (buf + len) - (char*)data_buffer->Bytes();
@@ -9,6 +9,7 @@
 #include "zeek/ZeekString.h"
 #include "zeek/analyzer/Analyzer.h"
 #include "zeek/digest.h"
+#include "zeek/file_analysis/FileKey.h"
 
 namespace zeek {
 
@@ -263,7 +264,7 @@ protected:
     String* data_buffer;
 
     uint64_t cur_entity_len;
-    std::string cur_entity_id;
+    file_analysis::FileRef cur_entity_ref;
 };
 
 extern bool is_null_data_chunk(data_chunk_t b);
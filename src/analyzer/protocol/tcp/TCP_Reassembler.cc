@@ -407,6 +407,16 @@ void TCP_Reassembler::Overlap(const u_char* b1, const u_char* b2, uint64_t n) {
     }
 }
 
+void TCP_Reassembler::Evict() {
+    tcp_analyzer->Weird("reassembly_memory_budget_exceeded");
+
+    // Delivers what's above holes and reports the holes as content gaps.
+    Reassembler::Evict();
+
+    // We might be done now.
+    CheckEOF();
+}
+
 void TCP_Reassembler::Deliver(uint64_t seq, int len, const u_char* data) {
     if ( type == Direct )
         dst_analyzer->NextStream(len, data, IsOrig());
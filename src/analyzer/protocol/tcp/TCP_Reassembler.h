@@ -95,6 +95,7 @@ private:
 
     void BlockInserted(DataBlockMap::const_iterator it) override;
     void Overlap(const u_char* b1, const u_char* b2, uint64_t n) override;
+    void Evict() override;
 
     TCP_Endpoint* endp;
 
@@ -5,6 +5,7 @@
 #include <broker/configuration.hh>
 #include <broker/zeek.hh>
 #include <unistd.h>
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
 #include <string>
@@ -266,6 +267,28 @@ void Manager::InitPostScript() {
     log_batch_size = get_option("Broker::log_batch_size")->AsCount();
     default_log_topic_prefix = get_option("Broker::default_log_topic_prefix")->AsString()->CheckString();
     log_topic_func = get_option("Broker::log_topic")->AsFunc();
+
+    auto to_event_batch_policy = [](const RecordVal* rv) {
+        EventBatchPolicy policy;
+        policy.max_events = rv->GetFieldOrDefault("max_events")->AsCount();
+        policy.max_delay = rv->GetFieldOrDefault("max_delay")->AsInterval();
+        return policy;
+    };
+
+    default_event_batch_policy =
+        to_event_batch_policy(get_option("Broker::default_event_batch_policy")->AsRecordVal());
+
+    for ( const auto& [idx, val] : get_option("Broker::event_batch_policies")->AsTableVal()->ToMap() ) {
+        auto prefix = idx->AsListVal()->Idx(0)->AsString()->CheckString();
+        event_batch_policies.emplace_back(prefix, to_event_batch_policy(val->AsRecordVal()));
+    }
+
+    // Longest prefix first, so that the first match is the most specific one.
+    std::sort(event_batch_policies.begin(), event_batch_policies.end(),
+              [](const auto& a, const auto& b) { return a.first.size() > b.first.size(); });
+
+    event_batching = default_event_batch_policy.max_events > 1 || ! event_batch_policies.empty();
+
     log_id_type = id::find_type("Log::ID")->AsEnumType();
     writer_id_type = id::find_type("Log::Writer")->AsEnumType();
     zeek_table_manager = get_option("Broker::table_store_master")->AsBool();
@@ -377,6 +400,23 @@ void Manager::InitPostScript() {
         telemetry_mgr->CounterInstance("zeek", "broker_incoming_ids", {}, "Total number of incoming ids via broker");
     num_ids_outgoing_metric =
         telemetry_mgr->CounterInstance("zeek", "broker_outgoing_ids", {}, "Total number of outgoing ids via broker");
+
+    event_batch_size_metric =
+        telemetry_mgr->HistogramInstance("zeek", "broker_event_batch_size", {},
+                                         {1.0, 2.0, 5.0, 10.0, 20.0, 50.0, 100.0, 200.0, 500.0, 1000.0},
+                                         "Number of events per batch sent via broker");
+    event_batch_latency_metric =
+        telemetry_mgr->HistogramInstance("zeek", "broker_event_batch_latency", {},
+                                         {0.0001, 0.0005, 0.001, 0.005, 0.01, 0.05, 0.1, 0.5, 1.0},
+                                         "Network time the oldest event of a batch sent via broker was held back",
+                                         "seconds");
+
+    auto event_batch_flushes_family =
+        telemetry_mgr->CounterFamily("zeek", "broker_event_batch_flushes", {"reason"},
+                                     "Number of event batches sent via broker, by what triggered sending them");
+    event_batch_flushes_size_metric = event_batch_flushes_family->GetOrAdd({{"reason", "size"}});
+    event_batch_flushes_delay_metric = event_batch_flushes_family->GetOrAdd({{"reason", "delay"}});
+    event_batch_flushes_forced_metric = event_batch_flushes_family->GetOrAdd({{"reason", "forced"}});
 }
 
 void Manager::InitializeBrokerStoreForwarding() {
@@ -415,6 +455,7 @@ void Manager::InitializeBrokerStoreForwarding() {
 }
 
 void Manager::Terminate() {
+    FlushEventBuffers();
     FlushLogBuffers();
 
     iosource_mgr->UnregisterFd(bstate->subscriber.fd(), this);
@@ -471,8 +512,10 @@ void Manager::FlushPendingQueries() {
 void Manager::ClearStores() {
     FlushPendingQueries();
 
-    for ( const auto& [name, handle] : data_stores )
+    for ( const auto& [name, handle] : data_stores ) {
+        FlushTopicEventBuffers(name);
         handle->store.clear();
+    }
 }
 
 uint16_t Manager::Listen(const string& addr, uint16_t port, BrokerProtocol type) {
@@ -542,6 +585,7 @@ void Manager::Unpeer(const string& addr, uint16_t port) {
 
     DBG_LOG(DBG_BROKER, "Stopping to peer with %s:%" PRIu16, addr.c_str(), port);
 
+    FlushEventBuffers();
     FlushLogBuffers();
     bstate->endpoint.unpeer_nosync(addr, port);
 }
@@ -564,11 +608,118 @@ bool Manager::PublishEvent(string topic, std::string name, broker::vector args,
 
     DBG_LOG(DBG_BROKER, "Publishing event: %s", RenderEvent(topic, name, args).c_str());
     broker::zeek::Event ev(std::move(name), std::move(args), broker::to_timestamp(ts));
-    bstate->endpoint.publish(std::move(topic), ev.move_data());
-    num_events_outgoing_metric->Inc();
+
+    if ( ! event_batching ) {
+        bstate->endpoint.publish(std::move(topic), ev.move_data());
+        num_events_outgoing_metric->Inc();
+        return true;
+    }
+
+    auto it = event_buffers.find(topic);
+
+    if ( it == event_buffers.end() ) {
+        it = event_buffers.emplace(topic, EventBuffer{}).first;
+        it->second.policy = LookupEventBatchPolicy(topic);
+    }
+
+    auto& eb = it->second;
+
+    if ( eb.policy.max_events <= 1 ) {
+        bstate->endpoint.publish(std::move(topic), ev.move_data());
+        num_events_outgoing_metric->Inc();
+        return true;
+    }
+
+    if ( eb.message_count == 0 )
+        eb.first_network_time = run_state::network_time;
+
+    ++eb.message_count;
+    eb.msgs.add(std::move(ev));
+
+    if ( eb.message_count >= eb.policy.max_events )
+        FlushEventBuffer(it->first, eb, EventFlushReason::Size);
+
     return true;
 }
 
+const Manager::EventBatchPolicy& Manager::LookupEventBatchPolicy(const std::string& topic) const {
+    for ( const auto& [prefix, policy] : event_batch_policies ) {
+        if ( topic.compare(0, prefix.size(), prefix) == 0 )
+            return policy;
+    }
+
+    return default_event_batch_policy;
+}
+
+size_t Manager::EventBuffer::Flush(broker::endpoint& endpoint, const std::string& topic) {
+    if ( endpoint.is_shutdown() )
+        return 0;
+
+    if ( ! message_count )
+        // No events buffered for this topic.
+        return 0;
+
+    endpoint.publish(topic, msgs.build());
+
+    auto rval = message_count;
+    message_count = 0;
+    return rval;
+}
+
+size_t Manager::FlushEventBuffer(const std::string& topic, EventBuffer& eb, EventFlushReason reason) {
+    // Network time, like the max_delay check, so that the histogram shows
+    // how long max_delay actually held events back.
+    auto latency = run_state::network_time - eb.first_network_time;
+    auto n = eb.Flush(bstate->endpoint, topic);
+
+    if ( n == 0 )
+        return 0;
+
+    DBG_LOG(DBG_BROKER, "Flushed batch of %zu events for topic %s", n, topic.c_str());
+
+    num_events_outgoing_metric->Inc(static_cast<double>(n));
+    event_batch_size_metric->Observe(static_cast<double>(n));
+    event_batch_latency_metric->Observe(latency);
+
+    switch ( reason ) {
+        case EventFlushReason::Size: event_batch_flushes_size_metric->Inc(); break;
+        case EventFlushReason::Delay: event_batch_flushes_delay_metric->Inc(); break;
+        case EventFlushReason::Forced: event_batch_flushes_forced_metric->Inc(); break;
+    }
+
+    return n;
+}
+
+size_t Manager::FlushEventBuffers(bool force) {
+    size_t rval = 0;
+
+    for ( auto& [topic, eb] : event_buffers ) {
+        if ( ! eb.message_count )
+            continue;
+
+        if ( force )
+            rval += FlushEventBuffer(topic, eb, EventFlushReason::Forced);
+        else if ( run_state::network_time - eb.first_network_time >= eb.policy.max_delay )
+            rval += FlushEventBuffer(topic, eb, EventFlushReason::Delay);
+    }
+
+    return rval;
+}
+
+size_t Manager::FlushTopicEventBuffers(const std::string& topic) {
+    size_t rval = 0;
+
+    for ( auto& [t, eb] : event_buffers ) {
+        if ( ! eb.message_count || t.compare(0, topic.size(), topic) != 0 )
+            continue;
+
+        if ( t.size() == topic.size() || t[topic.size()] == '/' )
+            rval += FlushEventBuffer(t, eb, EventFlushReason::Forced);
+    }
+
+    return rval;
+}
+
 bool Manager::PublishEvent(string topic, RecordVal* args) {
     if ( bstate->endpoint.is_shutdown() )
         return true;
@@ -624,6 +775,7 @@ bool Manager::PublishIdentifier(std::string topic, std::string id) {
 
     broker::zeek::IdentifierUpdate msg(std::move(id), std::move(data.value_));
     DBG_LOG(DBG_BROKER, "Publishing id-update: %s", RenderMessage(topic, msg.as_data()).c_str());
+    FlushTopicEventBuffers(topic);
     bstate->endpoint.publish(std::move(topic), msg.move_data());
     num_ids_outgoing_metric->Inc();
     return true;
@@ -669,6 +821,7 @@ bool Manager::PublishLogCreate(EnumVal* stream, EnumVal* writer, const logging::
                                 std::move(fields_data));
 
     DBG_LOG(DBG_BROKER, "Publishing log creation: %s", RenderMessage(topic, msg.as_data()).c_str());
+    FlushTopicEventBuffers(topic);
 
     if ( peer.node != NoPeer.node )
         // Direct message.
@@ -753,6 +906,7 @@ bool Manager::PublishLogWrite(EnumVal* stream, EnumVal* writer, string path, int
     lb.msgs[topic].add(std::move(msg));
 
     if ( lb.message_count >= log_batch_size ) {
+        FlushLogTopicEventBuffers(lb);
         auto outgoing_logs = static_cast<double>(lb.Flush(bstate->endpoint, log_batch_size));
         num_logs_outgoing_metric->Inc(outgoing_logs);
     }
@@ -778,12 +932,24 @@ size_t Manager::LogBuffer::Flush(broker::endpoint& endpoint, size_t log_batch_si
     return rval;
 }
 
+void Manager::FlushLogTopicEventBuffers(LogBuffer& lb) {
+    if ( ! event_batching || ! lb.message_count )
+        return;
+
+    for ( auto& [topic, pending_batch] : lb.msgs ) {
+        if ( ! pending_batch.empty() )
+            FlushTopicEventBuffers(topic);
+    }
+}
+
 size_t Manager::FlushLogBuffers() {
     DBG_LOG(DBG_BROKER, "Flushing all log buffers");
     auto rval = 0u;
 
-    for ( auto& lb : log_buffers )
+    for ( auto& lb : log_buffers ) {
+        FlushLogTopicEventBuffers(lb);
         rval += lb.Flush(bstate->endpoint, log_batch_size);
+    }
 
     num_logs_outgoing_metric->Inc(rval);
 
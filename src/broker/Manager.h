@@ -30,8 +30,10 @@ using TableValPtr = IntrusivePtr<TableVal>;
 namespace telemetry {
 class Gauge;
 class Counter;
+class Histogram;
 using GaugePtr = std::shared_ptr<Gauge>;
 using CounterPtr = std::shared_ptr<Counter>;
+using HistogramPtr = std::shared_ptr<Histogram>;
 } // namespace telemetry
 
 namespace detail {
@@ -381,6 +383,22 @@ public:
      */
     size_t FlushLogBuffers();
 
+    /**
+     * Send pending batched events.
+     * @param force if false, only sends batches whose oldest event has
+     * been held back for at least its topic's max delay.
+     * @return the number of events sent.
+     */
+    size_t FlushEventBuffers(bool force = true);
+
+    /**
+     * Send pending batched events for a topic and the topics below it,
+     * so that they go out before anything else sent to that topic.
+     * @param topic the topic.
+     * @return the number of events sent.
+     */
+    size_t FlushTopicEventBuffers(const std::string& topic);
+
     /**
      * Flushes all pending data store queries and also clears all contents.
      */
@@ -440,6 +458,30 @@ private:
         size_t Flush(broker::endpoint& endpoint, size_t batch_size);
     };
 
+    // Batching parameters for events published to topics with a given prefix.
+    struct EventBatchPolicy {
+        size_t max_events = 0;
+        double max_delay = 0.0;
+    };
+
+    // Pending events for a single topic.
+    struct EventBuffer {
+        broker::zeek::BatchBuilder msgs;
+        size_t message_count = 0;
+        double first_network_time = 0.0; // When the oldest pending event was added.
+        EventBatchPolicy policy;
+
+        size_t Flush(broker::endpoint& endpoint, const std::string& topic);
+    };
+
+    enum class EventFlushReason { Size, Delay, Forced };
+
+    const EventBatchPolicy& LookupEventBatchPolicy(const std::string& topic) const;
+    // Sends pending events for the topics of a stream's buffered log writes
+    // ahead of them.
+    void FlushLogTopicEventBuffers(LogBuffer& lb);
+    size_t FlushEventBuffer(const std::string& topic, EventBuffer& eb, EventFlushReason reason);
+
     // Data stores
     using query_id = std::pair<broker::request_id, detail::StoreHandleVal*>;
 
@@ -453,6 +495,10 @@ private:
     };
 
     std::vector<LogBuffer> log_buffers; // Indexed by stream ID enum.
+    std::unordered_map<std::string, EventBuffer> event_buffers; // Indexed by topic string.
+    std::vector<std::pair<std::string, EventBatchPolicy>> event_batch_policies; // Longest prefix first.
+    EventBatchPolicy default_event_batch_policy;
+    bool event_batching = false;
     std::string default_log_topic_prefix;
     std::shared_ptr<BrokerState> bstate;
     std::unordered_map<std::string, detail::StoreHandleVal*> data_stores;
@@ -485,6 +531,11 @@ private:
     telemetry::CounterPtr num_logs_outgoing_metric;
     telemetry::CounterPtr num_ids_incoming_metric;
     telemetry::CounterPtr num_ids_outgoing_metric;
+    telemetry::HistogramPtr event_batch_size_metric;
+    telemetry::HistogramPtr event_batch_latency_metric;
+    telemetry::CounterPtr event_batch_flushes_size_metric;
+    telemetry::CounterPtr event_batch_flushes_delay_metric;
+    telemetry::CounterPtr event_batch_flushes_forced_metric;
 };
 
 } // namespace Broker
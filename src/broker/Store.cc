@@ -24,10 +24,14 @@ EnumValPtr query_status(bool success) {
 }
 
 void StoreHandleVal::Put(BrokerData&& key, BrokerData&& value, std::optional<BrokerTimespan> expiry) {
+    broker_mgr->FlushTopicEventBuffers(store.name());
     store.put(std::move(key).value_, std::move(value).value_, expiry);
 }
 
-void StoreHandleVal::Erase(BrokerData&& key) { store.erase(std::move(key).value_); }
+void StoreHandleVal::Erase(BrokerData&& key) {
+    broker_mgr->FlushTopicEventBuffers(store.name());
+    store.erase(std::move(key).value_);
+}
 
 void StoreHandleVal::ValDescribe(ODesc* d) const {
     d->Add("broker::store::");
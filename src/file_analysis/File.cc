@@ -77,6 +77,7 @@ void File::StaticInit() {
 
 File::File(const std::string& file_id, const std::string& source_name, Connection* conn, zeek::Tag tag, bool is_orig)
     : id(file_id),
+      key(file_id),
       val(nullptr),
       file_reassembler(nullptr),
       stream_offset(0),
@@ -85,6 +86,7 @@ File::File(const std::string& file_id, const std::string& source_name, Connectio
       reassembly_enabled(false),
       postpone_timeout(false),
       done(false),
+      ignored(false),
       analyzers(this) {
     StaticInit();
 
@@ -515,7 +517,7 @@ void File::Gap(uint64_t offset, uint64_t len) {
     IncrementByteCount(len, missing_bytes_idx);
 }
 
-bool File::FileEventAvailable(EventHandlerPtr h) { return h && ! file_mgr->IsIgnored(id); }
+bool File::FileEventAvailable(EventHandlerPtr h) { return h && ! ignored; }
 
 void File::FileEvent(EventHandlerPtr h) {
     if ( ! FileEventAvailable(h) )
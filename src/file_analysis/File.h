@@ -12,6 +12,7 @@
 #include "zeek/ZeekList.h" // for ValPList
 #include "zeek/ZeekString.h"
 #include "zeek/file_analysis/AnalyzerSet.h"
+#include "zeek/file_analysis/FileKey.h"
 
 namespace zeek {
 
@@ -78,6 +79,11 @@ public:
      */
     const std::string& GetID() const { return id; }
 
+    /**
+     * @return the key for the file's ID in the file manager's map.
+     */
+    const FileKey& GetKey() const { return key; }
+
     /**
      * @return value of "last_active" field in #val record;
      */
@@ -317,6 +323,7 @@ protected:
 
 protected:
     std::string id;                      /**< A pretty hash that likely identifies file */
+    FileKey key;                         /**< Key for #id in the file manager's map. */
     RecordValPtr val;                    /**< \c fa_file from script layer. */
     FileReassembler* file_reassembler;   /**< A reassembler for the file if it's needed. */
     uint64_t stream_offset;              /**< The offset of the file which has been forwarded. */
@@ -325,6 +332,7 @@ protected:
     bool reassembly_enabled;             /**< Whether file stream reassembly is needed. */
     bool postpone_timeout;               /**< Whether postponing timeout is requested. */
     bool done;                           /**< If this object is about to be deleted. */
+    bool ignored;                        /**< If analysis of the file is being ignored. */
     detail::AnalyzerSet analyzers;       /**< A set of attached file analyzers. */
     std::list<Analyzer*> done_analyzers; /**< Analyzers we're done with, remembered here until they
                                             can be safely deleted. */
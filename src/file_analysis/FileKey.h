@@ -0,0 +1,88 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+
+namespace zeek::file_analysis {
+
+/**
+ * A compact, fixed-size stand-in for a file ID string, used as the key of
+ * the file manager's map of active files. It's a keyed 128-bit hash of
+ * the ID, which itself is usually a 96-bit hash of a file handle.
+ */
+struct FileKey {
+    uint64_t hi = 0;
+    uint64_t lo = 0;
+
+    FileKey() = default;
+
+    /**
+     * Computes the key for a file ID.
+     * @param file_id the file identifier/hash.
+     */
+    explicit FileKey(const std::string& file_id);
+
+    bool operator==(const FileKey& other) const { return hi == other.hi && lo == other.lo; }
+    bool operator!=(const FileKey& other) const { return ! (*this == other); }
+};
+
+/**
+ * Hash function for using FileKey in unordered containers. The key is
+ * already a keyed hash, so any part of it makes a good bucket index.
+ */
+struct FileKeyHash {
+    size_t operator()(const FileKey& k) const { return static_cast<size_t>(k.lo); }
+};
+
+/**
+ * A file ID along with its key. Protocol analyzers keep one per file
+ * they're delivering content for and pass it back into the manager, so
+ * that repeated deliveries neither copy nor hash the ID string.
+ */
+class FileRef {
+public:
+    FileRef() = default;
+
+    /**
+     * Constructor.
+     * @param file_id the file identifier/hash, or an empty string for an
+     *        unset reference.
+     */
+    explicit FileRef(std::string file_id) : id(std::move(file_id)) {
+        if ( ! id.empty() )
+            key = FileKey(id);
+    }
+
+    /**
+     * @return the file identifier/hash, or an empty string if unset.
+     */
+    const std::string& ID() const { return id; }
+
+    /**
+     * @return the key for the file identifier.
+     */
+    const FileKey& Key() const { return key; }
+
+    /**
+     * @return true if the reference is set.
+     */
+    explicit operator bool() const { return ! id.empty(); }
+
+    /**
+     * Unsets the reference.
+     */
+    void Clear() {
+        id.clear();
+        key = FileKey();
+    }
+
+private:
+    std::string id;
+    FileKey key;
+};
+
+} // namespace zeek::file_analysis
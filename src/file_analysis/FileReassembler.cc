@@ -3,6 +3,7 @@
 #include "zeek/file_analysis/FileReassembler.h"
 
 #include "zeek/3rdparty/doctest.h"
+#include "zeek/Reporter.h"
 #include "zeek/file_analysis/File.h"
 
 namespace zeek::file_analysis {
@@ -97,6 +98,12 @@ void FileReassembler::Undelivered(uint64_t up_to_seq) {
     }
 }
 
+void FileReassembler::Evict() {
+    reporter->Weird(the_file, "reassembly_memory_budget_exceeded");
+    Flush();
+    ClearBlocks();
+}
+
 void FileReassembler::Overlap(const u_char* b1, const u_char* b2, uint64_t n) {
     // Not doing anything here yet.
 }
@@ -11,6 +11,7 @@
 #include "zeek/digest.h"
 #include "zeek/file_analysis/Analyzer.h"
 #include "zeek/file_analysis/File.h"
+#include "zeek/file_analysis/WorkerPool.h"
 #include "zeek/file_analysis/file_analysis.bif.h"
 #include "zeek/plugin/Manager.h"
 
@@ -18,6 +19,13 @@ using namespace std;
 
 namespace zeek::file_analysis {
 
+FileKey::FileKey(const string& file_id) {
+    zeek::detail::hash128_t hash;
+    zeek::detail::KeyedHash::Hash128(file_id.data(), file_id.size(), &hash);
+    hi = hash[0];
+    lo = hash[1];
+}
+
 Manager::Manager()
     : plugin::ComponentManager<file_analysis::Component>("Files", "Tag", "AllAnalyzers"),
       current_file_id(),
@@ -53,14 +61,16 @@ void Manager::InitMagic() {
 }
 
 void Manager::Terminate() {
-    vector<string> keys;
-    keys.reserve(id_map.size());
+    vector<string> ids;
+    ids.reserve(id_map.size());
 
     for ( const auto& entry : id_map )
-        keys.push_back(entry.first);
+        ids.push_back(entry.second->GetID());
+
+    for ( const string& id : ids )
+        Timeout(id, true);
 
-    for ( const string& key : keys )
-        Timeout(key, true);
+    detail::WorkerPool::Shutdown();
 
     event_mgr.Drain();
 }
@@ -90,11 +100,22 @@ void Manager::SetHandle(const string& handle) {
 
 string Manager::DataIn(const u_char* data, uint64_t len, uint64_t offset, const zeek::Tag& tag, Connection* conn,
                        bool is_orig, const string& precomputed_id, const string& mime_type) {
-    string id = precomputed_id.empty() ? GetFileID(tag, conn, is_orig) : precomputed_id;
-    File* file = GetFile(id, conn, tag, is_orig);
+    FileRef ref(precomputed_id);
+    DataIn(data, len, offset, tag, conn, is_orig, ref, mime_type);
+    return ref.ID();
+}
 
-    if ( ! file )
-        return "";
+void Manager::DataIn(const u_char* data, uint64_t len, uint64_t offset, const zeek::Tag& tag, Connection* conn,
+                     bool is_orig, FileRef& ref, const string& mime_type) {
+    if ( ! ref )
+        ref = FileRef(GetFileID(tag, conn, is_orig));
+
+    File* file = GetFile(ref, conn, tag, is_orig);
+
+    if ( ! file ) {
+        ref.Clear();
+        return;
+    }
 
     // This only has any effect when
     // * called for the first time for a file
@@ -108,22 +129,31 @@ string Manager::DataIn(const u_char* data, uint64_t len, uint64_t offset, const
     file->DataIn(data, len, offset);
 
     if ( file->IsComplete() ) {
-        RemoveFile(file->GetID());
-        return "";
+        RemoveFile(ref.Key());
+        ref.Clear();
     }
-
-    return id;
 }
 
 string Manager::DataIn(const u_char* data, uint64_t len, const zeek::Tag& tag, Connection* conn, bool is_orig,
                        const string& precomputed_id, const string& mime_type) {
-    string id = precomputed_id.empty() ? GetFileID(tag, conn, is_orig) : precomputed_id;
+    FileRef ref(precomputed_id);
+    DataIn(data, len, tag, conn, is_orig, ref, mime_type);
+    return ref.ID();
+}
+
+void Manager::DataIn(const u_char* data, uint64_t len, const zeek::Tag& tag, Connection* conn, bool is_orig,
+                     FileRef& ref, const string& mime_type) {
+    if ( ! ref )
+        ref = FileRef(GetFileID(tag, conn, is_orig));
+
     // Sequential data input shouldn't be going over multiple conns, so don't
     // do the check to update connection set.
-    File* file = GetFile(id, conn, tag, is_orig, false);
+    File* file = GetFile(ref, conn, tag, is_orig, false);
 
-    if ( ! file )
-        return "";
+    if ( ! file ) {
+        ref.Clear();
+        return;
+    }
 
     if ( ! mime_type.empty() )
         file->SetMime(mime_type);
@@ -131,11 +161,9 @@ string Manager::DataIn(const u_char* data, uint64_t len, const zeek::Tag& tag, C
     file->DataIn(data, len);
 
     if ( file->IsComplete() ) {
-        RemoveFile(file->GetID());
-        return "";
+        RemoveFile(ref.Key());
+        ref.Clear();
     }
-
-    return id;
 }
 
 void Manager::DataIn(const u_char* data, uint64_t len, const string& file_id, const string& source,
@@ -182,34 +210,56 @@ void Manager::EndOfFile(const zeek::Tag& tag, Connection* conn, bool is_orig) {
 
 void Manager::EndOfFile(const string& file_id) { RemoveFile(file_id); }
 
+void Manager::EndOfFile(const FileRef& ref) {
+    if ( ref )
+        RemoveFile(ref.Key());
+}
+
 string Manager::Gap(uint64_t offset, uint64_t len, const zeek::Tag& tag, Connection* conn, bool is_orig,
                     const string& precomputed_id) {
-    string id = precomputed_id.empty() ? GetFileID(tag, conn, is_orig) : precomputed_id;
-    File* file = GetFile(id, conn, tag, is_orig);
+    FileRef ref(precomputed_id);
+    Gap(offset, len, tag, conn, is_orig, ref);
+    return ref.ID();
+}
 
-    if ( ! file )
-        return "";
+void Manager::Gap(uint64_t offset, uint64_t len, const zeek::Tag& tag, Connection* conn, bool is_orig, FileRef& ref) {
+    if ( ! ref )
+        ref = FileRef(GetFileID(tag, conn, is_orig));
+
+    File* file = GetFile(ref, conn, tag, is_orig);
+
+    if ( ! file ) {
+        ref.Clear();
+        return;
+    }
 
     file->Gap(offset, len);
-    return id;
 }
 
 string Manager::SetSize(uint64_t size, const zeek::Tag& tag, Connection* conn, bool is_orig,
                         const string& precomputed_id) {
-    string id = precomputed_id.empty() ? GetFileID(tag, conn, is_orig) : precomputed_id;
-    File* file = GetFile(id, conn, tag, is_orig);
+    FileRef ref(precomputed_id);
+    SetSize(size, tag, conn, is_orig, ref);
+    return ref.ID();
+}
 
-    if ( ! file )
-        return "";
+void Manager::SetSize(uint64_t size, const zeek::Tag& tag, Connection* conn, bool is_orig, FileRef& ref) {
+    if ( ! ref )
+        ref = FileRef(GetFileID(tag, conn, is_orig));
+
+    File* file = GetFile(ref, conn, tag, is_orig);
+
+    if ( ! file ) {
+        ref.Clear();
+        return;
+    }
 
     file->SetTotalBytes(size);
 
     if ( file->IsComplete() ) {
-        RemoveFile(file->GetID());
-        return "";
+        RemoveFile(ref.Key());
+        ref.Clear();
     }
-
-    return id;
 }
 
 bool Manager::SetTimeoutInterval(const string& file_id, double interval) const {
@@ -282,19 +332,19 @@ bool Manager::RemoveAnalyzer(const string& file_id, const zeek::Tag& tag, Record
     return file->RemoveAnalyzer(tag, std::move(args));
 }
 
-File* Manager::GetFile(const string& file_id, Connection* conn, const zeek::Tag& tag, bool is_orig, bool update_conn,
+File* Manager::GetFile(const FileRef& ref, Connection* conn, const zeek::Tag& tag, bool is_orig, bool update_conn,
                        const char* source_name) {
-    if ( file_id.empty() )
+    if ( ! ref )
         return nullptr;
 
-    if ( IsIgnored(file_id) )
-        return nullptr;
+    File* rval = LookupFile(ref.Key());
 
-    File* rval = LookupFile(file_id);
+    if ( rval && rval->ignored )
+        return nullptr;
 
     if ( ! rval ) {
-        rval = new File(file_id, source_name ? source_name : analyzer_mgr->GetComponentName(tag), conn, tag, is_orig);
-        id_map[file_id] = rval;
+        rval = new File(ref.ID(), source_name ? source_name : analyzer_mgr->GetComponentName(tag), conn, tag, is_orig);
+        id_map[ref.Key()] = rval;
 
         ++cumulative_files;
         if ( id_map.size() > max_files )
@@ -308,7 +358,7 @@ File* Manager::GetFile(const string& file_id, Connection* conn, const zeek::Tag&
         // Same for file_over_new_connection.
         rval->RaiseFileOverNewConnection(conn, is_orig);
 
-        if ( IsIgnored(file_id) )
+        if ( rval->ignored )
             return nullptr;
     }
     else {
@@ -321,8 +371,8 @@ File* Manager::GetFile(const string& file_id, Connection* conn, const zeek::Tag&
     return rval;
 }
 
-File* Manager::LookupFile(const string& file_id) const {
-    const auto& entry = id_map.find(file_id);
+File* Manager::LookupFile(const FileKey& key) const {
+    const auto& entry = id_map.find(key);
     if ( entry == id_map.end() )
         return nullptr;
 
@@ -352,35 +402,39 @@ void Manager::Timeout(const string& file_id, bool is_terminating) {
 }
 
 bool Manager::IgnoreFile(const string& file_id) {
-    if ( ! LookupFile(file_id) )
+    File* f = LookupFile(file_id);
+
+    if ( ! f )
         return false;
 
     DBG_LOG(DBG_FILE_ANALYSIS, "Ignore FileID %s", file_id.c_str());
 
-    ignored.insert(file_id);
+    f->ignored = true;
     return true;
 }
 
-bool Manager::RemoveFile(const string& file_id) {
+bool Manager::RemoveFile(const FileKey& key) {
     // Can't remove from the dictionary/map right away as invoking EndOfFile
     // may cause some events to be executed which actually depend on the file
     // still being in the dictionary/map.
-    File* f = LookupFile(file_id);
+    File* f = LookupFile(key);
 
     if ( ! f )
         return false;
 
-    DBG_LOG(DBG_FILE_ANALYSIS, "[%s] Remove file", file_id.c_str());
+    DBG_LOG(DBG_FILE_ANALYSIS, "[%s] Remove file", f->GetID().c_str());
 
     f->EndOfFile();
 
-    id_map.erase(file_id);
-    ignored.erase(file_id);
+    id_map.erase(key);
     delete f;
     return true;
 }
 
-bool Manager::IsIgnored(const string& file_id) { return ignored.find(file_id) != ignored.end(); }
+bool Manager::IsIgnored(const FileKey& key) {
+    File* f = LookupFile(key);
+    return f && f->ignored;
+}
 
 string Manager::GetFileID(const zeek::Tag& tag, Connection* c, bool is_orig) {
     current_file_id.clear();
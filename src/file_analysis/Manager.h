@@ -5,10 +5,12 @@
 #include <map>
 #include <set>
 #include <string>
+#include <unordered_map>
 
 #include "zeek/RuleMatcher.h"
 #include "zeek/Tag.h"
 #include "zeek/file_analysis/Component.h"
+#include "zeek/file_analysis/FileKey.h"
 #include "zeek/file_analysis/FileTimer.h"
 #include "zeek/plugin/ComponentManager.h"
 
@@ -118,6 +120,20 @@ public:
     std::string DataIn(const u_char* data, uint64_t len, uint64_t offset, const zeek::Tag& tag, Connection* conn,
                        bool is_orig, const std::string& precomputed_file_id = "", const std::string& mime_type = "");
 
+    /**
+     * Pass in non-sequential file data, keeping track of the file through
+     * a reference instead of a file ID string. This is the cheapest way to
+     * deliver repeatedly to the same file.
+     * @param ref if unset, the file's ID is looked up through the
+     *        \c get_file_handle event and stored in \a ref. Otherwise it's
+     *        used directly. It's unset again if the file is not going to
+     *        be analyzed further.
+     * @see DataIn(const u_char*, uint64_t, uint64_t, const zeek::Tag&, Connection*, bool, const std::string&,
+     *      const std::string&) for the other parameters.
+     */
+    void DataIn(const u_char* data, uint64_t len, uint64_t offset, const zeek::Tag& tag, Connection* conn,
+                bool is_orig, FileRef& ref, const std::string& mime_type = "");
+
     /**
      * Pass in sequential file data.
      * @param data pointer to start of a chunk of file data.
@@ -143,6 +159,16 @@ public:
     std::string DataIn(const u_char* data, uint64_t len, const zeek::Tag& tag, Connection* conn, bool is_orig,
                        const std::string& precomputed_file_id = "", const std::string& mime_type = "");
 
+    /**
+     * Pass in sequential file data, keeping track of the file through a
+     * reference instead of a file ID string.
+     * @param ref see the non-sequential version.
+     * @see DataIn(const u_char*, uint64_t, const zeek::Tag&, Connection*, bool, const std::string&,
+     *      const std::string&) for the other parameters.
+     */
+    void DataIn(const u_char* data, uint64_t len, const zeek::Tag& tag, Connection* conn, bool is_orig, FileRef& ref,
+                const std::string& mime_type = "");
+
     /**
      * Pass in sequential file data from external source (e.g. input framework).
      * @param data pointer to start of a chunk of file data.
@@ -202,6 +228,12 @@ public:
      */
     void EndOfFile(const std::string& file_id);
 
+    /**
+     * Signal the end of file data being transferred using a file reference.
+     * @param ref the file reference, which may be unset.
+     */
+    void EndOfFile(const FileRef& ref);
+
     /**
      * Signal a gap in the file data stream.
      * @param offset number of bytes into file at which missing chunk starts.
@@ -221,6 +253,13 @@ public:
     std::string Gap(uint64_t offset, uint64_t len, const zeek::Tag& tag, Connection* conn, bool is_orig,
                     const std::string& precomputed_file_id = "");
 
+    /**
+     * Signal a gap in the file data stream, keeping track of the file
+     * through a reference instead of a file ID string.
+     * @param ref see DataIn().
+     */
+    void Gap(uint64_t offset, uint64_t len, const zeek::Tag& tag, Connection* conn, bool is_orig, FileRef& ref);
+
     /**
      * Provide the expected number of bytes that comprise a file.
      * @param size the number of bytes in the full file.
@@ -239,6 +278,13 @@ public:
     std::string SetSize(uint64_t size, const zeek::Tag& tag, Connection* conn, bool is_orig,
                         const std::string& precomputed_file_id = "");
 
+    /**
+     * Provide the expected number of bytes that comprise a file, keeping
+     * track of the file through a reference instead of a file ID string.
+     * @param ref see DataIn().
+     */
+    void SetSize(uint64_t size, const zeek::Tag& tag, Connection* conn, bool is_orig, FileRef& ref);
+
     /**
      * Starts ignoring a file, which will finally be removed from internal
      * mappings on EOF or TIMEOUT.
@@ -290,7 +336,15 @@ public:
      * @return the File object mapped to \a file_id, or a null pointer if no
      *         mapping exists.
      */
-    File* LookupFile(const std::string& file_id) const;
+    File* LookupFile(const std::string& file_id) const { return LookupFile(FileKey(file_id)); }
+
+    /**
+     * Try to retrieve a file that's being analyzed, using its key.
+     * @param key the key for the file identifier/hash.
+     * @return the File object mapped to \a key, or a null pointer if no
+     *         mapping exists.
+     */
+    File* LookupFile(const FileKey& key) const;
 
     /**
      * Queue attachment of an analyzer to the file identifier.  Multiple
@@ -317,7 +371,14 @@ public:
      * @param file_id the file identifier/hash.
      * @return whether the file mapped to \a file_id is being ignored.
      */
-    bool IsIgnored(const std::string& file_id);
+    bool IsIgnored(const std::string& file_id) { return IsIgnored(FileKey(file_id)); }
+
+    /**
+     * Tells whether analysis for a file is active or ignored.
+     * @param key the key for the file identifier/hash.
+     * @return whether the file mapped to \a key is being ignored.
+     */
+    bool IsIgnored(const FileKey& key);
 
     /**
      * Instantiates a new file analyzer instance for the file.
@@ -394,6 +455,17 @@ protected:
      *         connection-related fields.
      */
     File* GetFile(const std::string& file_id, Connection* conn = nullptr, const zeek::Tag& tag = zeek::Tag::Error,
+                  bool is_orig = false, bool update_conn = true, const char* source_name = nullptr) {
+        return GetFile(FileRef(file_id), conn, tag, is_orig, update_conn, source_name);
+    }
+
+    /**
+     * Create a new file to be analyzed or retrieve an existing one.
+     * @param ref a reference to the file, which must be set.
+     * @see GetFile(const std::string&, Connection*, const zeek::Tag&, bool, bool, const char*)
+     *      for the other parameters and the return value.
+     */
+    File* GetFile(const FileRef& ref, Connection* conn = nullptr, const zeek::Tag& tag = zeek::Tag::Error,
                   bool is_orig = false, bool update_conn = true, const char* source_name = nullptr);
 
     /**
@@ -410,7 +482,14 @@ protected:
      * @param file_id the file identifier/hash.
      * @return false if file id string did not map to anything, else true.
      */
-    bool RemoveFile(const std::string& file_id);
+    bool RemoveFile(const std::string& file_id) { return RemoveFile(FileKey(file_id)); }
+
+    /**
+     * Immediately remove file_analysis::File object associated with \a key.
+     * @param key the key for the file identifier/hash.
+     * @return false if the key did not map to anything, else true.
+     */
+    bool RemoveFile(const FileKey& key);
 
     /**
      * Check if analysis is available for files transferred over a given
@@ -428,8 +507,7 @@ private:
 
     TagSet* LookupMIMEType(const std::string& mtype, bool add_if_not_found);
 
-    std::map<std::string, File*> id_map;           /**< Map file ID to file_analysis::File records. */
-    std::set<std::string> ignored;                 /**< Ignored files.  Will be finally removed on EOF. */
+    std::unordered_map<FileKey, File*, FileKeyHash> id_map; /**< Map file key to file_analysis::File records. */
     std::string current_file_id;                   /**< Hash of what get_file_handle event sets. */
     zeek::detail::RuleFileMagicState* magic_state; /**< File magic signature match state. */
     MIMEMap mime_types;                            /**< Mapping of MIME types to analyzers. */
@@ -0,0 +1,151 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/file_analysis/WorkerPool.h"
+
+#include <string>
+
+#include "zeek/Val.h"
+#include "zeek/util.h"
+
+namespace zeek::file_analysis::detail {
+
+std::unique_ptr<WorkerPool> WorkerPool::instance;
+bool WorkerPool::initialized = false;
+
+void WorkerStream::Deliver(const u_char* data, uint64_t len) {
+    if ( len == 0 )
+        return;
+
+    std::unique_lock<std::mutex> lock(pool->mtx);
+
+    if ( pool->terminating ) {
+        // The workers are gone; process the chunk directly.
+        lock.unlock();
+        consumer(data, len);
+        return;
+    }
+
+    std::vector<u_char> chunk(data, data + len);
+
+    // Backpressure: wait for the workers to catch up. A single chunk
+    // larger than the limit is still accepted once the queue is empty.
+    pool->done_cv.wait(lock, [this] { return pool->queued_bytes < pool->max_queued_bytes; });
+
+    pool->queued_bytes += len;
+    pending.push_back(std::move(chunk));
+
+    if ( ! scheduled ) {
+        scheduled = true;
+        pool->Schedule(shared_from_this());
+    }
+}
+
+void WorkerStream::Wait() {
+    std::unique_lock<std::mutex> lock(pool->mtx);
+    pool->done_cv.wait(lock, [this] { return ! scheduled; });
+}
+
+void WorkerStream::Cancel() {
+    std::unique_lock<std::mutex> lock(pool->mtx);
+
+    for ( const auto& chunk : pending )
+        pool->queued_bytes -= chunk.size();
+
+    pending.clear();
+    pool->done_cv.notify_all();
+    pool->done_cv.wait(lock, [this] { return ! scheduled; });
+}
+
+WorkerPool::WorkerPool(size_t num_threads, uint64_t arg_max_queued_bytes) : max_queued_bytes(arg_max_queued_bytes) {
+    threads.reserve(num_threads);
+
+    for ( size_t i = 0; i < num_threads; ++i ) {
+        threads.emplace_back([this, i] {
+            // util::fmt() uses a static buffer, so don't call it off the main thread.
+            auto name = "zk.file_worker." + std::to_string(i);
+            util::detail::set_thread_name(name.c_str());
+            Run();
+        });
+    }
+}
+
+WorkerPool::~WorkerPool() { Stop(); }
+
+void WorkerPool::Stop() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        terminating = true;
+    }
+
+    work_cv.notify_all();
+
+    for ( auto& t : threads )
+        t.join();
+
+    threads.clear();
+}
+
+std::shared_ptr<WorkerStream> WorkerPool::NewStream(WorkerStream::Consumer consumer) {
+    return std::make_shared<WorkerStream>(this, std::move(consumer));
+}
+
+WorkerPool* WorkerPool::Instance() {
+    if ( ! initialized ) {
+        initialized = true;
+
+        auto num_threads = id::find_val("Files::analyzer_threads")->AsCount();
+        auto queue_limit = id::find_val("Files::analyzer_thread_queue_limit")->AsCount();
+
+        if ( num_threads > 0 )
+            instance = std::make_unique<WorkerPool>(num_threads, queue_limit);
+    }
+
+    return instance.get();
+}
+
+void WorkerPool::Shutdown() {
+    // Streams may still reference the pool, so only stop the threads
+    // here and leave the pool itself in place.
+    if ( instance )
+        instance->Stop();
+}
+
+void WorkerPool::Schedule(std::shared_ptr<WorkerStream> s) {
+    // Called with the mutex held.
+    ready.push_back(std::move(s));
+    work_cv.notify_one();
+}
+
+void WorkerPool::Run() {
+    std::unique_lock<std::mutex> lock(mtx);
+
+    while ( true ) {
+        work_cv.wait(lock, [this] { return terminating || ! ready.empty(); });
+
+        if ( ready.empty() )
+            return; // terminating and nothing left to do
+
+        auto s = std::move(ready.front());
+        ready.pop_front();
+
+        // A stream is in the ready queue at most once, so only this
+        // thread processes it until it's unscheduled again, which
+        // keeps its chunks in order.
+        while ( ! s->pending.empty() ) {
+            auto chunk = std::move(s->pending.front());
+            s->pending.pop_front();
+
+            lock.unlock();
+            s->consumer(chunk.data(), chunk.size());
+            lock.lock();
+
+            queued_bytes -= chunk.size();
+            done_cv.notify_all();
+        }
+
+        s->scheduled = false;
+        done_cv.notify_all();
+    }
+}
+
+} // namespace zeek::file_analysis::detail
@@ -0,0 +1,128 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <sys/types.h> // for u_char
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace zeek::file_analysis::detail {
+
+class WorkerPool;
+
+/**
+ * An ordered stream of file content processed by a WorkerPool. Chunks
+ * delivered to a stream are handed to its consumer in the order they
+ * were delivered, and never concurrently with each other, though not
+ * necessarily always on the same thread.
+ */
+class WorkerStream : public std::enable_shared_from_this<WorkerStream> {
+public:
+    /**
+     * Function processing one chunk of content on a worker thread.
+     */
+    using Consumer = std::function<void(const u_char* data, uint64_t len)>;
+
+    WorkerStream(WorkerPool* pool, Consumer consumer) : pool(pool), consumer(std::move(consumer)) {}
+
+    /**
+     * Queues a chunk of content for processing. The data is copied, so
+     * the caller's buffer doesn't need to outlive the call. Blocks if
+     * the pool's queue limit has been reached.
+     * @param data pointer to start of a chunk of file data.
+     * @param len number of bytes in the data chunk.
+     */
+    void Deliver(const u_char* data, uint64_t len);
+
+    /**
+     * Blocks until all content queued so far has been processed.
+     */
+    void Wait();
+
+    /**
+     * Discards any content not yet processed and blocks until the
+     * consumer is no longer running. The consumer won't be called
+     * afterwards.
+     */
+    void Cancel();
+
+private:
+    friend class WorkerPool;
+
+    WorkerPool* pool;
+    Consumer consumer;
+
+    // Protected by the pool's mutex.
+    std::deque<std::vector<u_char>> pending;
+    bool scheduled = false;
+};
+
+/**
+ * A bounded pool of threads that file analyzers use to offload
+ * CPU-heavy processing of file content from the main thread.
+ */
+class WorkerPool {
+public:
+    /**
+     * Constructor. Starts the worker threads.
+     * @param num_threads number of worker threads to start.
+     * @param max_queued_bytes number of bytes that may be queued across
+     * all streams before Deliver() blocks.
+     */
+    WorkerPool(size_t num_threads, uint64_t max_queued_bytes);
+
+    /**
+     * Destructor. Stops the worker threads.
+     */
+    ~WorkerPool();
+
+    /**
+     * Processes any remaining content, then joins the worker threads.
+     * Content delivered afterwards is processed on the calling thread.
+     */
+    void Stop();
+
+    /**
+     * Creates a new stream feeding the given consumer.
+     */
+    std::shared_ptr<WorkerStream> NewStream(WorkerStream::Consumer consumer);
+
+    /**
+     * Returns the process-wide pool, creating it on first use according
+     * to ``Files::analyzer_threads``.
+     * @return the pool, or null if analyzers should run on the main
+     * thread.
+     */
+    static WorkerPool* Instance();
+
+    /**
+     * Stops the process-wide pool's threads, if there is one.
+     */
+    static void Shutdown();
+
+private:
+    friend class WorkerStream;
+
+    void Schedule(std::shared_ptr<WorkerStream> s);
+    void Run();
+
+    std::mutex mtx;
+    std::condition_variable work_cv; // Signaled when streams become ready.
+    std::condition_variable done_cv; // Signaled when queued content has been processed.
+    std::deque<std::shared_ptr<WorkerStream>> ready;
+    uint64_t queued_bytes = 0;
+    uint64_t max_queued_bytes;
+    bool terminating = false;
+    std::vector<std::thread> threads;
+
+    static std::unique_ptr<WorkerPool> instance;
+    static bool initialized;
+};
+
+} // namespace zeek::file_analysis::detail
@@ -14,9 +14,17 @@ Entropy::Entropy(RecordValPtr args, file_analysis::File* file)
     : file_analysis::Analyzer(file_mgr->GetComponentTag("ENTROPY"), std::move(args), file) {
     entropy = new EntropyVal;
     fed = false;
+
+    if ( auto pool = WorkerPool::Instance() )
+        stream = pool->NewStream([ev = entropy](const u_char* data, uint64_t len) { ev->Feed(data, len); });
 }
 
-Entropy::~Entropy() { Unref(entropy); }
+Entropy::~Entropy() {
+    if ( stream )
+        stream->Cancel();
+
+    Unref(entropy);
+}
 
 file_analysis::Analyzer* Entropy::Instantiate(RecordValPtr args, file_analysis::File* file) {
     return new Entropy(std::move(args), file);
@@ -26,7 +34,11 @@ bool Entropy::DeliverStream(const u_char* data, uint64_t len) {
     if ( ! fed )
         fed = len > 0;
 
-    entropy->Feed(data, len);
+    if ( stream )
+        stream->Deliver(data, len);
+    else
+        entropy->Feed(data, len);
+
     return true;
 }
 
@@ -38,6 +50,9 @@ bool Entropy::EndOfFile() {
 bool Entropy::Undelivered(uint64_t offset, uint64_t len) { return false; }
 
 void Entropy::Finalize() {
+    if ( stream )
+        stream->Wait();
+
     if ( ! fed )
         return;
 
@@ -2,12 +2,14 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include "zeek/OpaqueVal.h"
 #include "zeek/Val.h"
 #include "zeek/file_analysis/Analyzer.h"
 #include "zeek/file_analysis/File.h"
+#include "zeek/file_analysis/WorkerPool.h"
 #include "zeek/file_analysis/analyzer/entropy/events.bif.h"
 
 namespace zeek::file_analysis::detail {
@@ -32,7 +34,9 @@ public:
     static file_analysis::Analyzer* Instantiate(RecordValPtr args, file_analysis::File* file);
 
     /**
-     * Calculate entropy of next chunk of file contents.
+     * Calculate entropy of next chunk of file contents. If
+     * ``Files::analyzer_threads`` is set, the chunk is queued for
+     * processing on a worker thread instead.
      * @param data pointer to start of a chunk of a file data.
      * @param len number of bytes in the data chunk.
      * @return false if the digest is in an invalid state, else true.
@@ -66,13 +70,15 @@ protected:
 
     /**
      * If some file contents have been seen, finalizes the entropy of them and
-     * raises the "file_entropy" event with the results.
+     * raises the "file_entropy" event with the results. Waits for any
+     * content still queued for a worker thread first.
      */
     void Finalize();
 
 private:
     EntropyVal* entropy;
     bool fed;
+    std::shared_ptr<WorkerStream> stream; // Set when processing on a worker thread.
 };
 
 } // namespace zeek::file_analysis::detail
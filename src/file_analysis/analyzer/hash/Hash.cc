@@ -21,9 +21,19 @@ Hash::Hash(RecordValPtr args, file_analysis::File* file, HashVal* hv, StringValP
       fed(false),
       kind(std::move(arg_kind)) {
     hash->Init();
+
+    if ( auto pool = WorkerPool::Instance() )
+        stream = pool->NewStream([hv = hash](const u_char* data, uint64_t len) { hv->Feed(data, len); });
+    else
+        hash->UseMultiBuffer();
 }
 
-Hash::~Hash() { Unref(hash); }
+Hash::~Hash() {
+    if ( stream )
+        stream->Cancel();
+
+    Unref(hash);
+}
 
 bool Hash::DeliverStream(const u_char* data, uint64_t len) {
     if ( ! hash->IsValid() )
@@ -32,7 +42,11 @@ bool Hash::DeliverStream(const u_char* data, uint64_t len) {
     if ( ! fed )
         fed = len > 0;
 
-    hash->Feed(data, len);
+    if ( stream )
+        stream->Deliver(data, len);
+    else
+        hash->Feed(data, len);
+
     return true;
 }
 
@@ -44,6 +58,9 @@ bool Hash::EndOfFile() {
 bool Hash::Undelivered(uint64_t offset, uint64_t len) { return false; }
 
 void Hash::Finalize() {
+    if ( stream )
+        stream->Wait();
+
     if ( ! hash->IsValid() || ! fed )
         return;
 
@@ -2,12 +2,14 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include "zeek/OpaqueVal.h"
 #include "zeek/Val.h"
 #include "zeek/file_analysis/Analyzer.h"
 #include "zeek/file_analysis/File.h"
+#include "zeek/file_analysis/WorkerPool.h"
 #include "zeek/file_analysis/analyzer/hash/events.bif.h"
 
 namespace zeek::file_analysis::detail {
@@ -23,7 +25,9 @@ public:
     ~Hash() override;
 
     /**
-     * Incrementally hash next chunk of file contents.
+     * Incrementally hash next chunk of file contents. If
+     * ``Files::analyzer_threads`` is set, the chunk is queued for
+     * hashing on a worker thread instead.
      * @param data pointer to start of a chunk of a file data.
      * @param len number of bytes in the data chunk.
      * @return false if the digest is in an invalid state, else true.
@@ -57,7 +61,8 @@ protected:
 
     /**
      * If some file contents have been seen, finalizes the hash of them and
-     * raises the "file_hash" event with the results.
+     * raises the "file_hash" event with the results. Waits for any content
+     * still queued for a worker thread first.
      */
     void Finalize();
 
@@ -65,6 +70,7 @@ private:
     HashVal* hash;
     bool fed;
     StringValPtr kind;
+    std::shared_ptr<WorkerStream> stream; // Set when hashing on a worker thread.
 };
 
 /**
@@ -110,27 +110,53 @@ bool PktSrc::HasBeenIdleFor(double interval) const {
     return idle_at_wallclock < now - interval;
 };
 
+// Starts loading a packet's headers into the cache.
+static inline void prefetch_packet(const Packet& pkt) {
+#ifndef _MSC_VER
+    __builtin_prefetch(pkt.data);
+#endif
+}
+
 void PktSrc::Process() {
     if ( ! IsOpen() )
         return;
 
-    if ( ! ExtractNextPacketInternal() )
-        return;
+    // Dispatch all packets of a batch back to back. In pseudo-realtime
+    // mode, we return to the main loop after each one so that
+    // GetNextTimeout() gets to pace them.
+    do {
+        if ( ! ExtractNextPacketInternal() )
+            return;
 
-    run_state::detail::dispatch_packet(&current_packet, this);
+        if ( batch_pos + 1 < batch_len )
+            prefetch_packet(batch[batch_pos + 1]);
 
-    have_packet = false;
-    DoneWithPacket();
+        run_state::detail::dispatch_packet(&batch[batch_pos], this);
+
+        NextPacketInBatch();
+    } while ( batch_len > 0 && IsOpen() && ! run_state::pseudo_realtime && ! run_state::terminating );
 }
 
 const char* PktSrc::Tag() { return "PktSrc"; }
 
+size_t PktSrc::ExtractNextPackets(Packet* pkts, size_t max) { return ExtractNextPacket(pkts) ? 1 : 0; }
+
+void PktSrc::DoneWithPackets() { DoneWithPacket(); }
+
+void PktSrc::NextPacketInBatch() {
+    have_packet = false;
+
+    if ( ++batch_pos < batch_len )
+        return;
+
+    batch_pos = batch_len = 0;
+    DoneWithPackets();
+}
+
 bool PktSrc::ExtractNextPacketInternal() {
     if ( have_packet )
         return true;
 
-    have_packet = false;
-
     // Don't return any packets if processing is suspended (except for the
     // very first packet which we need to set up times).
     if ( run_state::is_processing_suspended() && run_state::detail::first_timestamp )
@@ -139,36 +165,46 @@ bool PktSrc::ExtractNextPacketInternal() {
     if ( run_state::pseudo_realtime )
         run_state::detail::current_wallclock = util::current_time(true);
 
-    if ( ExtractNextPacket(&current_packet) ) {
-        had_packet = true;
+    if ( batch_len == 0 ) {
+        if ( ! batch ) {
+            batch_size = std::max(BifConst::Pcap::packet_batch_size, static_cast<zeek_uint_t>(1));
+            batch = std::make_unique<Packet[]>(batch_size);
+        }
 
-        if ( current_packet.time < 0 ) {
-            Weird("negative_packet_timestamp", &current_packet);
+        batch_len = ExtractNextPackets(batch.get(), batch_size);
+
+        if ( batch_len == 0 ) {
+            // Update the idle_at timestamp the first time we've failed
+            // to extract a packet. This assumes ExtractNextPackets() is
+            // called regularly which is true for non-selectable PktSrc
+            // instances, but even for selectable ones with an FD the
+            // main-loop will call Process() on the interface regularly
+            // and detect it as idle.
+            if ( had_packet ) {
+                DBG_LOG(DBG_PKTIO, "source %s is idle now", props.path.c_str());
+                idle_at_wallclock = zeek::util::current_time(true);
+            }
+
+            had_packet = false;
             return false;
         }
 
-        if ( ! run_state::detail::first_timestamp )
-            run_state::detail::first_timestamp = current_packet.time;
-
-        have_packet = true;
-        return true;
+        had_packet = true;
     }
-    else {
-        // Update the idle_at timestamp the first time we've failed
-        // to extract a packet. This assumes ExtractNextPacket() is
-        // called regularly which is true for non-selectable PktSrc
-        // instances, but even for selectable ones with an FD the
-        // main-loop will call Process() on the interface regularly
-        // and detect it as idle.
-        if ( had_packet ) {
-            DBG_LOG(DBG_PKTIO, "source %s is idle now", props.path.c_str());
-            idle_at_wallclock = zeek::util::current_time(true);
-        }
 
-        had_packet = false;
+    const Packet& pkt = batch[batch_pos];
+
+    if ( pkt.time < 0 ) {
+        Weird("negative_packet_timestamp", &pkt);
+        NextPacketInBatch();
+        return false;
     }
 
-    return false;
+    if ( ! run_state::detail::first_timestamp )
+        run_state::detail::first_timestamp = pkt.time;
+
+    have_packet = true;
+    return true;
 }
 
 detail::BPF_Program* PktSrc::CompileFilter(const std::string& filter) {
@@ -233,7 +269,7 @@ bool PktSrc::GetCurrentPacket(const Packet** pkt) {
     if ( ! have_packet )
         return false;
 
-    *pkt = &current_packet;
+    *pkt = &batch[batch_pos];
     return true;
 }
 
@@ -246,8 +282,12 @@ double PktSrc::GetNextTimeout() {
     if ( run_state::pseudo_realtime ) {
         ExtractNextPacketInternal();
 
+        // Without a packet available, this uses whatever packet is left at
+        // the start of the batch.
+        double next_time = batch ? batch[batch_pos].time : 0.0;
+
         // This duplicates the calculation used in run_state::check_pseudo_time().
-        double pseudo_time = current_packet.time - run_state::detail::first_timestamp;
+        double pseudo_time = next_time - run_state::detail::first_timestamp;
         double ct = (util::current_time(true) - run_state::detail::first_wallclock) * run_state::pseudo_realtime;
         return std::max(0.0, pseudo_time - ct);
     }
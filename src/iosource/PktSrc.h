@@ -3,6 +3,7 @@
 #pragma once
 
 #include <sys/types.h> // for u_char
+#include <memory>
 #include <optional>
 #include <vector>
 
@@ -350,6 +351,34 @@ protected:
      */
     virtual void DoneWithPacket() = 0;
 
+    /**
+     * Provides up to \a max packets at once. Packet sources that can hand
+     * out several packets per call into their capture library override
+     * this to cut the per-packet overhead. The default implementation
+     * calls ExtractNextPacket() once.
+     *
+     * The same rules as for ExtractNextPacket() apply: the callee keeps
+     * ownership of the data and must guarantee that it stays available
+     * for all returned packets until \a DoneWithPackets() is called. It
+     * is guaranteed that no two calls to this method will happen without
+     * \a DoneWithPackets() in between.
+     *
+     * @param pkts Array of at least \a max packet structures to fill in.
+     *
+     * @param max The maximum number of packets to return, at least 1.
+     *
+     * @return The number of packets filled in. Zero if no packet is
+     * available or an error occurred (which must be flagged via Error()).
+     */
+    virtual size_t ExtractNextPackets(Packet* pkts, size_t max);
+
+    /**
+     * Signals that the data of all packets returned by the previous
+     * ExtractNextPackets() call will no longer be needed. The default
+     * implementation calls DoneWithPacket().
+     */
+    virtual void DoneWithPackets();
+
     /**
      * Performs the actual filter compilation. This can be overridden to
      * provide a different implementation of the compilation called by
@@ -366,6 +395,10 @@ private:
     // Internal helper for ExtractNextPacket().
     bool ExtractNextPacketInternal();
 
+    // Moves on to the next packet of the current batch, releasing the
+    // batch once all of its packets are done.
+    void NextPacketInBatch();
+
     // IOSource interface implementation.
     void InitSource() override;
     void Done() override;
@@ -375,10 +408,16 @@ private:
     Properties props;
 
     bool have_packet;
-    Packet current_packet;
     // Did the previous call to ExtractNextPacket() yield a packet.
     bool had_packet;
 
+    // The packets of the most recent ExtractNextPackets() call. The
+    // current packet is the one at batch_pos.
+    std::unique_ptr<Packet[]> batch;
+    size_t batch_size = 0;
+    size_t batch_len = 0;
+    size_t batch_pos = 0;
+
     double idle_at_wallclock = 0.0;
 
     // For BPF filtering support.
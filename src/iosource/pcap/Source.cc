@@ -11,6 +11,7 @@
 #endif
 
 #include <stdio.h>
+#include <cstring>
 
 #include "zeek/Event.h"
 #include "zeek/iosource/BPF_Program.h"
@@ -261,6 +262,83 @@ bool PcapSource::ExtractNextPacket(Packet* pkt) {
     return true;
 }
 
+size_t PcapSource::ExtractNextPackets(Packet* pkts, size_t max) {
+    if ( ! pd )
+        return 0;
+
+    if ( max == 1 )
+        // Nothing to amortize, so avoid copying the packet.
+        return ExtractNextPacket(pkts) ? 1 : 0;
+
+    if ( batch_bufs.size() < max )
+        batch_bufs.resize(max);
+
+    batch = pkts;
+    batch_len = 0;
+
+    int res = pcap_dispatch(pd, static_cast<int>(max), AddToBatch, reinterpret_cast<u_char*>(this));
+
+    batch = nullptr;
+
+    switch ( res ) {
+        case PCAP_ERROR_BREAK: // -2
+            // The loop got broken off before reading any packets.
+            break;
+        case PCAP_ERROR: // -1
+            // Error occurred while reading a packet.
+            if ( props.is_live )
+                reporter->Error("failed to read a packet from %s: %s", props.path.data(), pcap_geterr(pd));
+            else
+                reporter->FatalError("failed to read a packet from %s: %s", props.path.data(), pcap_geterr(pd));
+            break;
+        case 0:
+            if ( ! props.is_live ) {
+                // Exhausted pcap file, no more packets to read.
+                Close();
+                return 0;
+            }
+
+            // Read from live interface timed out (ok).
+            break;
+        default:
+            // Read packets without problem.
+            break;
+    }
+
+    return batch_len;
+}
+
+void PcapSource::AddToBatch(u_char* user, const pcap_pkthdr* header, const u_char* data) {
+    auto* src = reinterpret_cast<PcapSource*>(user);
+
+    // See ExtractNextPacket() regarding libpcaps that claim to have read
+    // a packet without providing its contents.
+    if ( ! data ) {
+        reporter->Weird("pcap_null_data_packet");
+        return;
+    }
+
+    Packet* pkt = &src->batch[src->batch_len];
+    auto& buf = src->batch_bufs[src->batch_len];
+
+    if ( buf.size() < header->caplen )
+        buf.resize(header->caplen);
+
+    memcpy(buf.data(), data, header->caplen);
+
+    pkt_timeval ts = header->ts;
+    pkt->Init(src->props.link_type, &ts, header->caplen, header->len, buf.data());
+
+    if ( header->len == 0 || header->caplen == 0 ) {
+        src->Weird("empty_pcap_header", pkt);
+        return;
+    }
+
+    ++src->stats.received;
+    src->stats.bytes_received += header->len;
+    ++src->batch_len;
+}
+
 void PcapSource::DoneWithPacket() {
     // Nothing to do.
 }
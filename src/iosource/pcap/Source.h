@@ -27,6 +27,7 @@ protected:
     void Close() override;
     bool ExtractNextPacket(Packet* pkt) override;
     void DoneWithPacket() override;
+    size_t ExtractNextPackets(Packet* pkts, size_t max) override;
     bool SetFilter(int index) override;
     void Statistics(Stats* stats) override;
 
@@ -37,6 +38,9 @@ private:
     void OpenOffline();
     void PcapError(const char* where = nullptr);
 
+    // Callback for pcap_dispatch(), adds a packet to the current batch.
+    static void AddToBatch(u_char* user, const pcap_pkthdr* header, const u_char* data);
+
     Properties props;
     Stats stats;
 
@@ -45,6 +49,13 @@ private:
 
     // Buffer provided to setvbuf() when reading from a PCAP file.
     std::vector<char> iobuf;
+
+    // The batch that pcap_dispatch() is currently filling in. libpcap
+    // doesn't keep a packet's data around once the callback returns, so
+    // each packet gets copied into a buffer of its own.
+    Packet* batch = nullptr;
+    size_t batch_len = 0;
+    std::vector<std::vector<u_char>> batch_bufs;
 };
 
 } // namespace zeek::iosource::pcap
@@ -1154,6 +1154,27 @@ bool Manager::WriteToFilters(const Manager::Stream* stream, zeek::RecordValPtr c
 
         // Alright, can do the write now.
 
+        RecordBatch* batch = nullptr;
+
+        if ( ! plugin_mgr->HavePluginForHook(plugin::HOOK_LOG_WRITE) )
+            batch = writer->BatchForWrite(filter->num_fields, filter->fields);
+
+        if ( batch ) {
+            // Fast path: nobody needs to see the values individually, so
+            // convert the record straight into the writer's batch.
+            RecordToBatch(stream, filter, columns.get(), batch);
+
+            assert(w != stream->writers.end());
+            w->second->total_writes->Inc();
+            writer->FinishBatchWrite();
+
+#ifdef DEBUG
+            DBG_LOG(DBG_LOGGING, "Wrote record to filter '%s' on stream '%s'", filter->name.c_str(),
+                    stream->name.c_str());
+#endif
+            continue;
+        }
+
         threading::Value** vals = RecordToFilterVals(stream, filter, columns.get());
 
         if ( ! PLUGIN_HOOK_WITH_RESULT(HOOK_LOG_WRITE,
@@ -1385,6 +1406,31 @@ bool Manager::SetMaxDelayQueueSize(const EnumValPtr& id, zeek_uint_t queue_size)
     return true;
 }
 
+static threading::Value::port_t to_log_port(zeek_uint_t p) {
+    auto pt = TRANSPORT_UNKNOWN;
+    auto pm = p & PORT_SPACE_MASK;
+    if ( pm == TCP_PORT_MASK )
+        pt = TRANSPORT_TCP;
+    else if ( pm == UDP_PORT_MASK )
+        pt = TRANSPORT_UDP;
+    else if ( pm == ICMP_PORT_MASK )
+        pt = TRANSPORT_ICMP;
+
+    return {p & ~PORT_SPACE_MASK, pt};
+}
+
+static const char* enum_log_name(Type* ty, zeek_int_t i) {
+    const char* s = ty->AsEnumType()->Lookup(i);
+
+    if ( ! s ) {
+        auto err_msg = "enum type does not contain value:" + std::to_string(i);
+        ty->Error(err_msg.c_str());
+        s = "";
+    }
+
+    return s;
+}
+
 threading::Value* Manager::ValToLogVal(std::optional<ZVal>& val, Type* ty) {
     if ( ! val )
         return new threading::Value(ty->Tag(), false);
@@ -1396,41 +1442,16 @@ threading::Value* Manager::ValToLogVal(std::optional<ZVal>& val, Type* ty) {
         case TYPE_INT: lval->val.int_val = val->AsInt(); break;
 
         case TYPE_ENUM: {
-            const char* s = ty->AsEnumType()->Lookup(val->AsInt());
-
-            if ( s ) {
-                auto len = strlen(s);
-                lval->val.string_val.data = util::copy_string(s, len);
-                lval->val.string_val.length = len;
-            }
-
-            else {
-                auto err_msg = "enum type does not contain value:" + std::to_string(val->AsInt());
-                ty->Error(err_msg.c_str());
-                lval->val.string_val.data = util::copy_string("", 0);
-                lval->val.string_val.length = 0;
-            }
+            const char* s = enum_log_name(ty, val->AsInt());
+            auto len = strlen(s);
+            lval->val.string_val.data = util::copy_string(s, len);
+            lval->val.string_val.length = len;
             break;
         }
 
         case TYPE_COUNT: lval->val.uint_val = val->AsCount(); break;
 
-        case TYPE_PORT: {
-            auto p = val->AsCount();
-
-            auto pt = TRANSPORT_UNKNOWN;
-            auto pm = p & PORT_SPACE_MASK;
-            if ( pm == TCP_PORT_MASK )
-                pt = TRANSPORT_TCP;
-            else if ( pm == UDP_PORT_MASK )
-                pt = TRANSPORT_UDP;
-            else if ( pm == ICMP_PORT_MASK )
-                pt = TRANSPORT_ICMP;
-
-            lval->val.port_val.port = p & ~PORT_SPACE_MASK;
-            lval->val.port_val.proto = pt;
-            break;
-        }
+        case TYPE_PORT: lval->val.port_val = to_log_port(val->AsCount()); break;
 
         case TYPE_SUBNET: val->AsSubNet()->Get().ConvertToThreadingValue(&lval->val.subnet_val); break;
 
@@ -1517,7 +1538,102 @@ threading::Value* Manager::ValToLogVal(std::optional<ZVal>& val, Type* ty) {
     return lval;
 }
 
-threading::Value** Manager::RecordToFilterVals(const Stream* stream, Filter* filter, RecordVal* columns) {
+void Manager::ValToBatchCell(ZVal& val, Type* ty, RecordBatch* batch, RecordBatch::Cell* cell) {
+    // This mirrors ValToLogVal(), but stores into the batch's columns.
+    switch ( ty->Tag() ) {
+        case TYPE_BOOL:
+        case TYPE_INT: cell->int_val = val.AsInt(); break;
+
+        case TYPE_ENUM: {
+            const char* s = enum_log_name(ty, val.AsInt());
+            batch->SetString(cell, s, strlen(s));
+            break;
+        }
+
+        case TYPE_COUNT: cell->uint_val = val.AsCount(); break;
+
+        case TYPE_PORT: cell->port_val = to_log_port(val.AsCount()); break;
+
+        case TYPE_SUBNET: val.AsSubNet()->Get().ConvertToThreadingValue(&cell->subnet_val); break;
+
+        case TYPE_ADDR: val.AsAddr()->Get().ConvertToThreadingValue(&cell->addr_val); break;
+
+        case TYPE_DOUBLE:
+        case TYPE_TIME:
+        case TYPE_INTERVAL: cell->double_val = val.AsDouble(); break;
+
+        case TYPE_STRING: {
+            const String* s = val.AsString()->AsString();
+            batch->SetString(cell, reinterpret_cast<const char*>(s->Bytes()), s->Len());
+            break;
+        }
+
+        case TYPE_FILE: {
+            const char* s = val.AsFile()->Name();
+            batch->SetString(cell, s, strlen(s));
+            break;
+        }
+
+        case TYPE_FUNC: {
+            ODesc d;
+            val.AsFunc()->Describe(&d);
+            batch->SetString(cell, d.Description(), strlen(d.Description()));
+            break;
+        }
+
+        case TYPE_TABLE: {
+            auto tbl = val.AsTable();
+            auto set = tbl->ToPureListVal();
+
+            if ( ! set )
+                set = make_intrusive<ListVal>(TYPE_INT);
+
+            auto tbl_t = cast_intrusive<TableType>(tbl->GetType());
+            auto& set_t = tbl_t->GetIndexTypes()[0];
+            bool is_managed = ZVal::IsManagedType(set_t);
+
+            // Elements are atomic, so filling them in won't add further
+            // elements and invalidate the references.
+            auto span = batch->AddElements(set->Length());
+
+            for ( uint32_t i = 0; i < span.length; i++ ) {
+                ZVal s_i(set->Idx(i), set_t);
+                auto& e = batch->Element(span.offset + i);
+                e.present = true;
+                ValToBatchCell(s_i, set_t.get(), batch, &e);
+                if ( is_managed )
+                    ZVal::DeleteManagedType(s_i);
+            }
+
+            cell->span = span;
+            break;
+        }
+
+        case TYPE_VECTOR: {
+            VectorVal* vec = val.AsVector();
+            auto& vv = vec->RawVec();
+            auto& vt = vec->GetType()->Yield();
+
+            auto span = batch->AddElements(vec->Size());
+
+            for ( uint32_t i = 0; i < span.length; i++ ) {
+                if ( ! vv[i] )
+                    continue;
+
+                auto& e = batch->Element(span.offset + i);
+                e.present = true;
+                ValToBatchCell(*vv[i], vt.get(), batch, &e);
+            }
+
+            cell->span = span;
+            break;
+        }
+
+        default: reporter->InternalError("unsupported type %s for log_write", type_name(ty->Tag()));
+    }
+}
+
+RecordValPtr Manager::FilterExtensions(Filter* filter) {
     RecordValPtr ext_rec;
 
     if ( filter->num_ext_fields > 0 ) {
@@ -1527,50 +1643,75 @@ threading::Value** Manager::RecordToFilterVals(const Stream* stream, Filter* fil
             ext_rec = {AdoptRef{}, res.release()->AsRecordVal()};
     }
 
-    threading::Value** vals = new threading::Value*[filter->num_fields];
+    return ext_rec;
+}
 
-    for ( int i = 0; i < filter->num_fields; ++i ) {
-        std::optional<ZVal> val;
-        Type* vt;
-        if ( i < filter->num_ext_fields ) {
-            if ( ! ext_rec ) {
-                // executing function did not return record. Send empty for all vals.
-                vals[i] = new threading::Value(filter->fields[i]->type, false);
-                continue;
-            }
+std::optional<ZVal> Manager::FilterFieldVal(Filter* filter, int i, RecordVal* columns, RecordVal* ext_rec, Type** vt) {
+    std::optional<ZVal> val;
 
-            val = ZVal(ext_rec.get());
-            vt = ext_rec->GetType().get();
-        }
-        else {
-            val = ZVal(columns);
-            vt = columns->GetType().get();
-        }
+    if ( i < filter->num_ext_fields ) {
+        if ( ! ext_rec )
+            // executing function did not return record. Send empty for all vals.
+            return std::nullopt;
 
-        // For each field, first find the right value, which can
-        // potentially be nested inside other records.
-        list<int>& indices = filter->indices[i];
+        val = ZVal(ext_rec);
+        *vt = ext_rec->GetType().get();
+    }
+    else {
+        val = ZVal(columns);
+        *vt = columns->GetType().get();
+    }
 
-        for ( list<int>::iterator j = indices.begin(); j != indices.end(); ++j ) {
-            auto vr = val->AsRecord();
-            val = vr->RawOptField(*j);
+    // For each field, first find the right value, which can
+    // potentially be nested inside other records.
+    list<int>& indices = filter->indices[i];
 
-            if ( ! val ) {
-                // Value, or any of its parents, is not set.
-                vals[i] = new threading::Value(filter->fields[i]->type, false);
-                break;
-            }
+    for ( list<int>::iterator j = indices.begin(); j != indices.end(); ++j ) {
+        auto vr = val->AsRecord();
+        val = vr->RawOptField(*j);
 
-            vt = cast_intrusive<RecordType>(vr->GetType())->GetFieldType(*j).get();
-        }
+        if ( ! val )
+            // Value, or any of its parents, is not set.
+            return std::nullopt;
+
+        *vt = cast_intrusive<RecordType>(vr->GetType())->GetFieldType(*j).get();
+    }
+
+    return val;
+}
+
+threading::Value** Manager::RecordToFilterVals(const Stream* stream, Filter* filter, RecordVal* columns) {
+    RecordValPtr ext_rec = FilterExtensions(filter);
+
+    threading::Value** vals = new threading::Value*[filter->num_fields];
+
+    for ( int i = 0; i < filter->num_fields; ++i ) {
+        Type* vt = nullptr;
+        std::optional<ZVal> val = FilterFieldVal(filter, i, columns, ext_rec.get(), &vt);
 
         if ( val )
             vals[i] = ValToLogVal(val, vt);
+        else
+            vals[i] = new threading::Value(filter->fields[i]->type, false);
     }
 
     return vals;
 }
 
+void Manager::RecordToBatch(const Stream* stream, Filter* filter, RecordVal* columns, RecordBatch* batch) {
+    RecordValPtr ext_rec = FilterExtensions(filter);
+
+    batch->AddRow();
+
+    for ( int i = 0; i < filter->num_fields; ++i ) {
+        Type* vt = nullptr;
+        std::optional<ZVal> val = FilterFieldVal(filter, i, columns, ext_rec.get(), &vt);
+
+        if ( val )
+            ValToBatchCell(*val, vt, batch, &batch->Set(i));
+    }
+}
+
 bool Manager::CreateWriterForRemoteLog(EnumVal* id, EnumVal* writer, WriterBackend::WriterInfo* info, int num_fields,
                                        const threading::Field* const* fields) {
     return CreateWriter(id, writer, info, num_fields, fields, true, false, true);
@@ -377,8 +377,12 @@ private:
                         const std::string& path, const std::list<int>& indices);
 
     threading::Value** RecordToFilterVals(const Stream* stream, Filter* filter, RecordVal* columns);
+    void RecordToBatch(const Stream* stream, Filter* filter, RecordVal* columns, RecordBatch* batch);
+    RecordValPtr FilterExtensions(Filter* filter);
+    std::optional<ZVal> FilterFieldVal(Filter* filter, int i, RecordVal* columns, RecordVal* ext_rec, Type** vt);
 
     threading::Value* ValToLogVal(std::optional<ZVal>& val, Type* ty);
+    void ValToBatchCell(ZVal& val, Type* ty, RecordBatch* batch, RecordBatch::Cell* cell);
     Stream* FindStream(EnumVal* id);
     void RemoveDisabledWriters(Stream* stream);
     void InstallRotationTimer(WriterInfo* winfo);
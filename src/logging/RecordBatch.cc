@@ -0,0 +1,299 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/logging/RecordBatch.h"
+
+#include <cstring>
+
+#include "zeek/3rdparty/doctest.h"
+#include "zeek/Reporter.h"
+
+using zeek::threading::Field;
+using zeek::threading::Value;
+
+namespace zeek::logging {
+
+RecordBatch::RecordBatch(int num_fields, const Field* const* fields, int expected_rows) {
+    types.reserve(num_fields);
+    subtypes.reserve(num_fields);
+    columns.resize(num_fields);
+
+    for ( int i = 0; i < num_fields; ++i ) {
+        types.push_back(fields[i]->type);
+        subtypes.push_back(fields[i]->subtype);
+        columns[i].reserve(expected_rows);
+    }
+}
+
+void RecordBatch::AddRow() {
+    Cell unset;
+    memset(&unset, 0, sizeof(unset));
+
+    for ( auto& col : columns )
+        col.push_back(unset);
+
+    ++num_rows;
+}
+
+bool RecordBatch::AddRow(Value** vals) {
+    for ( int i = 0; i < NumFields(); ++i ) {
+        if ( vals[i]->type != types[i] )
+            return false;
+
+        if ( ! vals[i]->present || (types[i] != TYPE_TABLE && types[i] != TYPE_VECTOR) )
+            continue;
+
+        const auto& s = types[i] == TYPE_TABLE ? vals[i]->val.set_val : vals[i]->val.vector_val;
+
+        for ( zeek_int_t j = 0; j < s.size; ++j ) {
+            if ( s.vals[j]->type != subtypes[i] )
+                return false;
+        }
+    }
+
+    AddRow();
+
+    for ( int i = 0; i < NumFields(); ++i ) {
+        if ( vals[i]->present )
+            SetFromValue(&Set(i), vals[i]);
+    }
+
+    return true;
+}
+
+RecordBatch::Span RecordBatch::AddElements(size_t n) {
+    Span s{static_cast<uint32_t>(elements.size()), static_cast<uint32_t>(n)};
+
+    Cell unset;
+    memset(&unset, 0, sizeof(unset));
+    elements.resize(elements.size() + n, unset);
+
+    return s;
+}
+
+RecordBatch::Span RecordBatch::AddData(const char* s, size_t len) {
+    Span span{static_cast<uint32_t>(data.size()), static_cast<uint32_t>(len)};
+    data.insert(data.end(), s, s + len);
+    return span;
+}
+
+void RecordBatch::SetFromValue(Cell* c, const Value* v) {
+    switch ( v->type ) {
+        case TYPE_BOOL:
+        case TYPE_INT: c->int_val = v->val.int_val; break;
+
+        case TYPE_COUNT: c->uint_val = v->val.uint_val; break;
+
+        case TYPE_PORT: c->port_val = v->val.port_val; break;
+
+        case TYPE_SUBNET: c->subnet_val = v->val.subnet_val; break;
+
+        case TYPE_ADDR: c->addr_val = v->val.addr_val; break;
+
+        case TYPE_DOUBLE:
+        case TYPE_TIME:
+        case TYPE_INTERVAL: c->double_val = v->val.double_val; break;
+
+        case TYPE_ENUM:
+        case TYPE_STRING:
+        case TYPE_FILE:
+        case TYPE_FUNC: SetString(c, v->val.string_val.data, v->val.string_val.length); break;
+
+        case TYPE_PATTERN: {
+            // Keep the terminating null so that the adapter can hand out
+            // the text directly.
+            auto len = strlen(v->val.pattern_text_val);
+            c->span = AddData(v->val.pattern_text_val, len + 1);
+            c->span.length = len;
+            break;
+        }
+
+        case TYPE_TABLE:
+        case TYPE_VECTOR: {
+            const auto& s = v->type == TYPE_TABLE ? v->val.set_val : v->val.vector_val;
+            auto span = AddElements(s.size);
+
+            for ( zeek_int_t i = 0; i < s.size; ++i ) {
+                Cell& e = elements[span.offset + i];
+                e.present = s.vals[i]->present;
+
+                if ( e.present )
+                    SetFromValue(&e, s.vals[i]);
+            }
+
+            c->span = span;
+            break;
+        }
+
+        default: reporter->InternalError("unsupported type %s in RecordBatch", type_name(v->type));
+    }
+}
+
+RecordBatchRowAdapter::RecordBatchRowAdapter(int arg_num_fields)
+    : num_fields(arg_num_fields),
+      vals(new Value[arg_num_fields]),
+      val_ptrs(new Value*[arg_num_fields]) {
+    for ( int i = 0; i < num_fields; ++i )
+        val_ptrs[i] = &vals[i];
+}
+
+RecordBatchRowAdapter::~RecordBatchRowAdapter() {
+    // The values don't own what they point to.
+    for ( int i = 0; i < num_fields; ++i )
+        vals[i].present = false;
+
+    for ( auto& e : elements )
+        e->present = false;
+}
+
+threading::Value** RecordBatchRowAdapter::Row(const RecordBatch& batch, int row) {
+    // Make sure we have enough element values for all of the row's
+    // containers before handing out pointers to them.
+    size_t num_elements = 0;
+
+    for ( int i = 0; i < num_fields; ++i ) {
+        auto t = batch.Type(i);
+        const auto& c = batch.Get(row, i);
+
+        if ( c.present && (t == TYPE_TABLE || t == TYPE_VECTOR) )
+            num_elements += c.span.length;
+    }
+
+    while ( elements.size() < num_elements ) {
+        elements.emplace_back(new Value(TYPE_VOID, false));
+        element_ptrs.push_back(elements.back().get());
+    }
+
+    size_t next_element = 0;
+
+    for ( int i = 0; i < num_fields; ++i ) {
+        Value* v = &vals[i];
+        const auto& c = batch.Get(row, i);
+
+        v->type = batch.Type(i);
+        v->subtype = batch.Subtype(i);
+        v->present = c.present;
+
+        if ( ! c.present )
+            continue;
+
+        if ( v->type != TYPE_TABLE && v->type != TYPE_VECTOR ) {
+            Fill(v, v->type, c, batch);
+            continue;
+        }
+
+        const auto* es = batch.Elements(c);
+
+        for ( uint32_t j = 0; j < c.span.length; ++j ) {
+            Value* e = element_ptrs[next_element + j];
+            e->type = v->subtype;
+            e->present = es[j].present;
+
+            if ( e->present )
+                Fill(e, e->type, es[j], batch);
+        }
+
+        auto& s = v->type == TYPE_TABLE ? v->val.set_val : v->val.vector_val;
+        s.size = c.span.length;
+        s.vals = element_ptrs.data() + next_element;
+        next_element += c.span.length;
+    }
+
+    return val_ptrs.get();
+}
+
+void RecordBatchRowAdapter::Fill(Value* v, TypeTag type, const RecordBatch::Cell& c, const RecordBatch& batch) {
+    switch ( type ) {
+        case TYPE_BOOL:
+        case TYPE_INT: v->val.int_val = c.int_val; break;
+
+        case TYPE_COUNT: v->val.uint_val = c.uint_val; break;
+
+        case TYPE_PORT: v->val.port_val = c.port_val; break;
+
+        case TYPE_SUBNET: v->val.subnet_val = c.subnet_val; break;
+
+        case TYPE_ADDR: v->val.addr_val = c.addr_val; break;
+
+        case TYPE_DOUBLE:
+        case TYPE_TIME:
+        case TYPE_INTERVAL: v->val.double_val = c.double_val; break;
+
+        case TYPE_ENUM:
+        case TYPE_STRING:
+        case TYPE_FILE:
+        case TYPE_FUNC:
+            v->val.string_val.data = const_cast<char*>(batch.Data(c));
+            v->val.string_val.length = static_cast<int>(c.span.length);
+            break;
+
+        case TYPE_PATTERN: v->val.pattern_text_val = batch.Data(c); break;
+
+        default: reporter->InternalError("unsupported type %s in RecordBatchRowAdapter", type_name(type));
+    }
+}
+
+TEST_SUITE_BEGIN("RecordBatch");
+
+TEST_CASE("record batch row round trip") {
+    Field f0("count", nullptr, TYPE_COUNT, TYPE_VOID, false);
+    Field f1("str", nullptr, TYPE_STRING, TYPE_VOID, true);
+    Field f2("vec", nullptr, TYPE_VECTOR, TYPE_STRING, true);
+    const Field* fields[] = {&f0, &f1, &f2};
+
+    RecordBatch batch(3, fields, 4);
+
+    for ( int r = 0; r < 3; ++r ) {
+        auto vals = new Value*[3];
+        vals[0] = new Value(TYPE_COUNT);
+        vals[0]->val.uint_val = r;
+
+        vals[1] = new Value(TYPE_STRING, r != 1);
+        if ( r != 1 ) {
+            vals[1]->val.string_val.data = util::copy_string("abc", 3);
+            vals[1]->val.string_val.length = 3 - r;
+        }
+
+        vals[2] = new Value(TYPE_VECTOR, TYPE_STRING);
+        vals[2]->val.vector_val.size = r;
+        vals[2]->val.vector_val.vals = new Value*[r];
+        for ( int i = 0; i < r; ++i ) {
+            vals[2]->val.vector_val.vals[i] = new Value(TYPE_STRING);
+            vals[2]->val.vector_val.vals[i]->val.string_val.data = util::copy_string("x", 1);
+            vals[2]->val.vector_val.vals[i]->val.string_val.length = 1;
+        }
+
+        CHECK(batch.AddRow(vals));
+        Value::delete_value_ptr_array(vals, 3);
+    }
+
+    auto bad = new Value*[3];
+    bad[0] = new Value(TYPE_INT);
+    bad[1] = new Value(TYPE_STRING, false);
+    bad[2] = new Value(TYPE_VECTOR, TYPE_STRING, false);
+    CHECK_FALSE(batch.AddRow(bad));
+    Value::delete_value_ptr_array(bad, 3);
+
+    REQUIRE(batch.NumRows() == 3);
+    CHECK(batch.DataSize() == 3 + 1 + 1 + 2);
+
+    RecordBatchRowAdapter adapter(3);
+
+    for ( int r = 0; r < 3; ++r ) {
+        Value** row = adapter.Row(batch, r);
+        CHECK(row[0]->type == TYPE_COUNT);
+        CHECK(row[0]->val.uint_val == static_cast<zeek_uint_t>(r));
+        CHECK(row[1]->present == (r != 1));
+        if ( r != 1 )
+            CHECK(std::string(row[1]->val.string_val.data, row[1]->val.string_val.length) ==
+                  std::string("abc", 3 - r));
+
+        CHECK(row[2]->subtype == TYPE_STRING);
+        REQUIRE(row[2]->val.vector_val.size == r);
+        for ( int i = 0; i < r; ++i )
+            CHECK(std::string(row[2]->val.vector_val.vals[i]->val.string_val.data, 1) == "x");
+    }
+}
+
+TEST_SUITE_END();
+
+} // namespace zeek::logging
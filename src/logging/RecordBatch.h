@@ -0,0 +1,192 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "zeek/threading/SerialTypes.h"
+
+namespace zeek::logging {
+
+/**
+ * A batch of log records in columnar form, as passed from a WriterFrontend
+ * to its WriterBackend.
+ *
+ * Each log field has a column of fixed-size cells, one per row. Strings
+ * (as well as enum names, file names, function descriptions and pattern
+ * texts) are appended to a single contiguous data buffer, and cells refer
+ * to them by offset and length. The elements of sets and vectors likewise
+ * go into one shared element array. Logging doesn't support nested
+ * containers, so elements are always atomic.
+ *
+ * A batch is built by the main thread and then handed over to the writer
+ * thread, which only reads it. Appending may reallocate the storage, so
+ * references to cells and data are only valid until the next append.
+ */
+class RecordBatch {
+public:
+    /**
+     * A range inside the data buffer or the element array.
+     */
+    struct Span {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    /**
+     * A single value. Which member is valid depends on the field's type,
+     * following the same rules as threading::Value. Strings, patterns,
+     * sets and vectors use \a span.
+     */
+    struct Cell {
+        union {
+            zeek_int_t int_val;
+            zeek_uint_t uint_val;
+            threading::Value::port_t port_val;
+            double double_val;
+            threading::Value::addr_t addr_val;
+            threading::Value::subnet_t subnet_val;
+            Span span;
+        };
+
+        bool present; //! False for optional fields that are not set.
+    };
+
+    /**
+     * Constructor.
+     *
+     * @param num_fields The number of log fields.
+     *
+     * @param fields The log fields. The batch only copies their types.
+     *
+     * @param expected_rows The number of rows to reserve space for.
+     */
+    RecordBatch(int num_fields, const threading::Field* const* fields, int expected_rows);
+
+    /**
+     * Returns the number of fields per row.
+     */
+    int NumFields() const { return static_cast<int>(columns.size()); }
+
+    /**
+     * Returns the number of rows.
+     */
+    int NumRows() const { return num_rows; }
+
+    /**
+     * Returns the number of bytes in the data buffer.
+     */
+    size_t DataSize() const { return data.size(); }
+
+    /**
+     * Returns the type of a field.
+     */
+    TypeTag Type(int field) const { return types[field]; }
+
+    /**
+     * Returns the element type of a set or vector field.
+     */
+    TypeTag Subtype(int field) const { return subtypes[field]; }
+
+    /**
+     * Appends a row with all fields unset. Fill it in with Set().
+     */
+    void AddRow();
+
+    /**
+     * Appends a row converted from an array of values. Does not take
+     * ownership of \a vals.
+     *
+     * @return False if the values' types don't match the batch's fields,
+     * in which case nothing gets appended.
+     */
+    bool AddRow(threading::Value** vals);
+
+    /**
+     * Marks a field of the last row as present and returns its cell for
+     * filling in.
+     */
+    Cell& Set(int field) {
+        Cell& c = columns[field][num_rows - 1];
+        c.present = true;
+        return c;
+    }
+
+    /**
+     * Copies a string into the data buffer and points a cell to it.
+     */
+    void SetString(Cell* c, const char* s, size_t len) { c->span = AddData(s, len); }
+
+    /**
+     * Appends unset elements for a set or vector.
+     *
+     * @return The span to store in the container's cell.
+     */
+    Span AddElements(size_t n);
+
+    /**
+     * Returns an element for filling in. Note that AddElements() may
+     * invalidate the reference.
+     */
+    Cell& Element(uint32_t idx) { return elements[idx]; }
+
+    /**
+     * Returns a field's cell.
+     */
+    const Cell& Get(int row, int field) const { return columns[field][row]; }
+
+    /**
+     * Returns the elements of a set or vector cell.
+     */
+    const Cell* Elements(const Cell& c) const { return elements.data() + c.span.offset; }
+
+    /**
+     * Returns the data that a string cell refers to. The data is not
+     * null-terminated, except for patterns.
+     */
+    const char* Data(const Cell& c) const { return c.span.length ? data.data() + c.span.offset : ""; }
+
+private:
+    Span AddData(const char* s, size_t len);
+    void SetFromValue(Cell* c, const threading::Value* v);
+
+    int num_rows = 0;
+    std::vector<TypeTag> types;
+    std::vector<TypeTag> subtypes;
+    std::vector<std::vector<Cell>> columns;
+    std::vector<Cell> elements;
+    std::vector<char> data;
+};
+
+/**
+ * Presents the rows of a RecordBatch as arrays of threading::Value, for
+ * writers that only implement WriterBackend::DoWrite(). The values point
+ * into the batch's storage and are reused from one row to the next, so
+ * they remain valid only until the next call to Row().
+ */
+class RecordBatchRowAdapter {
+public:
+    explicit RecordBatchRowAdapter(int num_fields);
+    ~RecordBatchRowAdapter();
+
+    RecordBatchRowAdapter(const RecordBatchRowAdapter&) = delete;
+    RecordBatchRowAdapter& operator=(const RecordBatchRowAdapter&) = delete;
+
+    /**
+     * Returns the values of one row of a batch.
+     */
+    threading::Value** Row(const RecordBatch& batch, int row);
+
+private:
+    void Fill(threading::Value* v, TypeTag type, const RecordBatch::Cell& c, const RecordBatch& batch);
+
+    int num_fields;
+    std::unique_ptr<threading::Value[]> vals;
+    std::unique_ptr<threading::Value*[]> val_ptrs;
+    std::vector<std::unique_ptr<threading::Value>> elements;
+    std::vector<threading::Value*> element_ptrs;
+};
+
+} // namespace zeek::logging
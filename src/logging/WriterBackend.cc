@@ -231,6 +231,44 @@ bool WriterBackend::Write(int arg_num_fields, int num_writes, Value*** vals) {
     return success;
 }
 
+bool WriterBackend::WriteBatch(RecordBatch* batch) {
+    if ( batch->NumFields() != num_fields ) {
+#ifdef DEBUG
+        const char* msg = Fmt("Number of fields don't match in WriterBackend::WriteBatch() (%d vs. %d)",
+                              batch->NumFields(), num_fields);
+        Debug(DBG_LOGGING, msg);
+#endif
+
+        delete batch;
+        DisableFrontend();
+        return false;
+    }
+
+    bool success = true;
+
+    if ( ! Failed() )
+        success = DoWriteBatch(*batch);
+
+    delete batch;
+
+    if ( ! success )
+        DisableFrontend();
+
+    return success;
+}
+
+bool WriterBackend::DoWriteBatch(const RecordBatch& batch) {
+    if ( ! row_adapter )
+        row_adapter = std::make_unique<RecordBatchRowAdapter>(num_fields);
+
+    for ( int j = 0; j < batch.NumRows(); j++ ) {
+        if ( ! DoWrite(num_fields, fields, row_adapter->Row(batch, j)) )
+            return false;
+    }
+
+    return true;
+}
+
 bool WriterBackend::SetBuf(bool enabled) {
     if ( enabled == buffering )
         // No change.
@@ -4,7 +4,10 @@
 
 #pragma once
 
+#include <memory>
+
 #include "zeek/logging/Component.h"
+#include "zeek/logging/RecordBatch.h"
 #include "zeek/threading/MsgThread.h"
 
 namespace broker {
@@ -153,6 +156,16 @@ public:
      */
     bool Write(int num_fields, int num_writes, threading::Value*** vals);
 
+    /**
+     * Writes a batch of log entries.
+     *
+     * @param batch The entries. Their fields must match what was passed
+     * to Init(). The method takes ownership of \a batch.
+     *
+     * @return False if an error occurred.
+     */
+    bool WriteBatch(RecordBatch* batch);
+
     /**
      * Sets the buffering status for the writer, assuming the writer
      * supports that. (If not, it will be ignored).
@@ -281,6 +294,17 @@ protected:
      */
     virtual bool DoWrite(int num_fields, const threading::Field* const* fields, threading::Value** vals) = 0;
 
+    /**
+     * Writer-specific output method implementing recording of a batch of
+     * log entries in columnar form.
+     *
+     * A writer implementation may override this method to process all
+     * entries of a batch at once. The default implementation passes
+     * each entry on to DoWrite(), with values that point directly into
+     * the batch. The same error semantics as for DoWrite() apply.
+     */
+    virtual bool DoWriteBatch(const RecordBatch& batch);
+
     /**
      * Writer-specific method implementing a change of the buffering
      * state.  If buffering is disabled, the writer should attempt to
@@ -385,6 +409,9 @@ private:
     bool buffering;                        // True if buffering is enabled.
 
     int rotation_counter; // Tracks FinishedRotation() calls.
+
+    // Presents batches to DoWrite(); created on first use.
+    std::unique_ptr<RecordBatchRowAdapter> row_adapter;
 };
 
 } // namespace zeek::logging
@@ -48,20 +48,15 @@ private:
     const bool terminating;
 };
 
-class WriteMessage final : public threading::InputMessage<WriterBackend> {
+class WriteBatchMessage final : public threading::InputMessage<WriterBackend> {
 public:
-    WriteMessage(WriterBackend* backend, int num_fields, int num_writes, Value*** vals)
-        : threading::InputMessage<WriterBackend>("Write", backend),
-          num_fields(num_fields),
-          num_writes(num_writes),
-          vals(vals) {}
+    WriteBatchMessage(WriterBackend* backend, RecordBatch* batch)
+        : threading::InputMessage<WriterBackend>("WriteBatch", backend), batch(batch) {}
 
-    bool Process() override { return Object()->Write(num_fields, num_writes, vals); }
+    bool Process() override { return Object()->WriteBatch(batch); }
 
 private:
-    int num_fields;
-    int num_writes;
-    Value*** vals;
+    RecordBatch* batch;
 };
 
 class SetBufMessage final : public threading::InputMessage<WriterBackend> {
@@ -99,8 +94,7 @@ WriterFrontend::WriterFrontend(const WriterBackend::WriterInfo& arg_info, EnumVa
     buf = true;
     local = arg_local;
     remote = arg_remote;
-    write_buffer = nullptr;
-    write_buffer_pos = 0;
+    write_batch = nullptr;
     info = new WriterBackend::WriterInfo(arg_info);
 
     num_fields = 0;
@@ -195,15 +189,37 @@ void WriterFrontend::Write(int arg_num_fields, Value** vals) {
         return;
     }
 
-    if ( ! write_buffer ) {
-        // Need new buffer.
-        write_buffer = new Value**[WRITER_BUFFER_SIZE];
-        write_buffer_pos = 0;
+    if ( ! write_batch )
+        write_batch = new RecordBatch(num_fields, fields, WRITER_BUFFER_SIZE);
+
+    if ( ! write_batch->AddRow(vals) ) {
+        reporter->Warning("WriterFrontend %s got mismatching field types in write. Skipping line.", name);
+        DeleteVals(arg_num_fields, vals);
+        return;
+    }
+
+    DeleteVals(arg_num_fields, vals);
+    FinishWrite();
+}
+
+RecordBatch* WriterFrontend::BatchForWrite(int arg_num_fields, const Field* const* arg_fields) {
+    if ( disabled || ! initialized || remote || ! backend || arg_num_fields != num_fields )
+        return nullptr;
+
+    for ( int i = 0; i < num_fields; ++i ) {
+        if ( arg_fields[i]->type != fields[i]->type || arg_fields[i]->subtype != fields[i]->subtype )
+            return nullptr;
     }
 
-    write_buffer[write_buffer_pos++] = vals;
+    if ( ! write_batch )
+        write_batch = new RecordBatch(num_fields, fields, WRITER_BUFFER_SIZE);
+
+    return write_batch;
+}
 
-    if ( write_buffer_pos >= WRITER_BUFFER_SIZE || ! buf || run_state::terminating )
+void WriterFrontend::FinishWrite() {
+    if ( write_batch->NumRows() >= WRITER_BUFFER_SIZE || write_batch->DataSize() >= WRITER_BUFFER_DATA_SIZE || ! buf ||
+         run_state::terminating )
         // Buffer full (or no buffering desired or terminating).
         FlushWriteBuffer();
 }
@@ -214,16 +230,17 @@ void WriterFrontend::FlushWriteBuffer() {
         return;
     }
 
-    if ( ! write_buffer_pos )
+    if ( ! write_batch )
         // Nothing to do.
         return;
 
     if ( backend )
-        backend->SendIn(new WriteMessage(backend, num_fields, write_buffer_pos, write_buffer));
+        backend->SendIn(new WriteBatchMessage(backend, write_batch));
+    else
+        delete write_batch;
 
     // Clear buffer (no delete, we pass ownership to child thread.)
-    write_buffer = nullptr;
-    write_buffer_pos = 0;
+    write_batch = nullptr;
 }
 
 void WriterFrontend::SetBuf(bool enabled) {
@@ -272,15 +289,8 @@ void WriterFrontend::DeleteVals(int num_fields, Value** vals) {
 }
 
 void WriterFrontend::CleanupWriteBuffer() {
-    if ( ! write_buffer || write_buffer_pos == 0 )
-        return;
-
-    for ( int j = 0; j < write_buffer_pos; j++ )
-        DeleteVals(num_fields, write_buffer[j]);
-
-    delete[] write_buffer;
-    write_buffer = nullptr;
-    write_buffer_pos = 0;
+    delete write_batch;
+    write_batch = nullptr;
 }
 
 } // namespace zeek::logging
@@ -92,6 +92,27 @@ public:
      */
     void Write(int num_fields, threading::Value** vals);
 
+    /**
+     * Returns the batch that the next record can be appended to directly,
+     * avoiding the conversion into threading::Value instances that
+     * Write() requires. After appending a row, the caller must call
+     * FinishBatchWrite().
+     *
+     * Returns null if the record needs to go through Write() instead,
+     * for example because the frontend also forwards it remotely, or
+     * because the given fields don't match the writer's.
+     *
+     * This method must only be called from the main thread.
+     */
+    RecordBatch* BatchForWrite(int num_fields, const threading::Field* const* fields);
+
+    /**
+     * Completes a write started with BatchForWrite().
+     *
+     * This method must only be called from the main thread.
+     */
+    void FinishBatchWrite() { FinishWrite(); }
+
     /**
      * Sets the buffering state.
      *
@@ -202,13 +223,15 @@ protected:
     int num_fields;                        // The number of log fields.
     const threading::Field* const* fields; // The log fields.
 
-    // Buffer for bulk writes.
+    // Buffer for bulk writes. We send it over once it holds
+    // WRITER_BUFFER_SIZE rows or WRITER_BUFFER_DATA_SIZE bytes of strings.
     static const int WRITER_BUFFER_SIZE = 1000;
-    int write_buffer_pos;             // Position of next write in buffer.
-    threading::Value*** write_buffer; // Buffer of size WRITER_BUFFER_SIZE.
+    static const size_t WRITER_BUFFER_DATA_SIZE = 16 * 1024 * 1024;
+    RecordBatch* write_batch; // Null if nothing is buffered.
 
 private:
     void CleanupWriteBuffer();
+    void FinishWrite();
 };
 
 } // namespace zeek::logging
@@ -0,0 +1,487 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/logging/writers/parquet/Parquet.h"
+
+#include <arrow/util/compression.h>
+#include <parquet/properties.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include "zeek/ID.h"
+#include "zeek/Val.h"
+#include "zeek/logging/writers/parquet/parquet.bif.h"
+#include "zeek/threading/Formatter.h"
+#include "zeek/threading/SerialTypes.h"
+#include "zeek/util.h"
+
+using namespace std;
+using zeek::threading::Field;
+using zeek::threading::Formatter;
+using zeek::threading::Value;
+
+namespace zeek::logging::writer::detail {
+
+Parquet::Parquet(WriterFrontend* frontend) : WriterBackend(frontend) {
+    row_group_size = BifConst::LogParquet::row_group_size;
+    compression.assign((const char*)BifConst::LogParquet::compression->Bytes(),
+                       BifConst::LogParquet::compression->Len());
+    use_dictionary = BifConst::LogParquet::use_dictionary;
+    nest_records = BifConst::LogParquet::nest_records;
+    pending_rows = 0;
+
+    logdir = zeek::id::find_const<StringVal>("Log::default_logdir")->ToStdString();
+
+    init_options = InitFilterOptions();
+}
+
+Parquet::~Parquet() {
+    // DoFinish() normally closes the file already.
+    if ( file_writer )
+        CloseFile();
+}
+
+bool Parquet::InitFilterOptions() {
+    const WriterInfo& info = Info();
+
+    // Set per-filter configuration options.
+    for ( WriterInfo::config_map::const_iterator i = info.config.begin(); i != info.config.end(); ++i ) {
+        if ( strcmp(i->first, "row_group_size") == 0 ) {
+            row_group_size = strtoull(i->second, nullptr, 10);
+
+            if ( row_group_size == 0 ) {
+                Error("invalid value for 'row_group_size', must be a positive number");
+                return false;
+            }
+        }
+
+        else if ( strcmp(i->first, "compression") == 0 )
+            compression.assign(i->second);
+
+        else if ( strcmp(i->first, "use_dictionary") == 0 ) {
+            if ( strcmp(i->second, "T") == 0 )
+                use_dictionary = true;
+            else if ( strcmp(i->second, "F") == 0 )
+                use_dictionary = false;
+            else {
+                Error("invalid value for 'use_dictionary', must be a string and either \"T\" or \"F\"");
+                return false;
+            }
+        }
+
+        else if ( strcmp(i->first, "nest_records") == 0 ) {
+            if ( strcmp(i->second, "T") == 0 )
+                nest_records = true;
+            else if ( strcmp(i->second, "F") == 0 )
+                nest_records = false;
+            else {
+                Error("invalid value for 'nest_records', must be a string and either \"T\" or \"F\"");
+                return false;
+            }
+        }
+    }
+
+    auto codec = arrow::util::Codec::GetCompressionType(compression);
+
+    if ( ! codec.ok() || ! arrow::util::Codec::IsAvailable(*codec) ) {
+        Error(Fmt("unsupported compression codec '%s'", compression.c_str()));
+        return false;
+    }
+
+    return true;
+}
+
+void Parquet::BuildColumns(int num_fields, const Field* const* fields) {
+    columns.clear();
+
+    for ( int i = 0; i < num_fields; ++i ) {
+        std::vector<std::unique_ptr<Column>>* siblings = &columns;
+        std::string name = fields[i]->name;
+        size_t pos;
+
+        // Descend into (or create) a struct column for each dotted
+        // prefix of the name.
+        while ( nest_records && (pos = name.find('.')) != std::string::npos ) {
+            std::string prefix = name.substr(0, pos);
+            Column* parent = nullptr;
+
+            for ( auto& c : *siblings ) {
+                if ( c->name == prefix )
+                    parent = c.get();
+            }
+
+            if ( parent && parent->field >= 0 ) {
+                // A struct column collides with a leaf, e.g., when logging
+                // both "id" and "id.orig_h". Fall back to flat columns.
+                nest_records = false;
+                BuildColumns(num_fields, fields);
+                return;
+            }
+
+            if ( ! parent ) {
+                siblings->emplace_back(new Column);
+                parent = siblings->back().get();
+                parent->name = prefix;
+            }
+
+            siblings = &parent->children;
+            name = name.substr(pos + 1);
+        }
+
+        for ( auto& c : *siblings ) {
+            if ( c->name == name ) {
+                // Same as above, the other way round.
+                nest_records = false;
+                BuildColumns(num_fields, fields);
+                return;
+            }
+        }
+
+        siblings->emplace_back(new Column);
+        siblings->back()->name = name;
+        siblings->back()->field = i;
+    }
+}
+
+std::shared_ptr<arrow::DataType> Parquet::LeafType(TypeTag type, TypeTag subtype) {
+    switch ( type ) {
+        case TYPE_BOOL: return arrow::boolean();
+
+        case TYPE_INT: return arrow::int64();
+
+        case TYPE_COUNT: return arrow::uint64();
+
+        case TYPE_PORT:
+            // Like the ASCII writer, we record only the port number.
+            return arrow::uint16();
+
+        case TYPE_SUBNET:
+        case TYPE_ADDR:
+            // Parquet doesn't have a type for IP addresses.
+            return arrow::utf8();
+
+        case TYPE_TIME: return arrow::timestamp(arrow::TimeUnit::MICRO, "UTC");
+
+        case TYPE_INTERVAL:
+        case TYPE_DOUBLE: return arrow::float64();
+
+        case TYPE_ENUM:
+        case TYPE_STRING:
+        case TYPE_FILE:
+        case TYPE_FUNC: return arrow::utf8();
+
+        case TYPE_TABLE:
+        case TYPE_VECTOR: return arrow::list(LeafType(subtype, TYPE_VOID));
+
+        default: return nullptr;
+    }
+}
+
+std::shared_ptr<arrow::DataType> Parquet::ArrowType(const Column& col, const Field* const* fields) {
+    if ( col.field >= 0 )
+        return LeafType(fields[col.field]->type, fields[col.field]->subtype);
+
+    arrow::FieldVector children;
+
+    for ( const auto& c : col.children ) {
+        auto t = ArrowType(*c, fields);
+
+        if ( ! t )
+            return nullptr;
+
+        children.push_back(arrow::field(c->name, t));
+    }
+
+    return arrow::struct_(children);
+}
+
+void Parquet::CollectBuilders(const Column& col, arrow::ArrayBuilder* builder) {
+    if ( col.field >= 0 ) {
+        field_builders[col.field] = builder;
+        return;
+    }
+
+    auto sb = static_cast<arrow::StructBuilder*>(builder);
+    struct_builders.push_back(sb);
+
+    for ( size_t i = 0; i < col.children.size(); ++i )
+        CollectBuilders(*col.children[i], sb->field_builder(static_cast<int>(i)));
+}
+
+bool Parquet::CheckStatus(const arrow::Status& st) {
+    if ( st.ok() )
+        return true;
+
+    Error(Fmt("Parquet error on %s: %s", fname.c_str(), st.ToString().c_str()));
+    return false;
+}
+
+bool Parquet::DoInit(const WriterInfo& info, int num_fields, const Field* const* fields) {
+    if ( ! init_options )
+        return false;
+
+    fname = info.path;
+
+    if ( fname.find("/dev/") == 0 ) {
+        Error(Fmt("Parquet writer cannot write to special file %s", fname.c_str()));
+        return false;
+    }
+
+    if ( fname.front() != '/' && ! logdir.empty() )
+        fname = (zeek::filesystem::path(logdir) / fname).string();
+
+    fname += "." + LogExt();
+
+    if ( ! schema ) {
+        BuildColumns(num_fields, fields);
+
+        arrow::FieldVector schema_fields;
+
+        for ( const auto& c : columns ) {
+            auto t = ArrowType(*c, fields);
+
+            if ( ! t ) {
+                Error(Fmt("unsupported field type for %s", c->name.c_str()));
+                return false;
+            }
+
+            schema_fields.push_back(arrow::field(c->name, t));
+        }
+
+        schema = arrow::schema(schema_fields);
+
+        field_builders.resize(num_fields);
+
+        for ( size_t i = 0; i < columns.size(); ++i ) {
+            auto b = arrow::MakeBuilder(schema->field(static_cast<int>(i))->type());
+
+            if ( ! CheckStatus(b.status()) )
+                return false;
+
+            builders.push_back(std::move(*b));
+            CollectBuilders(*columns[i], builders.back().get());
+        }
+    }
+
+    return OpenFile();
+}
+
+bool Parquet::OpenFile() {
+    auto out = arrow::io::FileOutputStream::Open(fname);
+
+    if ( ! CheckStatus(out.status()) )
+        return false;
+
+    sink = *out;
+
+    parquet::WriterProperties::Builder props;
+    props.compression(*arrow::util::Codec::GetCompressionType(compression));
+    props.max_row_group_length(static_cast<int64_t>(row_group_size));
+
+    if ( use_dictionary )
+        props.enable_dictionary();
+    else
+        props.disable_dictionary();
+
+    // Storing the Arrow schema keeps types like unsigned integers intact
+    // for Arrow-based readers.
+    auto arrow_props = parquet::ArrowWriterProperties::Builder().store_schema()->build();
+
+    auto w = parquet::arrow::FileWriter::Open(*schema, arrow::default_memory_pool(), sink, props.build(), arrow_props);
+
+    if ( ! CheckStatus(w.status()) ) {
+        sink.reset();
+        return false;
+    }
+
+    file_writer = std::move(*w);
+    return true;
+}
+
+bool Parquet::WriteRowGroup() {
+    if ( ! pending_rows )
+        return true;
+
+    std::vector<std::shared_ptr<arrow::Array>> arrays;
+
+    for ( auto& b : builders ) {
+        auto a = b->Finish();
+
+        if ( ! CheckStatus(a.status()) )
+            return false;
+
+        arrays.push_back(std::move(*a));
+    }
+
+    auto table = arrow::Table::Make(schema, arrays, pending_rows);
+    pending_rows = 0;
+
+    return CheckStatus(file_writer->WriteTable(*table, static_cast<int64_t>(row_group_size)));
+}
+
+bool Parquet::CloseFile() {
+    if ( ! file_writer )
+        return true;
+
+    // The file isn't valid until its footer has been written, so we
+    // always finish it even if writing the last rows failed.
+    bool success = WriteRowGroup();
+    success = CheckStatus(file_writer->Close()) && success;
+    success = CheckStatus(sink->Close()) && success;
+
+    file_writer.reset();
+    sink.reset();
+
+    return success;
+}
+
+bool Parquet::AppendCell(arrow::ArrayBuilder* builder, TypeTag type, TypeTag subtype, const RecordBatch::Cell& c,
+                         const RecordBatch& batch) {
+    if ( ! c.present )
+        return CheckStatus(builder->AppendNull());
+
+    arrow::Status st;
+
+    switch ( type ) {
+        case TYPE_BOOL: st = static_cast<arrow::BooleanBuilder*>(builder)->Append(c.int_val != 0); break;
+
+        case TYPE_INT: st = static_cast<arrow::Int64Builder*>(builder)->Append(c.int_val); break;
+
+        case TYPE_COUNT: st = static_cast<arrow::UInt64Builder*>(builder)->Append(c.uint_val); break;
+
+        case TYPE_PORT:
+            st = static_cast<arrow::UInt16Builder*>(builder)->Append(static_cast<uint16_t>(c.port_val.port));
+            break;
+
+        case TYPE_SUBNET:
+            st = static_cast<arrow::StringBuilder*>(builder)->Append(Formatter::Render(c.subnet_val));
+            break;
+
+        case TYPE_ADDR:
+            st = static_cast<arrow::StringBuilder*>(builder)->Append(Formatter::Render(c.addr_val));
+            break;
+
+        case TYPE_TIME:
+            st = static_cast<arrow::TimestampBuilder*>(builder)->Append(std::llround(c.double_val * 1e6));
+            break;
+
+        case TYPE_INTERVAL:
+        case TYPE_DOUBLE: st = static_cast<arrow::DoubleBuilder*>(builder)->Append(c.double_val); break;
+
+        case TYPE_ENUM:
+        case TYPE_STRING:
+        case TYPE_FILE:
+        case TYPE_FUNC:
+            st = static_cast<arrow::StringBuilder*>(builder)->Append(batch.Data(c),
+                                                                     static_cast<int32_t>(c.span.length));
+            break;
+
+        case TYPE_TABLE:
+        case TYPE_VECTOR: {
+            auto lb = static_cast<arrow::ListBuilder*>(builder);
+            st = lb->Append();
+
+            const auto* es = batch.Elements(c);
+
+            for ( uint32_t i = 0; st.ok() && i < c.span.length; ++i ) {
+                if ( ! AppendCell(lb->value_builder(), subtype, TYPE_VOID, es[i], batch) )
+                    return false;
+            }
+
+            break;
+        }
+
+        default: Error(Fmt("unsupported field format %d", type)); return false;
+    }
+
+    return CheckStatus(st);
+}
+
+bool Parquet::DoWrite(int num_fields, const Field* const* fields, Value** vals) {
+    // Only reached through the row-based WriterBackend::Write(); the
+    // frontend normally hands us whole batches.
+    RecordBatch batch(num_fields, fields, 1);
+
+    if ( ! batch.AddRow(vals) ) {
+        Error("mismatching field types in write");
+        return false;
+    }
+
+    return DoWriteBatch(batch);
+}
+
+bool Parquet::DoWriteBatch(const RecordBatch& batch) {
+    if ( ! file_writer && ! DoInit(Info(), NumFields(), Fields()) )
+        return false;
+
+    int n = batch.NumRows();
+
+    // Records are never unset as a whole, so struct columns are valid in
+    // every row.
+    for ( auto sb : struct_builders ) {
+        if ( ! CheckStatus(sb->AppendValues(n, nullptr)) )
+            return false;
+    }
+
+    for ( int i = 0; i < batch.NumFields(); ++i ) {
+        auto b = field_builders[i];
+        auto type = batch.Type(i);
+        auto subtype = batch.Subtype(i);
+
+        for ( int j = 0; j < n; ++j ) {
+            if ( ! AppendCell(b, type, subtype, batch.Get(j, i), batch) )
+                return false;
+        }
+    }
+
+    pending_rows += n;
+
+    if ( pending_rows >= static_cast<int64_t>(row_group_size) )
+        return WriteRowGroup();
+
+    return true;
+}
+
+bool Parquet::DoFlush(double network_time) {
+    // Rows only become visible once the file gets closed, so there's no
+    // point in cutting small row groups while buffering.
+    if ( IsBuf() || ! file_writer )
+        return true;
+
+    return WriteRowGroup();
+}
+
+bool Parquet::DoRotate(const char* rotated_path, double open, double close, bool terminating) {
+    // Don't rotate if there's no file currently open.
+    if ( ! file_writer ) {
+        FinishedRotation();
+        return true;
+    }
+
+    if ( ! CloseFile() ) {
+        FinishedRotation();
+        return false;
+    }
+
+    string nname = string(rotated_path) + "." + LogExt();
+
+    if ( rename(fname.c_str(), nname.c_str()) != 0 ) {
+        char buf[256];
+        util::zeek_strerror_r(errno, buf, sizeof(buf));
+        Error(Fmt("failed to rename %s to %s: %s", fname.c_str(), nname.c_str(), buf));
+        FinishedRotation();
+        return false;
+    }
+
+    if ( ! FinishedRotation(nname.c_str(), fname.c_str(), open, close, terminating) ) {
+        Error(Fmt("error rotating %s to %s", fname.c_str(), nname.c_str()));
+        return false;
+    }
+
+    return true;
+}
+
+bool Parquet::DoFinish(double network_time) { return CloseFile(); }
+
+} // namespace zeek::logging::writer::detail
@@ -0,0 +1,80 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+//
+// Log writer for Apache Parquet files.
+
+#pragma once
+
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <parquet/arrow/writer.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "zeek/logging/WriterBackend.h"
+
+namespace zeek::logging::writer::detail {
+
+class Parquet : public WriterBackend {
+public:
+    explicit Parquet(WriterFrontend* frontend);
+    ~Parquet() override;
+
+    static std::string LogExt() { return "parquet"; }
+
+    static WriterBackend* Instantiate(WriterFrontend* frontend) { return new Parquet(frontend); }
+
+protected:
+    bool DoInit(const WriterInfo& info, int num_fields, const threading::Field* const* fields) override;
+    bool DoWrite(int num_fields, const threading::Field* const* fields, threading::Value** vals) override;
+    bool DoWriteBatch(const RecordBatch& batch) override;
+    bool DoSetBuf(bool enabled) override { return true; }
+    bool DoRotate(const char* rotated_path, double open, double close, bool terminating) override;
+    bool DoFlush(double network_time) override;
+    bool DoFinish(double network_time) override;
+    bool DoHeartbeat(double network_time, double current_time) override { return true; }
+
+private:
+    // A column of the output schema. Log fields whose names share a
+    // dotted prefix (e.g., "id.orig_h" and "id.resp_h") become children of
+    // a struct column if nesting is enabled; all other columns are leaves.
+    struct Column {
+        std::string name;
+        int field = -1; // Index of the log field for leaves.
+        std::vector<std::unique_ptr<Column>> children;
+    };
+
+    bool InitFilterOptions();
+    void BuildColumns(int num_fields, const threading::Field* const* fields);
+    std::shared_ptr<arrow::DataType> ArrowType(const Column& col, const threading::Field* const* fields);
+    std::shared_ptr<arrow::DataType> LeafType(TypeTag type, TypeTag subtype);
+    void CollectBuilders(const Column& col, arrow::ArrayBuilder* builder);
+    bool OpenFile();
+    bool CloseFile();
+    bool WriteRowGroup();
+    bool AppendCell(arrow::ArrayBuilder* builder, TypeTag type, TypeTag subtype, const RecordBatch::Cell& c,
+                    const RecordBatch& batch);
+    bool CheckStatus(const arrow::Status& st);
+
+    std::string fname;
+    std::string logdir;
+
+    // Options set from the script-level.
+    uint64_t row_group_size;
+    std::string compression;
+    bool use_dictionary;
+    bool nest_records;
+    bool init_options;
+
+    std::vector<std::unique_ptr<Column>> columns;
+    std::shared_ptr<arrow::Schema> schema;
+    std::vector<std::unique_ptr<arrow::ArrayBuilder>> builders; // One per top-level column.
+    std::vector<arrow::ArrayBuilder*> field_builders;           // One per log field.
+    std::vector<arrow::StructBuilder*> struct_builders;         // All struct columns.
+    int64_t pending_rows;
+
+    std::shared_ptr<arrow::io::FileOutputStream> sink;
+    std::unique_ptr<parquet::arrow::FileWriter> file_writer;
+};
+
+} // namespace zeek::logging::writer::detail
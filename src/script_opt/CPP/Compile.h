@@ -290,6 +290,10 @@ private:
     // in support of run-time initialization of various dynamic values.
     void GenEpilog();
 
+    // For "-O add-C++", generate the plugin that makes the compiled
+    // code loadable at run-time.
+    void GenAddlPlugin();
+
     // Generate the main method of the CPPDynStmt class, doing dynamic
     // dispatch for function invocation.
     void GenCPPDynStmt();
@@ -337,11 +341,10 @@ private:
     // If true, the generated code should run "standalone".
     bool standalone = false;
 
-    // Hash over the functions in this compilation.  This is only
-    // needed for "seatbelts", to ensure that we can produce a
-    // unique hash relating to this compilation (*and* its
-    // compilation time, which is why these are "seatbelts" and
-    // likely not important to make distinct).
+    // Hash over the functions in this compilation, used to give the
+    // generated code its own namespace.  It's deliberately stable
+    // across compilations of the same functions, so that unchanged
+    // scripts yield unchanged C++.
     p_hash_type total_hash = 0;
 
     //
@@ -659,8 +662,9 @@ private:
     std::shared_ptr<CPP_InitsInfo> global_id_info;
 
     // Tracks all of the above objects (as well as each entry in
-    // const_info), to facilitate easy iterating over them.
-    std::set<std::shared_ptr<CPP_InitsInfo>> all_global_info;
+    // const_info), to facilitate easy iterating over them.  Kept in
+    // order of creation so that the generated code is reproducible.
+    std::vector<std::shared_ptr<CPP_InitsInfo>> all_global_info;
 
     // Tracks the attribute expressions for which we need to generate
     // function calls to evaluate them.
@@ -1098,6 +1102,11 @@ private:
     // Indents to the current indentation level.
     void Indent() const;
 
+    // The file the generated code is ultimately for, and the temporary
+    // one we write it to until we know whether it differs.
+    std::string target_name;
+    std::string tmp_target_name;
+
     // File to which we're generating code.
     FILE* write_file;
 
@@ -2,7 +2,10 @@
 
 #include <sys/stat.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cerrno>
+#include <fstream>
+#include <iterator>
 
 #include "zeek/script_opt/CPP/Compile.h"
 #include "zeek/script_opt/IDOptInfo.h"
@@ -15,19 +18,41 @@ using namespace std;
 
 CPPCompile::CPPCompile(vector<FuncInfo>& _funcs, std::shared_ptr<ProfileFuncs> _pfs, const string& gen_name,
                        bool _standalone, bool report_uncompilable)
-    : funcs(_funcs), pfs(std::move(_pfs)), standalone(_standalone) {
-    auto target_name = gen_name.c_str();
+    : funcs(_funcs), pfs(std::move(_pfs)), standalone(_standalone), target_name(gen_name) {
+    // We generate into a temporary file and only replace the target
+    // if the result differs, so that rebuilding after regenerating
+    // code for unchanged scripts doesn't recompile anything.
+    tmp_target_name = target_name + ".tmp";
 
-    write_file = fopen(target_name, "w");
+    write_file = fopen(tmp_target_name.c_str(), "w");
     if ( ! write_file ) {
-        reporter->Error("can't open C++ target file %s", target_name);
+        reporter->Error("can't open C++ target file %s", tmp_target_name.c_str());
         exit(1);
     }
 
     Compile(report_uncompilable);
 }
 
-CPPCompile::~CPPCompile() { fclose(write_file); }
+static bool same_file_contents(const string& f1, const string& f2) {
+    ifstream s1(f1, ios::binary);
+    ifstream s2(f2, ios::binary);
+
+    if ( ! s1 || ! s2 )
+        return false;
+
+    return equal(istreambuf_iterator<char>(s1), istreambuf_iterator<char>(), istreambuf_iterator<char>(s2),
+                 istreambuf_iterator<char>());
+}
+
+CPPCompile::~CPPCompile() {
+    fclose(write_file);
+
+    if ( same_file_contents(tmp_target_name, target_name) )
+        unlink(tmp_target_name.c_str());
+
+    else if ( rename(tmp_target_name.c_str(), target_name.c_str()) < 0 )
+        reporter->Error("can't rename %s to %s: %s", tmp_target_name.c_str(), target_name.c_str(), strerror(errno));
+}
 
 void CPPCompile::Compile(bool report_uncompilable) {
     unordered_set<string> filenames_reported_as_skipped;
@@ -89,13 +114,17 @@ void CPPCompile::Compile(bool report_uncompilable) {
     if ( standalone && had_to_skip )
         reporter->FatalError("aborting standalone compilation to C++ due to having to skip some functions");
 
-    // Generate a hash unique for this compilation.
+    // Generate a hash unique for this compilation. It depends only on
+    // the bodies being compiled, so regenerating code for unchanged
+    // scripts produces identical output.
     for ( const auto& func : funcs )
         if ( ! func.ShouldSkip() )
             total_hash = merge_p_hashes(total_hash, func.Profile()->HashVal());
 
-    auto t = util::current_time();
-    total_hash = merge_p_hashes(total_hash, hash<double>{}(t));
+    if ( analysis_options.add_CPP )
+        // Keep distinct from a compilation of the same bodies into
+        // the binary itself.
+        total_hash = merge_p_hashes(total_hash, hash<string>{}("add-C++"));
 
     GenProlog();
 
@@ -107,7 +136,7 @@ void CPPCompile::Compile(bool report_uncompilable) {
 
     NL();
 
-    for ( auto& g : pfs->AllGlobals() )
+    for ( auto g : sorted_IDs(pfs->AllGlobals()) )
         CreateGlobal(g);
 
     for ( const auto& e : pfs->Events() )
@@ -120,6 +149,12 @@ void CPPCompile::Compile(bool report_uncompilable) {
         RegisterType(tp);
     }
 
+    // Lambdas come to us as a set of pointers. Put them in a
+    // consistent order so the generated code is reproducible.
+    vector<const LambdaExpr*> lambdas(pfs->Lambdas().begin(), pfs->Lambdas().end());
+    sort(lambdas.begin(), lambdas.end(),
+         [](const LambdaExpr* a, const LambdaExpr* b) { return a->Name() < b->Name(); });
+
     // The scaffolding is now in place to go ahead and generate
     // the functions & lambdas.  First declare them ...
     for ( const auto& func : funcs )
@@ -132,7 +167,7 @@ void CPPCompile::Compile(bool report_uncompilable) {
     // be identical.  In that case, we don't want to generate the lambda
     // twice, but we do want to map the second one to the same body name.
     unordered_map<string, const Stmt*> lambda_ASTs;
-    for ( const auto& l : pfs->Lambdas() ) {
+    for ( const auto& l : lambdas ) {
         const auto& n = l->Name();
         const auto body = l->Ingredients()->Body().get();
         if ( lambda_ASTs.count(n) > 0 )
@@ -152,7 +187,7 @@ void CPPCompile::Compile(bool report_uncompilable) {
             CompileFunc(func);
 
     lambda_ASTs.clear();
-    for ( const auto& l : pfs->Lambdas() ) {
+    for ( const auto& l : lambdas ) {
         const auto& n = l->Name();
         if ( lambda_ASTs.count(n) > 0 )
             continue;
@@ -175,6 +210,9 @@ void CPPCompile::Compile(bool report_uncompilable) {
 void CPPCompile::GenProlog() {
     Emit("#include \"zeek/script_opt/CPP/Runtime.h\"\n");
 
+    if ( analysis_options.add_CPP )
+        Emit("#include \"zeek/plugin/Plugin.h\"\n");
+
     // Get the working directory for annotating the output to help
     // with debugging.
     char working_dir[8192];
@@ -244,7 +282,7 @@ shared_ptr<CPP_InitsInfo> CPPCompile::RegisterInitInfo(const char* tag, const ch
                                                        shared_ptr<CPP_InitsInfo> gi) {
     string v_type = type[0] ? (string(tag) + type) : "void*";
     Emit("std::vector<%s> CPP__%s__;", v_type, string(tag));
-    all_global_info.insert(gi);
+    all_global_info.push_back(gi);
     return gi;
 }
 
@@ -334,6 +372,35 @@ void CPPCompile::GenEpilog() {
 
     Emit("} //\n\n");
     Emit("} // zeek::detail");
+
+    if ( analysis_options.add_CPP )
+        GenAddlPlugin();
+}
+
+void CPPCompile::GenAddlPlugin() {
+    // Code generated using "-O add-C++" gets built as a dynamic plugin.
+    // All that the plugin needs to do is exist: loading it runs the
+    // static initialization that registers its compiled bodies.
+    NL();
+    Emit("namespace zeek::plugin::CPP_%s { //\n", Fmt(total_hash));
+
+    Emit("class Plugin : public zeek::plugin::Plugin");
+    StartBlock();
+    Emit("protected:");
+    Emit("zeek::plugin::Configuration Configure() override");
+    StartBlock();
+    Emit("zeek::plugin::Configuration config;");
+    Emit("config.name = \"Zeek::CompiledScripts\";");
+    Emit("config.description = \"Script bodies compiled to C++ (hash %s)\";", to_string(total_hash));
+    Emit("return config;");
+    EndBlock();
+    EndBlock(true);
+
+    NL();
+    Emit("Plugin plugin;");
+
+    NL();
+    Emit("} //");
 }
 
 void CPPCompile::GenCPPDynStmt() {
@@ -455,7 +522,11 @@ void CPPCompile::GenRegisterBodies() {
         "auto f = make_intrusive<CPPDynStmt>(b.func_name.c_str(), b.func, b.type_signature, "
         "b.filename, b.line_num);");
 
-    auto reg = standalone ? "register_standalone_body" : "register_body";
+    auto reg = "register_body";
+    if ( standalone )
+        reg = "register_standalone_body";
+    else if ( analysis_options.add_CPP )
+        reg = "register_addl_body";
     Emit("%s__CPP(f, b.priority, b.h, b.events, finish_init__CPP);", reg);
     EndBlock();
 
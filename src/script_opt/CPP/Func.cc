@@ -12,6 +12,7 @@ namespace zeek::detail {
 using namespace std;
 
 unordered_map<p_hash_type, CompiledScript> compiled_scripts;
+unordered_set<p_hash_type> addl_compiled_scripts;
 unordered_map<string, unordered_set<p_hash_type>> added_bodies;
 unordered_map<p_hash_type, void (*)()> standalone_callbacks;
 vector<void (*)()> standalone_finalizations;
@@ -96,6 +96,10 @@ struct CompiledScript {
 // Maps hashes to compiled information.
 extern std::unordered_map<p_hash_type, CompiledScript> compiled_scripts;
 
+// The hashes of those compiled_scripts entries that come from code
+// generated using "-O add-C++", rather than being built into the binary.
+extern std::unordered_set<p_hash_type> addl_compiled_scripts;
+
 // When using standalone-code, tracks which function bodies have had
 // compiled versions added to them.  Needed so that we don't replace
 // the body twice, leading to two copies.  Indexed first by the name
@@ -148,7 +148,7 @@ void CPPCompile::DeclareLocals(const ProfileFunc* pf, const IDPList* lambda_ids)
         for ( auto li : *lambda_ids )
             capture_names.insert(CaptureName(li));
 
-    const auto& ls = pf->Locals();
+    auto ls = sorted_IDs(pf->Locals());
 
     // Track whether we generated a declaration.  This is just for
     // tidiness in the output.
@@ -49,6 +49,12 @@ void register_body__CPP(CPPStmtPtr body, int priority, p_hash_type hash, vector<
     compiled_scripts[hash] = {std::move(body), priority, std::move(events), finish_init};
 }
 
+void register_addl_body__CPP(CPPStmtPtr body, int priority, p_hash_type hash, vector<string> events,
+                             void (*finish_init)()) {
+    register_body__CPP(std::move(body), priority, hash, std::move(events), finish_init);
+    addl_compiled_scripts.insert(hash);
+}
+
 static unordered_map<p_hash_type, CompiledScript> compiled_standalone_scripts;
 
 void register_standalone_body__CPP(CPPStmtPtr body, int priority, p_hash_type hash, vector<string> events,
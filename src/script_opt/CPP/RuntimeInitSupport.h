@@ -46,6 +46,10 @@ extern void register_type__CPP(TypePtr t, const std::string& name);
 extern void register_body__CPP(CPPStmtPtr body, int priority, p_hash_type hash, std::vector<std::string> events,
                                void (*finish_init)());
 
+// Same but for function bodies generated using "-O add-C++".
+extern void register_addl_body__CPP(CPPStmtPtr body, int priority, p_hash_type hash, std::vector<std::string> events,
+                                    void (*finish_init)());
+
 // Same but for standalone function bodies.
 extern void register_standalone_body__CPP(CPPStmtPtr body, int priority, p_hash_type hash,
                                           std::vector<std::string> events, void (*finish_init)());
@@ -332,7 +332,7 @@ void CPPCompile::GenWhenStmt(const WhenInfo* wi, const std::string& when_lambda,
     Emit("if ( ! CPP__wi )");
     StartBlock();
     Emit("CPP__wi = std::make_shared<WhenInfo>(%s);", is_return);
-    for ( auto& wg : wi->WhenExprGlobals() )
+    for ( auto wg : sorted_IDs(wi->WhenExprGlobals()) )
         Emit("CPP__w_globals.insert(find_global__CPP(\"%s\").get());", wg->Name());
     EndBlock();
     NL();
@@ -409,7 +409,7 @@ void CPPCompile::GenForStmt(const ForStmt* f) {
 
 void CPPCompile::GenForOverTable(const ExprPtr& tbl, const IDPtr& value_var, const IDPList* loop_vars) {
     Emit("auto tv__CPP = %s;", GenExpr(tbl, GEN_DONT_CARE));
-    Emit("const PDict<TableEntryVal>* loop_vals__CPP = tv__CPP->AsTable();");
+    Emit("const PDict<TableEntryVal>* loop_vals__CPP = tv__CPP->GetForIteration();");
 
     Emit("if ( loop_vals__CPP->Length() > 0 )");
     StartBlock();
@@ -4,6 +4,7 @@
 
 #include <sys/file.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cerrno>
 
 #include "zeek/script_opt/StmtOptInfo.h"
@@ -38,6 +39,12 @@ string scope_prefix(const string& scope) { return "zeek::detail::CPP_" + scope;
 
 string scope_prefix(int scope) { return scope_prefix(to_string(scope)); }
 
+vector<const ID*> sorted_IDs(const IDSet& ids) {
+    vector<const ID*> sorted(ids.begin(), ids.end());
+    sort(sorted.begin(), sorted.end(), [](const ID* a, const ID* b) { return strcmp(a->Name(), b->Name()) < 0; });
+    return sorted;
+}
+
 bool is_CPP_compilable(const ProfileFunc* pf, const char** reason) {
     if ( analysis_options.allow_cond )
         return true;
@@ -19,6 +19,11 @@ extern std::string scope_prefix(const std::string& scope);
 // Same, but for scopes identified with numbers.
 extern std::string scope_prefix(int scope);
 
+// Returns the given identifiers ordered by name. Used when iterating over
+// sets of identifiers, so that the generated code doesn't depend on where
+// the identifiers happen to reside in memory.
+extern std::vector<const ID*> sorted_IDs(const IDSet& ids);
+
 // True if the given function is compilable to C++.  If it isn't, and
 // the second argument is non-nil, then on return it points to text
 // explaining why not.
@@ -280,12 +280,16 @@ static void init_options() {
     // Compile-to-C++-related options.
     check_env_opt("ZEEK_GEN_CPP", analysis_options.gen_CPP);
     check_env_opt("ZEEK_GEN_STANDALONE_CPP", analysis_options.gen_standalone_CPP);
+    check_env_opt("ZEEK_ADD_CPP", analysis_options.add_CPP);
     check_env_opt("ZEEK_COMPILE_ALL", analysis_options.compile_all);
     check_env_opt("ZEEK_REPORT_CPP", analysis_options.report_CPP);
     check_env_opt("ZEEK_USE_CPP", analysis_options.use_CPP);
     check_env_opt("ZEEK_ALLOW_COND", analysis_options.allow_cond);
 
-    if ( analysis_options.gen_standalone_CPP )
+    if ( analysis_options.add_CPP && analysis_options.gen_standalone_CPP )
+        reporter->FatalError("\"-O add-C++\" incompatible with \"-O gen-standalone-C++\"");
+
+    if ( analysis_options.gen_standalone_CPP || analysis_options.add_CPP )
         analysis_options.gen_CPP = true;
 
     if ( analysis_options.gen_CPP )
@@ -433,11 +437,24 @@ static void use_CPP() {
 }
 
 static void generate_CPP(std::shared_ptr<ProfileFuncs> pfs) {
-    const auto gen_name = CPP_dir + "CPP-gen.cc";
+    auto gen_name = CPP_dir + "CPP-gen.cc";
 
     const bool standalone = analysis_options.gen_standalone_CPP;
     const bool report = analysis_options.report_uncompilable;
 
+    if ( analysis_options.add_CPP ) {
+        // Skip the bodies that the binary itself already has compiled.
+        // Those that come from a previously generated add-on plugin
+        // still need generating, as the new plugin replaces the old one.
+        for ( auto& func : funcs ) {
+            auto hash = func.Profile()->HashVal();
+            if ( compiled_scripts.count(hash) > 0 && addl_compiled_scripts.count(hash) == 0 )
+                func.SetSkip(true);
+        }
+
+        gen_name = CPP_dir + "CPP-gen-addl.cc";
+    }
+
     CPPCompile cpp(funcs, pfs, gen_name, standalone, report);
 }
 
@@ -118,6 +118,11 @@ struct AnalyOpt {
     // of the corresponding script, and not activated by default).
     bool gen_standalone_CPP = false;
 
+    // If true, generate C++ only for the bodies that the running binary
+    // doesn't already have compiled, in a form that can be built as a
+    // dynamic plugin.
+    bool add_CPP = false;
+
     // If true, use C++ bodies if available.
     bool use_CPP = false;
 
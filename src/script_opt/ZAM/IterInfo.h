@@ -63,7 +63,7 @@ public:
     }
 
     void PrimeIter() {
-        auto tvd = tv->AsTable();
+        auto tvd = tv->GetForIteration();
         tbl_iter = tvd->begin();
         tbl_end = tvd->end();
     }
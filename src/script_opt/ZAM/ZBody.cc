@@ -70,6 +70,24 @@ void estimate_ZAM_profiling_overhead() {
 static std::vector<const ZAMLocInfo*> caller_locs;
 static bool profile_all = getenv("ZAM_PROFILE_ALL") != nullptr;
 
+// Sampled counts of straight-line runs of two and three ZAM operations,
+// i.e., ones where each instruction fell through to the next. Keys hold
+// the run length in their top 16 bits and the operations in successive
+// 16-bit fields below that. These identify candidates for fusing into
+// superinstructions.
+static std::unordered_map<uint64_t, int> ZOP_seq_count;
+
+// Records the operation at "pc" along with its "len" predecessors (at
+// most 2) as sampled sequences.
+static void record_ZOP_seq(const ZInst* insts, unsigned int pc, int len) {
+    for ( int l = 1; l <= len; ++l ) {
+        uint64_t key = l;
+        for ( auto i = pc - l; i <= pc; ++i )
+            key = (key << 16) | insts[i].op;
+        ++ZOP_seq_count[key];
+    }
+}
+
 #define DO_ZAM_PROFILE                                                                                                 \
     if ( do_profile ) {                                                                                                \
         double dt = util::curr_CPU_time() - profile_CPU;                                                               \
@@ -137,6 +155,33 @@ void report_ZOP_profile() {
             auto CPU = std::max(ZOP_CPU[i] - ZOP_count[i] * CPU_prof_overhead, 0.0);
             fprintf(analysis_options.profile_file, "%s\t%d\t%.06f\n", ZOP_name(ZOp(i)), ZOP_count[i], CPU);
         }
+
+#ifdef ENABLE_ZAM_PROFILE
+    // Report the hottest sequences first, since those are the ones worth
+    // turning into superinstructions.
+    static constexpr size_t max_seqs_reported = 100;
+
+    std::vector<std::pair<uint64_t, int>> seqs(ZOP_seq_count.begin(), ZOP_seq_count.end());
+    std::sort(seqs.begin(), seqs.end(), [](const auto& a, const auto& b) {
+        return a.second > b.second || (a.second == b.second && a.first < b.first);
+    });
+
+    if ( ! profile_all && seqs.size() > max_seqs_reported )
+        seqs.resize(max_seqs_reported);
+
+    for ( auto& [key, count] : seqs ) {
+        int len = key >> 48 ? 2 : 1;
+        std::string ops;
+
+        for ( int i = len; i >= 0; --i ) {
+            if ( ! ops.empty() )
+                ops += ",";
+            ops += ZOP_name(ZOp((key >> (16 * i)) & 0xffff));
+        }
+
+        fprintf(analysis_options.profile_file, "sequence\t%s\t%d\n", ops.c_str(), count);
+    }
+#endif
 }
 
 // Sets the given element to a copy of an existing (not newly constructed)
@@ -323,6 +368,12 @@ ValPtr ZBody::Exec(Frame* f, StmtFlowType& flow) {
     double start_CPU_time = 0.0;
     uint64_t start_mem = 0;
 
+    // For tracking straight-line sequences of instructions: the previously
+    // executed pc (initially one that can't precede any instruction), and
+    // how many instructions in a row (capped at 2) fell through into it.
+    unsigned int prev_pc = end_pc;
+    int seq_len = 0;
+
     if ( profiling_active ) {
         ++ncall;
         start_CPU_time = util::curr_CPU_time();
@@ -376,10 +427,16 @@ ValPtr ZBody::Exec(Frame* f, StmtFlowType& flow) {
             seed = util::detail::prng(seed);
             do_profile = seed % sampling_rate == 0;
 
+            seq_len = pc == prev_pc + 1 ? std::min(seq_len + 1, 2) : 0;
+            prev_pc = pc;
+
             if ( do_profile ) {
                 ++ZOP_count[z.op];
                 ++ninst;
 
+                if ( seq_len > 0 )
+                    record_ZOP_seq(insts, pc, seq_len);
+
                 profile_pc = pc;
                 profile_CPU = util::curr_CPU_time();
             }
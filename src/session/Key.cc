@@ -4,6 +4,8 @@
 
 namespace zeek::session::detail {
 
+static_assert(sizeof(zeek::detail::ConnKey) <= Key::INLINE_DATA_SIZE);
+
 Key::Key(const void* session, size_t size, size_t type, bool copy) : size(size), type(type) {
     data = reinterpret_cast<const uint8_t*>(session);
 
@@ -13,42 +15,51 @@ Key::Key(const void* session, size_t size, size_t type, bool copy) : size(size),
     copied = copy;
 }
 
-Key::Key(Key&& rhs) {
-    data = rhs.data;
-    size = rhs.size;
-    copied = rhs.copied;
-
-    rhs.data = nullptr;
-    rhs.size = 0;
-    rhs.copied = false;
-}
+Key::Key(Key&& rhs) { MoveFrom(rhs); }
 
 Key& Key::operator=(Key&& rhs) {
     if ( this != &rhs ) {
-        data = rhs.data;
-        size = rhs.size;
-        copied = rhs.copied;
+        if ( copied && data != inline_data )
+            delete[] data;
 
-        rhs.data = nullptr;
-        rhs.size = 0;
-        rhs.copied = false;
+        MoveFrom(rhs);
     }
 
     return *this;
 }
 
 Key::~Key() {
-    if ( copied )
+    if ( copied && data != inline_data )
         delete[] data;
 }
 
+void Key::MoveFrom(Key& rhs) {
+    size = rhs.size;
+    type = rhs.type;
+    copied = rhs.copied;
+    hash = rhs.hash;
+    hash_valid = rhs.hash_valid;
+
+    if ( rhs.data == rhs.inline_data ) {
+        memcpy(inline_data, rhs.inline_data, size);
+        data = inline_data;
+    }
+    else
+        data = rhs.data;
+
+    rhs.data = nullptr;
+    rhs.size = 0;
+    rhs.copied = false;
+    rhs.hash_valid = false;
+}
+
 void Key::CopyData() {
     if ( copied )
         return;
 
     copied = true;
 
-    uint8_t* temp = new uint8_t[size];
+    uint8_t* temp = size <= INLINE_DATA_SIZE ? inline_data : new uint8_t[size];
     memcpy(temp, data, size);
     data = temp;
 }
@@ -25,6 +25,10 @@ class Key final {
 public:
     const static size_t CONNECTION_KEY_TYPE = 0;
 
+    // Keys up to this size get copied into the object itself instead of
+    // onto the heap. This covers ConnKey.
+    const static size_t INLINE_DATA_SIZE = 48;
+
     /**
      * Create a new session key from a data pointer.
      *
@@ -62,15 +66,30 @@ public:
     bool operator<(const Key& rhs) const;
     bool operator==(const Key& rhs) const;
 
-    std::size_t Hash() const { return zeek::detail::HashKey::HashBytes(data, size); }
+    std::size_t Hash() const {
+        if ( ! hash_valid ) {
+            hash = zeek::detail::HashKey::HashBytes(data, size);
+            hash_valid = true;
+        }
+
+        return hash;
+    }
 
 private:
     friend struct KeyHash;
 
+    void MoveFrom(Key& rhs);
+
     const uint8_t* data = nullptr;
     size_t size = 0;
     size_t type = CONNECTION_KEY_TYPE;
+
+    // Hashing shows up on the packet path, so we compute it only once.
+    mutable std::size_t hash = 0;
+    mutable bool hash_valid = false;
+
     bool copied = false;
+    alignas(8) uint8_t inline_data[INLINE_DATA_SIZE];
 };
 
 struct KeyHash {
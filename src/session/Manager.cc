@@ -8,6 +8,7 @@
 #include <netinet/in.h>
 #include <pcap.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cstdlib>
 
 #include "zeek/Desc.h"
@@ -106,11 +107,7 @@ Connection* Manager::FindConnection(Val* v) {
 Connection* Manager::FindConnection(const zeek::detail::ConnKey& conn_key) {
     detail::Key key(&conn_key, sizeof(conn_key), detail::Key::CONNECTION_KEY_TYPE, false);
 
-    auto it = session_map.find(key);
-    if ( it != session_map.end() )
-        return static_cast<Connection*>(it->second);
-
-    return nullptr;
+    return static_cast<Connection*>(session_map.Lookup(key));
 }
 
 void Manager::Remove(Session* s) {
@@ -121,7 +118,7 @@ void Manager::Remove(Session* s) {
 
         detail::Key key = s->SessionKey(false);
 
-        if ( session_map.erase(key) == 0 )
+        if ( ! session_map.Remove(key) )
             reporter->InternalWarning("connection missing");
         else {
             Connection* c = static_cast<Connection*>(s);
@@ -142,13 +139,8 @@ void Manager::Insert(Session* s, bool remove_existing) {
     Session* old = nullptr;
     detail::Key key = s->SessionKey(true);
 
-    if ( remove_existing ) {
-        auto it = session_map.find(key);
-        if ( it != session_map.end() )
-            old = it->second;
-
-        session_map.erase(key);
-    }
+    if ( remove_existing )
+        old = session_map.Remove(key);
 
     InsertSession(std::move(key), s);
 
@@ -166,33 +158,29 @@ void Manager::Drain() {
     // order of the sessions to be consistent. Sort the keys to force that order
     // every run.
     if ( zeek::util::detail::have_random_seed() ) {
-        std::vector<const detail::Key*> keys;
-        keys.reserve(session_map.size());
+        std::vector<std::pair<const detail::Key*, Session*>> entries;
+        entries.reserve(CurrentSessions());
+
+        session_map.ForEach([&entries](const detail::Key& k, Session* s) { entries.emplace_back(&k, s); });
 
-        for ( auto& entry : session_map )
-            keys.push_back(&(entry.first));
-        std::sort(keys.begin(), keys.end(), [](const detail::Key* a, const detail::Key* b) { return *a < *b; });
+        std::sort(entries.begin(), entries.end(), [](const auto& a, const auto& b) { return *a.first < *b.first; });
 
-        for ( const auto* k : keys ) {
-            Session* tc = session_map.at(*k);
+        for ( const auto& [k, tc] : entries ) {
             tc->Done();
             tc->RemovalEvent();
         }
     }
     else {
-        for ( const auto& entry : session_map ) {
-            Session* tc = entry.second;
+        session_map.ForEach([](const detail::Key&, Session* tc) {
             tc->Done();
             tc->RemovalEvent();
-        }
+        });
     }
 }
 
 void Manager::Clear() {
-    for ( const auto& entry : session_map )
-        Unref(entry.second);
-
-    session_map.clear();
+    session_map.ForEach([](const detail::Key&, Session* s) { Unref(s); });
+    session_map.Clear();
 
     zeek::detail::fragment_mgr->Clear();
 }
@@ -243,7 +231,7 @@ void Manager::Weird(const char* name, const IP_Hdr* ip, const char* addl) {
 void Manager::InsertSession(detail::Key key, Session* session) {
     session->SetInSessionTable(true);
     key.CopyData();
-    session_map.insert_or_assign(std::move(key), session);
+    session_map.Insert(std::move(key), session);
 
     std::string protocol = session->TransportIdentifier();
 
@@ -3,13 +3,13 @@
 #pragma once
 
 #include <sys/types.h> // for u_char
-#include <unordered_map>
 #include <utility>
 
 #include "zeek/Frag.h"
 #include "zeek/Hash.h"
 #include "zeek/NetVar.h"
 #include "zeek/session/Session.h"
+#include "zeek/session/SessionTable.h"
 
 namespace zeek {
 
@@ -89,10 +89,10 @@ public:
     void Weird(const char* name, const Packet* pkt, const char* addl = "", const char* source = "");
     void Weird(const char* name, const IP_Hdr* ip, const char* addl = "");
 
-    size_t CurrentSessions() { return session_map.size(); }
+    size_t CurrentSessions() { return session_map.Size(); }
 
 private:
-    using SessionMap = std::unordered_map<detail::Key, Session*, detail::KeyHash>;
+    using SessionMap = detail::SessionTable;
 
     // Inserts a new connection into the sessions map. If a connection with
     // the same key already exists in the map, it will be overwritten by
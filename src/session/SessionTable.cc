@@ -0,0 +1,532 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/session/SessionTable.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <random>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "zeek/3rdparty/doctest.h"
+#include "zeek/IPAddr.h"
+#include "zeek/MicroBenchmark.h"
+
+namespace zeek::session::detail {
+
+namespace {
+
+// Control byte values. Full slots store the low seven bits of their hash,
+// so the sign bit tells free slots apart.
+constexpr int8_t CTRL_EMPTY = -128;
+constexpr int8_t CTRL_DELETED = -2;
+
+#if defined(__AVX2__)
+constexpr size_t GROUP_WIDTH = 32;
+#else
+constexpr size_t GROUP_WIDTH = 16;
+#endif
+
+// How many old slots each insertion or removal moves over while growing.
+// Growing at least doubles the slots, so this finishes long before the new
+// slots fill up.
+constexpr size_t MIGRATE_SLOTS = 64;
+
+int8_t hash_tag(size_t hash) { return static_cast<int8_t>(hash & 0x7f); }
+
+size_t hash_group(size_t hash) { return hash >> 7; }
+
+// Index of the lowest set bit; x must be non-zero.
+int lowest_bit(uint32_t x) {
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward(&idx, x);
+    return static_cast<int>(idx);
+#else
+    return __builtin_ctz(x);
+#endif
+}
+
+// Bit masks of the control bytes in a group that match a tag, that are
+// empty, and that are free (empty or deleted), respectively.
+#if defined(__AVX2__)
+
+uint32_t match_tag(const int8_t* group, int8_t tag) {
+    auto ctrl = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8(tag))));
+}
+
+uint32_t match_empty(const int8_t* group) { return match_tag(group, CTRL_EMPTY); }
+
+uint32_t match_free(const int8_t* group) {
+    auto ctrl = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(group));
+    return static_cast<uint32_t>(_mm256_movemask_epi8(ctrl));
+}
+
+#elif defined(__SSE2__) || defined(_M_X64)
+
+uint32_t match_tag(const int8_t* group, int8_t tag) {
+    auto ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag))));
+}
+
+uint32_t match_empty(const int8_t* group) { return match_tag(group, CTRL_EMPTY); }
+
+uint32_t match_free(const int8_t* group) {
+    auto ctrl = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+    return static_cast<uint32_t>(_mm_movemask_epi8(ctrl));
+}
+
+#else
+
+uint32_t match_tag(const int8_t* group, int8_t tag) {
+    uint32_t mask = 0;
+
+    for ( size_t i = 0; i < GROUP_WIDTH; ++i )
+        mask |= static_cast<uint32_t>(group[i] == tag) << i;
+
+    return mask;
+}
+
+uint32_t match_empty(const int8_t* group) { return match_tag(group, CTRL_EMPTY); }
+
+uint32_t match_free(const int8_t* group) {
+    uint32_t mask = 0;
+
+    for ( size_t i = 0; i < GROUP_WIDTH; ++i )
+        mask |= static_cast<uint32_t>(group[i] < 0) << i;
+
+    return mask;
+}
+
+#endif
+
+} // namespace
+
+void SessionTable::Storage::Allocate(size_t arg_capacity) {
+    capacity = arg_capacity;
+    live = deleted = 0;
+    ctrl = new int8_t[capacity];
+    memset(ctrl, CTRL_EMPTY, capacity);
+    slots = static_cast<Slot*>(::operator new(capacity * sizeof(Slot)));
+}
+
+void SessionTable::Storage::Free() {
+    if ( ! capacity )
+        return;
+
+    for ( size_t i = 0; live && i < capacity; ++i ) {
+        if ( ctrl[i] >= 0 ) {
+            slots[i].key.~Key();
+            --live;
+        }
+    }
+
+    delete[] ctrl;
+    ::operator delete(slots);
+
+    ctrl = nullptr;
+    slots = nullptr;
+    capacity = live = deleted = 0;
+}
+
+// Groups get probed in triangular order, which visits each of them once
+// since their number is a power of two.
+
+ptrdiff_t SessionTable::Storage::Find(const Key& key, size_t hash) const {
+    if ( ! capacity )
+        return -1;
+
+    size_t group_mask = capacity / GROUP_WIDTH - 1;
+    size_t group = hash_group(hash) & group_mask;
+    int8_t tag = hash_tag(hash);
+
+    for ( size_t step = 1; step <= group_mask + 1; ++step ) {
+        const int8_t* g = ctrl + group * GROUP_WIDTH;
+
+        for ( uint32_t m = match_tag(g, tag); m; m &= m - 1 ) {
+            size_t idx = group * GROUP_WIDTH + lowest_bit(m);
+            const Key& k = slots[idx].key;
+
+            if ( k.Hash() == hash && k == key )
+                return static_cast<ptrdiff_t>(idx);
+        }
+
+        if ( match_empty(g) )
+            break;
+
+        group = (group + step) & group_mask;
+    }
+
+    return -1;
+}
+
+size_t SessionTable::Storage::FindFree(size_t hash) const {
+    size_t group_mask = capacity / GROUP_WIDTH - 1;
+    size_t group = hash_group(hash) & group_mask;
+
+    // The load factor guarantees a free slot.
+    for ( size_t step = 1;; ++step ) {
+        if ( uint32_t m = match_free(ctrl + group * GROUP_WIDTH) )
+            return group * GROUP_WIDTH + lowest_bit(m);
+
+        group = (group + step) & group_mask;
+    }
+}
+
+void SessionTable::Storage::Put(size_t idx, size_t hash, Key&& key, Session* session) {
+    if ( ctrl[idx] == CTRL_DELETED )
+        --deleted;
+
+    new (&slots[idx].key) Key(std::move(key));
+    slots[idx].session = session;
+    ctrl[idx] = hash_tag(hash);
+    ++live;
+}
+
+void SessionTable::Storage::Erase(size_t idx) {
+    slots[idx].key.~Key();
+    --live;
+
+    // Probing stops at groups with an empty slot. If the group has one
+    // already, it was never full, so no probe sequence continues past it
+    // and the slot can become empty again.
+    const int8_t* g = ctrl + idx / GROUP_WIDTH * GROUP_WIDTH;
+
+    if ( match_empty(g) )
+        ctrl[idx] = CTRL_EMPTY;
+    else {
+        ctrl[idx] = CTRL_DELETED;
+        ++deleted;
+    }
+}
+
+SessionTable::~SessionTable() { Clear(); }
+
+SessionTable::SessionTable(SessionTable&& rhs) noexcept { *this = std::move(rhs); }
+
+SessionTable& SessionTable::operator=(SessionTable&& rhs) noexcept {
+    if ( this != &rhs ) {
+        Clear();
+        std::swap(cur, rhs.cur);
+        std::swap(old, rhs.old);
+        std::swap(migrate_pos, rhs.migrate_pos);
+    }
+
+    return *this;
+}
+
+Session* SessionTable::Lookup(const Key& key) const {
+    size_t hash = key.Hash();
+
+    if ( auto idx = cur.Find(key, hash); idx >= 0 )
+        return cur.slots[idx].session;
+
+    if ( Resizing() ) {
+        if ( auto idx = old.Find(key, hash); idx >= 0 )
+            return old.slots[idx].session;
+    }
+
+    return nullptr;
+}
+
+Session* SessionTable::Insert(Key key, Session* session) {
+    size_t hash = key.Hash();
+
+    if ( Resizing() )
+        Migrate(MIGRATE_SLOTS);
+
+    if ( auto idx = cur.Find(key, hash); idx >= 0 ) {
+        Session* prev = cur.slots[idx].session;
+        cur.slots[idx].session = session;
+        return prev;
+    }
+
+    Session* prev = nullptr;
+
+    if ( Resizing() ) {
+        if ( auto idx = old.Find(key, hash); idx >= 0 ) {
+            prev = old.slots[idx].session;
+            old.Erase(idx);
+        }
+    }
+
+    // Keep the load factor at or below 7/8, counting deleted slots since
+    // they lengthen probe sequences just the same.
+    if ( (cur.live + cur.deleted + 1) * 8 > cur.capacity * 7 )
+        Grow();
+
+    cur.Put(cur.FindFree(hash), hash, std::move(key), session);
+    return prev;
+}
+
+Session* SessionTable::Remove(const Key& key) {
+    size_t hash = key.Hash();
+    Session* session = nullptr;
+
+    if ( auto idx = cur.Find(key, hash); idx >= 0 ) {
+        session = cur.slots[idx].session;
+        cur.Erase(idx);
+    }
+    else if ( Resizing() ) {
+        if ( auto idx = old.Find(key, hash); idx >= 0 ) {
+            session = old.slots[idx].session;
+            old.Erase(idx);
+        }
+    }
+
+    if ( Resizing() )
+        Migrate(MIGRATE_SLOTS);
+
+    return session;
+}
+
+void SessionTable::Clear() {
+    old.Free();
+    cur.Free();
+    migrate_pos = 0;
+}
+
+void SessionTable::Grow() {
+    // Can only happen with very small tables.
+    if ( Resizing() )
+        Migrate(old.capacity);
+
+    // If mostly deleted slots filled up the table, it's enough to clean
+    // them out.
+    size_t capacity = cur.capacity;
+
+    if ( ! capacity )
+        capacity = GROUP_WIDTH;
+    else if ( cur.live * 16 >= cur.capacity * 7 )
+        capacity *= 2;
+
+    std::swap(old, cur);
+    cur.Allocate(capacity);
+    migrate_pos = 0;
+
+    if ( ! old.live )
+        old.Free();
+}
+
+void SessionTable::Migrate(size_t num_slots) {
+    size_t end = std::min(migrate_pos + num_slots, old.capacity);
+
+    for ( ; migrate_pos < end && old.live; ++migrate_pos ) {
+        if ( old.ctrl[migrate_pos] < 0 )
+            continue;
+
+        Slot& s = old.slots[migrate_pos];
+        size_t hash = s.key.Hash();
+        cur.Put(cur.FindFree(hash), hash, std::move(s.key), s.session);
+
+        s.key.~Key();
+        old.ctrl[migrate_pos] = CTRL_EMPTY;
+        --old.live;
+    }
+
+    if ( migrate_pos == old.capacity || ! old.live ) {
+        old.Free();
+        migrate_pos = 0;
+    }
+}
+
+TEST_SUITE_BEGIN("SessionTable");
+
+namespace {
+
+zeek::detail::ConnKey test_conn_key(uint32_t n) {
+    uint32_t orig = htonl(0x0a000000 | (n >> 8));
+    uint32_t resp = htonl(0xc0a80000 | (n & 0xff));
+    IPAddr a(IPv4, &orig, IPAddr::Network);
+    IPAddr b(IPv4, &resp, IPAddr::Network);
+    return {a, b, htons(static_cast<uint16_t>(1024 + n % 50000)), htons(443), TRANSPORT_TCP, false};
+}
+
+Session* test_session(uint32_t n) { return reinterpret_cast<Session*>(static_cast<uintptr_t>(n + 1) * 8); }
+
+} // namespace
+
+TEST_CASE("session table insert lookup remove") {
+    SessionTable t;
+    std::vector<zeek::detail::ConnKey> keys;
+    bool saw_resize = false;
+
+    for ( uint32_t i = 0; i < 10000; ++i ) {
+        keys.push_back(test_conn_key(i));
+        Key k(&keys.back(), sizeof(keys.back()), Key::CONNECTION_KEY_TYPE, true);
+        CHECK(t.Insert(std::move(k), test_session(i)) == nullptr);
+        saw_resize = saw_resize || t.Resizing();
+    }
+
+    CHECK(saw_resize);
+    REQUIRE(t.Size() == keys.size());
+
+    for ( uint32_t i = 0; i < keys.size(); ++i ) {
+        Key k(&keys[i], sizeof(keys[i]), Key::CONNECTION_KEY_TYPE);
+        CHECK(t.Lookup(k) == test_session(i));
+    }
+
+    auto missing = test_conn_key(20000);
+    CHECK(t.Lookup(Key(&missing, sizeof(missing), Key::CONNECTION_KEY_TYPE)) == nullptr);
+
+    // Replacing keeps the size.
+    Key k0(&keys[0], sizeof(keys[0]), Key::CONNECTION_KEY_TYPE, true);
+    CHECK(t.Insert(std::move(k0), test_session(42)) == test_session(0));
+    CHECK(t.Size() == keys.size());
+
+    // Remove every other key.
+    for ( uint32_t i = 1; i < keys.size(); i += 2 ) {
+        Key k(&keys[i], sizeof(keys[i]), Key::CONNECTION_KEY_TYPE);
+        CHECK(t.Remove(k) == test_session(i));
+        CHECK(t.Remove(k) == nullptr);
+    }
+
+    CHECK(t.Size() == keys.size() / 2);
+
+    size_t n = 0;
+    t.ForEach([&n](const Key&, Session*) { ++n; });
+    CHECK(n == t.Size());
+
+    for ( uint32_t i = 2; i < keys.size(); ++i ) {
+        Key k(&keys[i], sizeof(keys[i]), Key::CONNECTION_KEY_TYPE);
+        CHECK(t.Lookup(k) == (i % 2 ? nullptr : test_session(i)));
+    }
+
+    t.Clear();
+    CHECK(t.Size() == 0);
+    CHECK(t.Lookup(Key(&keys[0], sizeof(keys[0]), Key::CONNECTION_KEY_TYPE)) == nullptr);
+}
+
+TEST_CASE("session table churn") {
+    // Lots of removals and insertions at a steady size must not fill the
+    // table up with deleted slots.
+    SessionTable t;
+    std::vector<zeek::detail::ConnKey> keys;
+
+    for ( uint32_t i = 0; i < 100000; ++i )
+        keys.push_back(test_conn_key(i));
+
+    for ( uint32_t i = 0; i < keys.size(); ++i ) {
+        t.Insert(Key(&keys[i], sizeof(keys[i]), Key::CONNECTION_KEY_TYPE, true), test_session(i));
+
+        if ( i >= 1000 ) {
+            Key k(&keys[i - 1000], sizeof(keys[i - 1000]), Key::CONNECTION_KEY_TYPE);
+            CHECK(t.Remove(k) == test_session(i - 1000));
+        }
+    }
+
+    CHECK(t.Size() == 1000);
+
+    for ( uint32_t i = keys.size() - 1000; i < keys.size(); ++i )
+        CHECK(t.Lookup(Key(&keys[i], sizeof(keys[i]), Key::CONNECTION_KEY_TYPE)) == test_session(i));
+}
+
+// Microbenchmark comparing the table against std::unordered_map, which the
+// session manager used before. It fills in a given number of connections,
+// then replays a synthetic trace where most packets belong to existing
+// connections and some start new ones while old ones expire. It reports
+// the slowest single insertion as well, which is where a full rehash
+// shows up. Skipped by default; set ZEEK_SESSION_BENCHMARK_SIZES to a
+// comma-separated list of sizes (say, "1000000,5000000"), see
+// MicroBenchmark.h.
+
+namespace {
+
+template<typename Table>
+void run_session_benchmark(const char* name, Table& t, const std::vector<zeek::detail::ConnKey>& keys, size_t num) {
+    constexpr size_t packets = 20000000;
+
+    zeek::detail::Stopwatch sw;
+    zeek::detail::Stopwatch insert_sw;
+    double max_insert = 0.0;
+
+    for ( size_t i = 0; i < num; ++i ) {
+        insert_sw.Lap();
+        t.Insert(Key(&keys[i], sizeof(keys[i]), Key::CONNECTION_KEY_TYPE, true), test_session(i));
+        max_insert = std::max(max_insert, insert_sw.Lap());
+    }
+
+    double fill = sw.Lap();
+
+    std::mt19937_64 rng(42);
+    size_t first = 0;
+    size_t next = num;
+    uint64_t found = 0;
+
+    for ( size_t p = 0; p < packets; ++p ) {
+        // One in a hundred packets starts a new connection, and the
+        // oldest one goes away.
+        if ( p % 100 == 0 && next < keys.size() ) {
+            t.Remove(Key(&keys[first], sizeof(keys[first]), Key::CONNECTION_KEY_TYPE));
+            t.Insert(Key(&keys[next], sizeof(keys[next]), Key::CONNECTION_KEY_TYPE, true), test_session(next));
+            ++first;
+            ++next;
+            continue;
+        }
+
+        size_t i = first + rng() % (next - first);
+        found += t.Lookup(Key(&keys[i], sizeof(keys[i]), Key::CONNECTION_KEY_TYPE)) != nullptr;
+    }
+
+    double run = sw.Lap();
+
+    printf("%-14s %9zu conns: fill %.3fs (%.1f ns/insert, worst %.0f us), trace %.3fs (%.1f ns/packet, %" PRIu64
+           " hits)\n",
+           name, num, fill, fill * 1e9 / num, max_insert * 1e6, run, run * 1e9 / packets, found);
+}
+
+class UnorderedSessionMap {
+public:
+    Session* Lookup(const Key& key) const {
+        auto it = map.find(key);
+        return it != map.end() ? it->second : nullptr;
+    }
+
+    void Insert(Key key, Session* session) { map.insert_or_assign(std::move(key), session); }
+
+    void Remove(const Key& key) { map.erase(key); }
+
+private:
+    std::unordered_map<Key, Session*, KeyHash> map;
+};
+
+} // namespace
+
+TEST_CASE("session table benchmark" * doctest::skip(true)) {
+    for ( auto n : zeek::detail::benchmark_sizes("ZEEK_SESSION_BENCHMARK_SIZES", {5000000}) ) {
+        std::vector<zeek::detail::ConnKey> keys;
+        keys.reserve(n + n / 2);
+
+        for ( size_t i = 0; i < n + n / 2; ++i )
+            keys.push_back(test_conn_key(static_cast<uint32_t>(i)));
+
+        {
+            UnorderedSessionMap m;
+            run_session_benchmark("unordered_map", m, keys, n);
+        }
+
+        {
+            SessionTable t;
+            run_session_benchmark("SessionTable", t, keys, n);
+        }
+    }
+}
+
+TEST_SUITE_END();
+
+} // namespace zeek::session::detail
@@ -0,0 +1,137 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "zeek/session/Key.h"
+
+namespace zeek::session {
+
+class Session;
+
+namespace detail {
+
+/**
+ * The hash table mapping session keys to sessions.
+ *
+ * This is an open-addressing table in the style of Swiss tables: the keys
+ * live inline in a flat slot array, next to a separate array of control
+ * bytes that holds seven bits of each slot's hash. A lookup scans a whole
+ * group of control bytes at once (with SSE2 where available) and only
+ * compares keys whose hash bits match, so finding a session usually
+ * touches one control byte group and one slot.
+ *
+ * Growing the table doesn't move all entries at once. Instead, the old
+ * slots remain in place and every subsequent insertion or removal moves a
+ * few of them over into the new slots, until the old table is empty.
+ * Lookups check both tables in the meantime. This avoids the pause that a
+ * full rehash of millions of connections would cause.
+ */
+class SessionTable {
+public:
+    SessionTable() = default;
+    ~SessionTable();
+
+    SessionTable(SessionTable&& rhs) noexcept;
+    SessionTable& operator=(SessionTable&& rhs) noexcept;
+
+    SessionTable(const SessionTable&) = delete;
+    SessionTable& operator=(const SessionTable&) = delete;
+
+    /**
+     * Returns the session for a key, or null if there's none.
+     */
+    Session* Lookup(const Key& key) const;
+
+    /**
+     * Adds a session, replacing any existing session with the same key.
+     * The key must have its data copied already.
+     *
+     * @return The replaced session, or null if the key wasn't present.
+     */
+    Session* Insert(Key key, Session* session);
+
+    /**
+     * Removes a key.
+     *
+     * @return The session that the key mapped to, or null if the key
+     * wasn't present.
+     */
+    Session* Remove(const Key& key);
+
+    /**
+     * Removes all entries.
+     */
+    void Clear();
+
+    /**
+     * Returns the number of entries.
+     */
+    size_t Size() const { return cur.live + old.live; }
+
+    /**
+     * Returns true if the table is in the middle of growing.
+     */
+    bool Resizing() const { return old.capacity > 0; }
+
+    /**
+     * Calls f(const Key&, Session*) for every entry, in no particular
+     * order. The function must not modify the table.
+     */
+    template<typename F>
+    void ForEach(F f) const {
+        old.ForEach(f);
+        cur.ForEach(f);
+    }
+
+private:
+    struct Slot {
+        Key key;
+        Session* session;
+    };
+
+    // One set of slots along with its control bytes.
+    struct Storage {
+        void Allocate(size_t capacity);
+        void Free();
+
+        // Returns the index of the key's slot, or -1.
+        ptrdiff_t Find(const Key& key, size_t hash) const;
+
+        // Returns the index of a free slot for a key that's known not
+        // to be present.
+        size_t FindFree(size_t hash) const;
+
+        void Put(size_t idx, size_t hash, Key&& key, Session* session);
+        void Erase(size_t idx);
+
+        template<typename F>
+        void ForEach(F& f) const {
+            for ( size_t i = 0; i < capacity; ++i ) {
+                if ( ctrl[i] >= 0 )
+                    f(slots[i].key, slots[i].session);
+            }
+        }
+
+        int8_t* ctrl = nullptr;
+        Slot* slots = nullptr;
+        size_t capacity = 0;
+        size_t live = 0;
+        size_t deleted = 0;
+    };
+
+    // Starts moving entries into a new set of slots.
+    void Grow();
+
+    // Moves up to the given number of old slots to the current ones.
+    void Migrate(size_t num_slots);
+
+    Storage cur;
+    Storage old;
+    size_t migrate_pos = 0;
+};
+
+} // namespace detail
+} // namespace zeek::session
@@ -47,6 +47,8 @@ void Manager::InitPostScript() {
             if ( thread_mgr->bucketed_messages_last_updated < now - 1 ) {
                 thread_mgr->current_bucketed_messages.pending_in_total = 0;
                 thread_mgr->current_bucketed_messages.pending_out_total = 0;
+                thread_mgr->current_bucketed_messages.stalls_in_total = 0;
+                thread_mgr->current_bucketed_messages.stalls_out_total = 0;
                 for ( auto& m : thread_mgr->current_bucketed_messages.pending_in )
                     m.second = 0;
                 for ( auto& m : thread_mgr->current_bucketed_messages.pending_out )
@@ -58,6 +60,10 @@ void Manager::InitPostScript() {
 
                     thread_mgr->current_bucketed_messages.pending_in_total += thread_stats.pending_in;
                     thread_mgr->current_bucketed_messages.pending_out_total += thread_stats.pending_out;
+                    thread_mgr->current_bucketed_messages.stalls_in_total +=
+                        thread_stats.queue_in_stats.num_stalls;
+                    thread_mgr->current_bucketed_messages.stalls_out_total +=
+                        thread_stats.queue_out_stats.num_stalls;
 
                     for ( auto upper_limit : pending_bucket_brackets ) {
                         if ( thread_stats.pending_in <= upper_limit )
@@ -108,6 +114,25 @@ void Manager::InitPostScript() {
                                          return metric;
                                      });
 
+    queue_in_stalls_metric =
+        telemetry_mgr->CounterInstance("zeek", "msgthread_in_queue_stalls", {},
+                                       "Number of inbound messages that found a full ring queue", "",
+                                       []() -> prometheus::ClientMetric {
+                                           auto* s = get_message_thread_stats();
+                                           prometheus::ClientMetric metric;
+                                           metric.counter.value = static_cast<double>(s->stalls_in_total);
+                                           return metric;
+                                       });
+    queue_out_stalls_metric =
+        telemetry_mgr->CounterInstance("zeek", "msgthread_out_queue_stalls", {},
+                                       "Number of outbound messages that found a full ring queue", "",
+                                       []() -> prometheus::ClientMetric {
+                                           auto* s = get_message_thread_stats();
+                                           prometheus::ClientMetric metric;
+                                           metric.counter.value = static_cast<double>(s->stalls_out_total);
+                                           return metric;
+                                       });
+
     pending_message_in_buckets_fam =
         telemetry_mgr->GaugeFamily("zeek", "msgthread_pending_messages_in_buckets", {"le"},
                                    "Number of threads with pending inbound messages split into buckets");
@@ -184,6 +184,8 @@ private:
     telemetry::CounterPtr total_messages_out_metric;
     telemetry::GaugePtr pending_messages_in_metric;
     telemetry::GaugePtr pending_messages_out_metric;
+    telemetry::CounterPtr queue_in_stalls_metric;
+    telemetry::CounterPtr queue_out_stalls_metric;
 
     telemetry::GaugeFamilyPtr pending_message_in_buckets_fam;
     telemetry::GaugeFamilyPtr pending_message_out_buckets_fam;
@@ -193,6 +195,8 @@ private:
     struct BucketedMessages {
         uint64_t pending_in_total;
         uint64_t pending_out_total;
+        uint64_t stalls_in_total;
+        uint64_t stalls_out_total;
         std::map<uint64_t, uint64_t> pending_in;
         std::map<uint64_t, uint64_t> pending_out;
     };
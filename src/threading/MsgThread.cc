@@ -6,6 +6,7 @@
 
 #include "zeek/DebugLogger.h"
 #include "zeek/Desc.h"
+#include "zeek/NetVar.h"
 #include "zeek/Obj.h"
 #include "zeek/RunState.h"
 #include "zeek/iosource/Manager.h"
@@ -226,6 +227,9 @@ MsgThread::MsgThread() : BasicThread(), queue_in(this, nullptr), queue_out(nullp
     failed = false;
     thread_mgr->AddMsgThread(this);
 
+    if ( BifConst::Threading::ring_queue_capacity > 0 )
+        UseRingQueues(BifConst::Threading::ring_queue_capacity, BifConst::Threading::ring_queue_spin_iterations);
+
     io_source = new detail::IOSource(this);
 
     // Register IOSource as non-counting lifetime managed IO source.
@@ -242,6 +246,11 @@ MsgThread::~MsgThread() {
     }
 }
 
+void MsgThread::UseRingQueues(size_t capacity, uint32_t spin_iterations) {
+    queue_in.UseRingBuffer(capacity, spin_iterations);
+    queue_out.UseRingBuffer(capacity, spin_iterations);
+}
+
 void MsgThread::OnSignalStop() {
     if ( main_finished || Killed() || child_sent_finish )
         return;
@@ -478,16 +487,20 @@ void MsgThread::GetStats(Stats* stats) {
 }
 
 void MsgThread::Process() {
-    while ( HasOut() ) {
-        Message* msg = RetrieveOut();
-        assert(msg);
+    constexpr size_t batch_size = 64;
+    BasicOutputMessage* msgs[batch_size];
 
-        if ( ! msg->Process() ) {
-            reporter->Error("%s failed, terminating thread", msg->Name());
-            SignalStop();
-        }
+    while ( size_t n = queue_out.GetBatch(msgs, batch_size) ) {
+        for ( size_t i = 0; i < n; ++i ) {
+            DBG_LOG(DBG_THREADING, "Retrieved '%s' from %s", msgs[i]->Name(), Name());
 
-        delete msg;
+            if ( ! msgs[i]->Process() ) {
+                reporter->Error("%s failed, terminating thread", msgs[i]->Name());
+                SignalStop();
+            }
+
+            delete msgs[i];
+        }
     }
 }
 
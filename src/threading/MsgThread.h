@@ -54,6 +54,22 @@ public:
      */
     virtual ~MsgThread();
 
+    /**
+     * Switches both of the thread's message queues to lock-free ring
+     * buffers. The constructor already does so if
+     * Threading::ring_queue_capacity is set; this allows individual
+     * threads to choose differently.
+     *
+     * Must be called from the main thread before any messages get sent.
+     *
+     * @param capacity The number of slots per ring.
+     *
+     * @param spin_iterations How often a reader polls an empty ring
+     * before going to sleep, and a writer polls a full one before
+     * spilling over into an unbounded overflow list.
+     */
+    void UseRingQueues(size_t capacity, uint32_t spin_iterations);
+
     /**
      * Sends a message to the child thread. The message will be processed
      * once the thread has retrieved it from its incoming queue.
@@ -0,0 +1,137 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#include "zeek/threading/Queue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "zeek/3rdparty/doctest.h"
+
+using namespace zeek::threading;
+
+TEST_SUITE_BEGIN("threading-queue");
+
+TEST_CASE("ring buffer wrap-around") {
+    detail::RingBuffer<int*> ring(3, 0);
+    CHECK(ring.Capacity() == 4);
+
+    std::vector<int> vals(64);
+
+    // A full ring takes as many elements as fit, and no more.
+    int* in[6];
+    for ( int i = 0; i < 6; ++i )
+        in[i] = &vals[i];
+
+    CHECK(ring.TryPutBatch(in, 6) == 4);
+    CHECK_FALSE(ring.TryPut(in[4]));
+    CHECK(ring.Size() == 4);
+    CHECK(ring.TryGet() == in[0]);
+    CHECK(ring.TryPut(in[4]));
+
+    int* out[4];
+    REQUIRE(ring.TryGetBatch(out, 4) == 4);
+    CHECK(out[0] == in[1]);
+    CHECK(out[3] == in[4]);
+    CHECK(ring.Empty());
+
+    // Cycle through the slots many times, with batches straddling the end
+    // of the ring.
+    size_t next_put = 5;
+    size_t next_get = 5;
+
+    while ( next_get < vals.size() ) {
+        size_t n = std::min<size_t>(3, vals.size() - next_put);
+        for ( size_t i = 0; i < n; ++i )
+            in[i] = &vals[next_put + i];
+
+        next_put += ring.TryPutBatch(in, n);
+        CHECK(ring.Size() <= ring.Capacity());
+
+        auto k = ring.TryGetBatch(out, 2);
+        for ( size_t i = 0; i < k; ++i )
+            CHECK(out[i] == &vals[next_get++]);
+    }
+
+    CHECK(ring.Empty());
+    CHECK(ring.TryGet() == nullptr);
+}
+
+TEST_CASE("ring buffer wake-up") {
+    detail::RingBuffer<int*> ring(4, 0);
+    int v = 0;
+
+    SUBCASE("on data") {
+        bool ready = false;
+        auto start = std::chrono::steady_clock::now();
+
+        std::thread consumer(
+            [&]() { ready = ring.Wait(std::chrono::seconds(10), [&]() { return ! ring.Empty(); }); });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ring.TryPut(&v);
+        ring.NotifyConsumer();
+        consumer.join();
+
+        CHECK(ready);
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+        CHECK(ring.TryGet() == &v);
+    }
+
+    SUBCASE("explicitly") {
+        std::atomic<bool> done = false;
+
+        // Keep at it, as a wake-up arriving before the consumer has gone
+        // to sleep has no effect.
+        std::thread waker([&]() {
+            while ( ! done ) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                ring.WakeUp();
+            }
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        CHECK_FALSE(ring.Wait(std::chrono::seconds(10), [&]() { return ! ring.Empty(); }));
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+
+        done = true;
+        waker.join();
+    }
+}
+
+TEST_CASE("queue ring spill-over") {
+    Queue<int*> q(nullptr, nullptr);
+    q.UseRingBuffer(4, 0);
+
+    std::vector<int> vals(10);
+    for ( auto& v : vals )
+        q.Put(&v);
+
+    // Only the first write finding the ring full counts as a stall; the
+    // following ones go straight to the overflow list.
+    Queue<int*>::Stats stats;
+    q.GetStats(&stats);
+    CHECK(stats.num_writes == 10);
+    CHECK(stats.num_stalls == 1);
+    CHECK(q.Size() == 10);
+    CHECK(q.Ready());
+
+    // The ring's elements come first, then the spilled ones.
+    int* out[16];
+    REQUIRE(q.GetBatch(out, 16) == 10);
+    for ( size_t i = 0; i < vals.size(); ++i )
+        CHECK(out[i] == &vals[i]);
+
+    CHECK_FALSE(q.Ready());
+    CHECK(q.Size() == 0);
+
+    // Once drained, writes go back into the ring.
+    q.Put(&vals[0]);
+    q.GetStats(&stats);
+    CHECK(stats.num_stalls == 1);
+    CHECK(q.Get() == &vals[0]);
+}
+
+TEST_SUITE_END();
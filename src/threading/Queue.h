@@ -1,14 +1,17 @@
 #pragma once
 
 #include <sys/time.h>
+#include <atomic>
 #include <condition_variable>
 #include <cstdint>
 #include <deque>
+#include <memory>
 #include <mutex>
 #include <queue>
 
 #include "zeek/Reporter.h"
 #include "zeek/threading/BasicThread.h"
+#include "zeek/threading/RingBuffer.h"
 
 #undef Queue // Defined elsewhere unfortunately.
 
@@ -17,13 +20,14 @@ namespace zeek::threading {
 /**
  * A thread-safe single-reader single-writer queue.
  *
- * The implementation uses multiple queues and reads/writes in rotary fashion
- * in an attempt to limit contention.
+ * By default, the implementation uses multiple queues and reads/writes in
+ * rotary fashion in an attempt to limit contention. Alternatively,
+ * UseRingBuffer() switches the queue to a lock-free ring. As the ring is
+ * bounded but a writer must never block (the reader may be waiting on it in
+ * turn), elements that don't fit spill over into a mutex-protected overflow
+ * list until the reader has caught up.
  *
  * All Queue instances must be instantiated by Zeek's main thread.
- *
- * TODO: Unclear how critical performance is for this queue. We could likely
- * optimize it further if helpful.
  */
 template<typename T>
 class Queue {
@@ -42,6 +46,18 @@ public:
      */
     ~Queue();
 
+    /**
+     * Switches the queue to a lock-free single-producer single-consumer
+     * ring. Must be called before the queue is first used.
+     *
+     * @param capacity The number of slots in the ring.
+     *
+     * @param spin_iterations How often the reader polls an empty ring
+     * before going to sleep, and the writer polls a full one before
+     * spilling over.
+     */
+    void UseRingBuffer(size_t capacity, uint32_t spin_iterations);
+
     /**
      * Retrieves one element. This may block for a little while of no
      * input is available and eventually return with a null element if
@@ -49,6 +65,13 @@ public:
      */
     T Get();
 
+    /**
+     * Retrieves up to max elements without blocking.
+     *
+     * @return The number of elements stored into out.
+     */
+    size_t GetBatch(T* out, size_t max);
+
     /**
      * Queues one element.
      */
@@ -87,6 +110,7 @@ public:
     struct Stats {
         uint64_t num_reads;  //! Number of messages read from the queue.
         uint64_t num_writes; //! Number of messages written to the queue.
+        uint64_t num_stalls; //! Number of writes that found the ring full and spilled over.
     };
 
     /**
@@ -102,6 +126,15 @@ private:
 
     std::vector<std::unique_lock<std::mutex>> LocksForAllQueues();
 
+    T RingGet();
+    void RingPut(T data);
+
+    // Counters only ever get updated by one side, so they don't need
+    // atomic read-modify-write operations.
+    static void Bump(std::atomic<uint64_t>& counter, uint64_t n) {
+        counter.store(counter.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
     std::mutex mutex[NUM_QUEUES];                 // Mutex protected shared accesses.
     std::condition_variable has_data[NUM_QUEUES]; // Signals when data becomes available
     std::queue<T> messages[NUM_QUEUES];           // Actually holds the queued messages
@@ -112,9 +145,17 @@ private:
     BasicThread* reader;
     BasicThread* writer;
 
+    // Only used in ring mode. The overflow list is messages[0], protected
+    // by mutex[0]; the reader moves it over into spill_pending in one go.
+    std::unique_ptr<detail::RingBuffer<T>> ring;
+    std::atomic<bool> spilled{false}; // Overflow list in use.
+    std::deque<T> spill_pending;       // Reader-owned.
+    uint32_t spin_iterations = 0;
+
     // Statistics.
-    uint64_t num_reads;
-    uint64_t num_writes;
+    std::atomic<uint64_t> num_reads;
+    std::atomic<uint64_t> num_writes;
+    std::atomic<uint64_t> num_stalls;
 };
 
 inline static std::unique_lock<std::mutex> acquire_lock(std::mutex& m) {
@@ -131,7 +172,7 @@ template<typename T>
 inline Queue<T>::Queue(BasicThread* arg_reader, BasicThread* arg_writer) {
     read_ptr = 0;
     write_ptr = 0;
-    num_reads = num_writes = 0;
+    num_reads = num_writes = num_stalls = 0;
     reader = arg_reader;
     writer = arg_writer;
 }
@@ -139,8 +180,29 @@ inline Queue<T>::Queue(BasicThread* arg_reader, BasicThread* arg_writer) {
 template<typename T>
 inline Queue<T>::~Queue() {}
 
+template<typename T>
+inline void Queue<T>::UseRingBuffer(size_t capacity, uint32_t arg_spin_iterations) {
+    if ( num_writes.load() > 0 )
+        reporter->InternalError("Queue::UseRingBuffer() called on a queue in use");
+
+    ring = std::make_unique<detail::RingBuffer<T>>(capacity, arg_spin_iterations);
+    spin_iterations = arg_spin_iterations;
+}
+
 template<typename T>
 inline T Queue<T>::Get() {
+    if ( ring ) {
+        T data = RingGet();
+
+        if ( data || (reader && reader->Killed()) || (writer && writer->Killed()) )
+            return data;
+
+        ring->Wait(std::chrono::seconds(5),
+                   [this]() { return ! ring->Empty() || spilled.load(std::memory_order_acquire); });
+
+        return RingGet();
+    }
+
     auto lock = acquire_lock(mutex[read_ptr]);
 
     int old_read_ptr = read_ptr;
@@ -157,13 +219,113 @@ inline T Queue<T>::Get() {
     messages[read_ptr].pop();
 
     read_ptr = (read_ptr + 1) % NUM_QUEUES;
-    ++num_reads;
+    Bump(num_reads, 1);
+
+    return data;
+}
+
+template<typename T>
+inline size_t Queue<T>::GetBatch(T* out, size_t max) {
+    size_t n = 0;
+
+    if ( ! ring ) {
+        while ( n < max && Ready() )
+            out[n++] = Get();
+
+        return n;
+    }
+
+    while ( n < max ) {
+        if ( spill_pending.empty() ) {
+            // Anything in the ring predates what's in the overflow list.
+            if ( size_t k = ring->TryGetBatch(out + n, max - n) ) {
+                Bump(num_reads, k);
+                n += k;
+                continue;
+            }
+        }
+
+        T data = RingGet();
+        if ( ! data )
+            break;
+
+        out[n++] = data;
+    }
+
+    return n;
+}
+
+template<typename T>
+inline T Queue<T>::RingGet() {
+    T data = nullptr;
+
+    if ( ! spill_pending.empty() ) {
+        data = spill_pending.front();
+        spill_pending.pop_front();
+    }
+
+    else if ( ! (data = ring->TryGet()) && spilled.load(std::memory_order_acquire) ) {
+        // The writer stopped using the ring once it spilled over, so we
+        // can take the overflow list as soon as the ring is drained.
+        if ( ! (data = ring->TryGet()) ) {
+            auto lock = acquire_lock(mutex[0]);
+
+            while ( ! messages[0].empty() ) {
+                spill_pending.push_back(messages[0].front());
+                messages[0].pop();
+            }
+
+            spilled.store(false, std::memory_order_release);
+            lock.unlock();
+
+            if ( ! spill_pending.empty() ) {
+                data = spill_pending.front();
+                spill_pending.pop_front();
+            }
+        }
+    }
+
+    if ( data )
+        Bump(num_reads, 1);
 
     return data;
 }
 
+template<typename T>
+inline void Queue<T>::RingPut(T data) {
+    bool done = false;
+
+    if ( ! spilled.load(std::memory_order_acquire) ) {
+        done = ring->TryPut(data);
+
+        for ( uint32_t i = 0; ! done && i < spin_iterations; ++i ) {
+            detail::cpu_relax();
+            done = ring->TryPut(data);
+        }
+
+        if ( ! done )
+            Bump(num_stalls, 1);
+    }
+
+    if ( ! done ) {
+        // Don't block when the ring is full: the reader may be blocked
+        // on us in turn.
+        auto lock = acquire_lock(mutex[0]);
+        messages[0].push(data);
+        spilled.store(true, std::memory_order_release);
+    }
+
+    Bump(num_writes, 1);
+    ring->NotifyConsumer();
+}
+
 template<typename T>
 inline void Queue<T>::Put(T data) {
+    if ( ring ) {
+        RingPut(data);
+        return;
+    }
+
     auto lock = acquire_lock(mutex[write_ptr]);
 
     int old_write_ptr = write_ptr;
@@ -173,7 +335,7 @@ inline void Queue<T>::Put(T data) {
     messages[write_ptr].push(data);
 
     write_ptr = (write_ptr + 1) % NUM_QUEUES;
-    ++num_writes;
+    Bump(num_writes, 1);
 
     if ( need_signal ) {
         lock.unlock();
@@ -183,6 +345,9 @@ inline void Queue<T>::Put(T data) {
 
 template<typename T>
 inline bool Queue<T>::Ready() {
+    if ( ring )
+        return ! spill_pending.empty() || ! ring->Empty() || spilled.load(std::memory_order_acquire);
+
     auto lock = acquire_lock(mutex[read_ptr]);
 
     bool ret = (messages[read_ptr].size());
@@ -210,6 +375,9 @@ inline std::vector<std::unique_lock<std::mutex>> Queue<T>::LocksForAllQueues() {
 
 template<typename T>
 inline uint64_t Queue<T>::Size() {
+    if ( ring )
+        return num_writes.load(std::memory_order_relaxed) - num_reads.load(std::memory_order_relaxed);
+
     // Need to lock all queues.
     auto locks = LocksForAllQueues();
 
@@ -223,16 +391,29 @@ inline uint64_t Queue<T>::Size() {
 
 template<typename T>
 inline void Queue<T>::GetStats(Stats* stats) {
+    if ( ring ) {
+        stats->num_reads = num_reads.load(std::memory_order_relaxed);
+        stats->num_writes = num_writes.load(std::memory_order_relaxed);
+        stats->num_stalls = num_stalls.load(std::memory_order_relaxed);
+        return;
+    }
+
     // To be safe, we look all queues. That's probably unnecessary, but
     // doesn't really hurt.
     auto locks = LocksForAllQueues();
 
     stats->num_reads = num_reads;
     stats->num_writes = num_writes;
+    stats->num_stalls = num_stalls;
 }
 
 template<typename T>
 inline void Queue<T>::WakeUp() {
+    if ( ring ) {
+        ring->WakeUp();
+        return;
+    }
+
     for ( int i = 0; i < NUM_QUEUES; i++ ) {
         auto lock = acquire_lock(mutex[i]);
         has_data[i].notify_all();
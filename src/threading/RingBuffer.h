@@ -0,0 +1,273 @@
+// See the file "COPYING" in the main distribution directory for copyright.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#else
+#include <condition_variable>
+#include <mutex>
+#endif
+
+namespace zeek::threading::detail {
+
+// Hint to the CPU that we're in a spin loop.
+inline void cpu_relax() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_ia32_pause();
+#elif defined(__GNUC__) && defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/**
+ * A bounded, lock-free single-producer single-consumer ring of pointers.
+ *
+ * The producer and consumer positions live on separate cache lines, and
+ * each side caches the other side's position so that it only touches the
+ * shared line when it looks like the ring is full or empty.
+ *
+ * A consumer waiting for data first spins for a configurable number of
+ * iterations and then goes to sleep (on a futex where available). The
+ * producer only issues a wakeup if the consumer has actually gone to
+ * sleep.
+ */
+template<typename T>
+class RingBuffer {
+    static_assert(std::is_pointer_v<T>, "RingBuffer holds pointers only");
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param capacity The number of slots. Gets rounded up to the next
+     * power of two.
+     *
+     * @param spin_iterations How often a waiting consumer polls the ring
+     * before going to sleep.
+     */
+    RingBuffer(size_t capacity, uint32_t spin_iterations);
+
+    ~RingBuffer() { delete[] slots; }
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    /**
+     * Appends an element. Producer only.
+     *
+     * @return False if the ring is full.
+     */
+    bool TryPut(T data) { return TryPutBatch(&data, 1) == 1; }
+
+    /**
+     * Appends as many of the given elements as fit. Producer only.
+     *
+     * @return The number of elements appended, starting from the first.
+     */
+    size_t TryPutBatch(T* data, size_t n);
+
+    /**
+     * Wakes up the consumer if it's sleeping in Wait(). The producer calls
+     * this after appending.
+     */
+    void NotifyConsumer() {
+        // Pairs with the fence in Wait(): either the consumer sees the new
+        // tail, or we see that it's going to sleep.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if ( sleeping.load(std::memory_order_relaxed) )
+            WakeUp();
+    }
+
+    /**
+     * Removes and returns the oldest element, or null if the ring is
+     * empty. Consumer only.
+     */
+    T TryGet() {
+        T data = nullptr;
+        TryGetBatch(&data, 1);
+        return data;
+    }
+
+    /**
+     * Removes up to max elements in order. Consumer only.
+     *
+     * @return The number of elements removed.
+     */
+    size_t TryGetBatch(T* out, size_t max);
+
+    /**
+     * Blocks until ready() returns true or the timeout expires, spinning
+     * first. Consumer only. ready() must not have side effects.
+     *
+     * @return The final value of ready().
+     */
+    template<typename Pred>
+    bool Wait(std::chrono::milliseconds timeout, Pred ready);
+
+    /**
+     * Wakes up a consumer sleeping in Wait(). Safe to call from any
+     * thread.
+     */
+    void WakeUp();
+
+    /**
+     * Returns true if the ring holds no elements. Exact when called by
+     * the consumer; approximate otherwise.
+     */
+    bool Empty() const { return head.load(std::memory_order_relaxed) == tail.load(std::memory_order_acquire); }
+
+    /**
+     * Returns the number of elements in the ring. Approximate if called
+     * while the other side is active.
+     */
+    size_t Size() const {
+        return static_cast<size_t>(tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire));
+    }
+
+    /**
+     * Returns the number of slots.
+     */
+    size_t Capacity() const { return mask + 1; }
+
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+#ifdef __linux__
+    void FutexWait(std::chrono::milliseconds timeout) {
+        auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+        struct timespec ts;
+        ts.tv_sec = secs.count();
+        ts.tv_nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout - secs).count();
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sleeping), FUTEX_WAIT_PRIVATE, 1, &ts, nullptr, 0);
+    }
+
+    void FutexWake() {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sleeping), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+#endif
+
+    T* slots;
+    size_t mask;
+    uint32_t spin_iterations;
+
+    // Consumer-owned.
+    alignas(CACHE_LINE) std::atomic<uint64_t> head{0};
+    uint64_t cached_tail = 0;
+
+    // Producer-owned.
+    alignas(CACHE_LINE) std::atomic<uint64_t> tail{0};
+    uint64_t cached_head = 0;
+
+    // Set by the consumer while it's (about to be) asleep.
+    alignas(CACHE_LINE) std::atomic<uint32_t> sleeping{0};
+
+#ifndef __linux__
+    std::mutex sleep_mutex;
+    std::condition_variable sleep_cond;
+#endif
+};
+
+template<typename T>
+inline RingBuffer<T>::RingBuffer(size_t capacity, uint32_t arg_spin_iterations) {
+    size_t n = 2;
+    while ( n < capacity )
+        n <<= 1;
+
+    slots = new T[n];
+    mask = n - 1;
+    spin_iterations = arg_spin_iterations;
+}
+
+template<typename T>
+inline size_t RingBuffer<T>::TryPutBatch(T* data, size_t n) {
+    uint64_t t = tail.load(std::memory_order_relaxed);
+
+    if ( t + n - cached_head > mask + 1 ) {
+        cached_head = head.load(std::memory_order_acquire);
+
+        if ( t + n - cached_head > mask + 1 )
+            n = mask + 1 - (t - cached_head);
+    }
+
+    for ( size_t i = 0; i < n; ++i )
+        slots[(t + i) & mask] = data[i];
+
+    if ( n )
+        tail.store(t + n, std::memory_order_release);
+
+    return n;
+}
+
+template<typename T>
+inline size_t RingBuffer<T>::TryGetBatch(T* out, size_t max) {
+    uint64_t h = head.load(std::memory_order_relaxed);
+
+    if ( cached_tail - h < max ) {
+        cached_tail = tail.load(std::memory_order_acquire);
+
+        if ( cached_tail - h < max )
+            max = cached_tail - h;
+    }
+
+    for ( size_t i = 0; i < max; ++i )
+        out[i] = slots[(h + i) & mask];
+
+    if ( max )
+        head.store(h + max, std::memory_order_release);
+
+    return max;
+}
+
+template<typename T>
+template<typename Pred>
+inline bool RingBuffer<T>::Wait(std::chrono::milliseconds timeout, Pred ready) {
+    for ( uint32_t i = 0; i < spin_iterations; ++i ) {
+        if ( ready() )
+            return true;
+
+        cpu_relax();
+    }
+
+    sleeping.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if ( ready() ) {
+        sleeping.store(0, std::memory_order_relaxed);
+        return true;
+    }
+
+#ifdef __linux__
+    FutexWait(timeout);
+#else
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    sleep_cond.wait_for(lock, timeout, [this]() { return sleeping.load(std::memory_order_relaxed) == 0; });
+#endif
+
+    sleeping.store(0, std::memory_order_relaxed);
+    return ready();
+}
+
+template<typename T>
+inline void RingBuffer<T>::WakeUp() {
+#ifdef __linux__
+    if ( sleeping.exchange(0) )
+        FutexWake();
+#else
+    std::unique_lock<std::mutex> lock(sleep_mutex);
+    sleeping.store(0);
+    sleep_cond.notify_one();
+#endif
+}
+
+} // namespace zeek::threading::detail
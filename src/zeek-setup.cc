@@ -37,7 +37,9 @@
 #include "zeek/Func.h"
 #include "zeek/Hash.h"
 #include "zeek/NetVar.h"
+#include "zeek/ObjPool.h"
 #include "zeek/Options.h"
+#include "zeek/Reassem.h"
 #include "zeek/Reporter.h"
 #include "zeek/RuleMatcher.h"
 #include "zeek/RunState.h"
@@ -810,6 +812,10 @@ SetupResult setup(int argc, char** argv, Options* zopts) {
         broker_mgr->InitPostScript();
         timer_mgr->InitPostScript();
         event_mgr.InitPostScript();
+        Reassembler::InitPostScript();
+#ifdef USE_OBJ_POOL
+        ObjPool::InitPostScript();
+#endif
 
         if ( supervisor_mgr )
             supervisor_mgr->InitPostScript();
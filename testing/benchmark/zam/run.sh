@@ -0,0 +1,61 @@
+#! /usr/bin/env bash
+#
+# Runs the ZAM dispatch benchmarks and reports, for each, how many ZAM
+# instructions per second its workload executes.
+#
+# Usage: run.sh [zeek-binary] [benchmark ...]
+#
+# Instruction counts come from a ZAM profile taken with a sampling rate of 1,
+# so the Zeek binary must be built with ZAM profiling (--enable-ZAM-profiling
+# or --enable-debug). Timings come from separate, unprofiled runs, taking the
+# best of ZAM_BENCH_RUNS (default 3). To factor out startup and compilation,
+# both counts and timings are the difference between a run with
+# ZAM_BENCH_ITERATIONS (default 100000) iterations and one with none.
+
+set -e
+
+zeek=${1:-zeek}
+shift || true
+
+dir=$(cd "$(dirname "$0")" && pwd)
+benchmarks=${*:-conn dns http ssl}
+iterations=${ZAM_BENCH_ITERATIONS:-100000}
+runs=${ZAM_BENCH_RUNS:-3}
+
+tmp=$(mktemp -d)
+trap 'rm -rf "$tmp"' EXIT
+
+# Prints the total number of ZAM instructions executed by the given
+# benchmark when run with the given number of iterations.
+count_insts() {
+    (cd "$tmp" && rm -f zprof.out &&
+        ZAM_BENCH_ITERATIONS=$2 ZEEK_ZAM_PROF_SAMPLING_RATE=1 "$zeek" -b -O profile-ZAM "$dir/$1.zeek" >/dev/null)
+
+    # Per-operation lines are the only tab-separated ones with three fields
+    # other than those reporting instruction sequences.
+    awk -F '\t' 'NF == 3 && $1 != "sequence" { n += $2 } END { print n + 0 }' "$tmp/zprof.out"
+}
+
+# Prints the best elapsed time, in seconds, over the configured number of
+# runs of the given benchmark with the given number of iterations.
+best_time() {
+    local best=""
+
+    for _ in $(seq "$runs"); do
+        local start end
+        start=$(date +%s.%N)
+        ZAM_BENCH_ITERATIONS=$2 "$zeek" -b -O ZAM "$dir/$1.zeek" >/dev/null
+        end=$(date +%s.%N)
+        best=$(echo "$start $end $best" | awk '{ t = $2 - $1; if ( NF == 3 && $3 < t ) t = $3; print t }')
+    done
+
+    echo "$best"
+}
+
+printf "%-8s %14s %10s %14s\n" benchmark instructions seconds insts/sec
+
+for b in $benchmarks; do
+    insts=$(($(count_insts "$b" "$iterations") - $(count_insts "$b" 0)))
+    secs=$(echo "$(best_time "$b" "$iterations") $(best_time "$b" 0)" | awk '{ print $1 - $2 }')
+    echo "$b $insts $secs" | awk '{ printf "%-8s %14d %10.3f %14.0f\n", $1, $2, $3, $3 > 0 ? $2 / $3 : 0 }'
+done